@@ -0,0 +1,160 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "arena.h"
+#include <string.h>
+
+
+#define ARENA_ALIGN(size) (((size) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+
+Arena_t* Arena_new(void)
+{
+    Arena_t* arena = calloc(1, sizeof(Arena_t));
+
+    return arena;
+}
+
+
+static ArenaBlock_t* Arena_new_block(Arena_t* arena, size_t size)
+{
+    if (size < ARENA_BLOCK_SIZE)
+    {
+        size = ARENA_BLOCK_SIZE;
+    }
+
+    ArenaBlock_t* blk = malloc(sizeof(ArenaBlock_t) + size);
+
+    if (!blk)
+    {
+        return NULL;
+    }
+
+    blk->next = NULL;
+    blk->size = size;
+    blk->used = 0;
+
+    arena->allocated += size;
+
+    /* Insert the new block right after the current one, so that no block is skipped */
+    if (arena->act)
+    {
+        blk->next = arena->act->next;
+        arena->act->next = blk;
+    }
+    else
+    {
+        blk->next = arena->first;
+        arena->first = blk;
+    }
+
+    return blk;
+}
+
+
+void* Arena_alloc(Arena_t* arena, size_t size)
+{
+    ArenaBlock_t* blk = arena->act;
+    void* ptr;
+
+    size = ARENA_ALIGN(size);
+
+    /* Find the next block with enough room for the allocation */
+    while (blk && blk->size - blk->used < size)
+    {
+        blk = blk->next;
+    }
+
+    if (!blk && (blk = Arena_new_block(arena, size)) == NULL)
+    {
+        return NULL;
+    }
+
+    arena->act = blk;
+
+    ptr = (char*)blk->data + blk->used;
+    blk->used += size;
+    arena->last = ptr;
+
+    return ptr;
+}
+
+
+void* Arena_calloc(Arena_t* arena, size_t size)
+{
+    void* ptr = Arena_alloc(arena, size);
+
+    if (ptr)
+    {
+        memset(ptr, 0, size);
+    }
+
+    return ptr;
+}
+
+
+void* Arena_realloc(Arena_t* arena, void* ptr, size_t oldSize, size_t newSize)
+{
+    void* newPtr;
+
+    if (!ptr)
+    {
+        return Arena_alloc(arena, newSize);
+    }
+
+    /* Last allocation of the arena, try to grow it in place */
+    if (ptr == arena->last)
+    {
+        ArenaBlock_t* blk = arena->act;
+        size_t offset = (char*)ptr - (char*)blk->data;
+
+        if (offset + ARENA_ALIGN(newSize) <= blk->size)
+        {
+            blk->used = offset + ARENA_ALIGN(newSize);
+            return ptr;
+        }
+    }
+
+    if ((newPtr = Arena_alloc(arena, newSize)) == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+
+    return newPtr;
+}
+
+
+void Arena_reset(Arena_t* arena)
+{
+    for (ArenaBlock_t* blk = arena->first ; blk ; blk = blk->next)
+    {
+        blk->used = 0;
+    }
+
+    arena->act  = arena->first;
+    arena->last = NULL;
+}
+
+
+void Arena_free(Arena_t* arena)
+{
+    ArenaBlock_t* tmp;
+
+    if (!arena)
+    {
+        return;
+    }
+
+    for (ArenaBlock_t* blk = arena->first ; blk ; blk = tmp)
+    {
+        tmp = blk->next;
+        free(blk);
+    }
+
+    free(arena);
+}
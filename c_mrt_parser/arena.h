@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdlib.h>
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+
+/**
+ * @brief Block of memory from which the arena allocations are served.
+ */
+typedef struct arena_block_t
+{
+    /**
+     * @brief Next block of the arena (if any).
+     */
+    struct arena_block_t* next;
+
+    /**
+     * @brief Number of bytes that can be allocated in this block.
+     */
+    size_t size;
+
+    /**
+     * @brief Number of bytes already allocated in this block.
+     */
+    size_t used;
+
+    /**
+     * @brief Memory served by the block.
+     */
+    max_align_t data[];
+} ArenaBlock_t;
+
+
+/**
+ * @brief Structure representing an arena (bump) allocator. Allocations are served
+ * sequentially from a list of blocks, and are never freed one by one: the whole arena
+ * is reset at once, while keeping its blocks for the next allocations. This is used to
+ * store all the MRT entries (and their content) of an MRT record, so that parsing a record
+ * does not cost any malloc/free call once the arena is warm.
+ */
+typedef struct arena_t
+{
+    /**
+     * @brief First block of the arena.
+     */
+    ArenaBlock_t* first;
+
+    /**
+     * @brief Block from which the allocations are currently served.
+     */
+    ArenaBlock_t* act;
+
+    /**
+     * @brief Last allocation served by the arena, which can be grown in place.
+     */
+    void* last;
+
+    /**
+     * @brief Total number of bytes allocated by the arena from the system.
+     */
+    size_t allocated;
+} Arena_t;
+
+
+/**
+ * @brief Creates an empty arena. No memory block is allocated until the first allocation.
+ *
+ * @return Arena_t*     Returns a pointer to the allocated arena, NULL if no memory can be
+ * allocated.
+ */
+Arena_t* Arena_new(void);
+
+
+/**
+ * @brief Allocates a memory area from the arena. The area is aligned for any type, and
+ * remains valid until the arena is reset or freed.
+ *
+ * @param arena     Pointer to the arena from which the memory is allocated.
+ * @param size      Number of bytes to allocate.
+ *
+ * @return void*    Returns a pointer to the allocated area, NULL if no memory can be
+ * allocated.
+ */
+void* Arena_alloc(Arena_t* arena, size_t size);
+
+
+/**
+ * @brief Same as Arena_alloc, but the allocated area is set to zero.
+ *
+ * @param arena     Pointer to the arena from which the memory is allocated.
+ * @param size      Number of bytes to allocate.
+ *
+ * @return void*    Returns a pointer to the allocated area, NULL if no memory can be
+ * allocated.
+ */
+void* Arena_calloc(Arena_t* arena, size_t size);
+
+
+/**
+ * @brief Grows a memory area allocated from the arena. The area is grown in place if it is
+ * the last allocation of the arena and if there is enough room in its block. Otherwise, a
+ * new area is allocated and the content of the old one is copied.
+ *
+ * @param arena     Pointer to the arena from which the memory was allocated.
+ * @param ptr       Pointer to the area to grow (NULL to allocate a new area).
+ * @param oldSize   Current size of the area.
+ * @param newSize   Requested size of the area.
+ *
+ * @return void*    Returns a pointer to the grown area, NULL if no memory can be allocated
+ * (the old area is then left untouched).
+ */
+void* Arena_realloc(Arena_t* arena, void* ptr, size_t oldSize, size_t newSize);
+
+
+/**
+ * @brief Releases all the allocations of the arena at once. The memory blocks are kept to
+ * serve the next allocations.
+ *
+ * @param arena     Pointer to the arena to reset.
+ */
+void Arena_reset(Arena_t* arena);
+
+
+/**
+ * @brief Frees the arena and all its memory blocks.
+ *
+ * @param arena     Pointer to the arena to free.
+ */
+void Arena_free(Arena_t* arena);
+
+#endif
@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Benchmark of process_prefix_list against the former prefix-per-prefix decoding loop (one
+ * process_prefix call and one MRTentry_next_nlri call per prefix). Both decode the same random
+ * IPv4 and IPv6 prefix lists, and their outputs are checked to be identical.
+ *
+ * Usage: ./bench_nlri [number_of_prefixes_per_list] [number_of_rounds]
+ */
+
+#include "file_buffer.h"
+#include "bgp_macros.h"
+
+#include <time.h>
+
+#define DEFAULT_NB_PREFIXES 500
+#define DEFAULT_NB_ROUNDS   20000
+
+
+/* Former decoding loop of the NLRI */
+static int process_prefix_list_loop(u_char* buffer, int len, int afi, MRTentry* entry)
+{
+    Prefix_t* pfx;
+    int off = 0;
+    int ret;
+
+    while (off < len)
+    {
+        if ((pfx = MRTentry_next_nlri(entry)) == NULL)
+        {
+            return -1;
+        }
+
+        if ((ret = process_prefix(buffer+off, pfx, afi)) == -1)
+        {
+            return -1;
+        }
+
+        UPDATE_AND_CHECK_LEN(off, ret, len, -1)
+        entry->nbNLRI++;
+    }
+
+    return entry->nbNLRI;
+}
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static int random_list(u_char* buffer, int nb, int afi, unsigned int* seed)
+{
+    int off = 0;
+
+    for (int i = 0 ; i < nb ; i++)
+    {
+        int pfxLen = afi == BGP_IPV6_AFI ? 16 + rand_r(seed) % 113 : 8 + rand_r(seed) % 25;
+
+        buffer[off++] = pfxLen;
+        for (int j = 0 ; j < (pfxLen + 7) / 8 ; j++)
+        {
+            buffer[off++] = rand_r(seed);
+        }
+    }
+
+    return off;
+}
+
+
+static void bench(int afi, int nb, int rounds)
+{
+    u_char* buffer = malloc(nb * 17);
+    MRTentry* loop = MRTentry_new();
+    MRTentry* bulk = MRTentry_new();
+    unsigned int seed = 42;
+    double start, tLoop, tBulk;
+    int len;
+
+    if (!buffer || !loop || !bulk)
+    {
+        printf("Unable to allocate any memory\n");
+        exit(1);
+    }
+
+    len = random_list(buffer, nb, afi, &seed);
+
+    if (process_prefix_list_loop(buffer, len, afi, loop) != nb ||
+        process_prefix_list(buffer, len, afi, bulk, 0) != nb ||
+        memcmp(loop->pfxNLRI, bulk->pfxNLRI, nb * sizeof(Prefix_t)) != 0)
+    {
+        printf("Mismatch between the decoded prefixes\n");
+        exit(1);
+    }
+
+    start = now();
+    for (int i = 0 ; i < rounds ; i++)
+    {
+        MRTentry_reset(loop);
+        process_prefix_list_loop(buffer, len, afi, loop);
+    }
+    tLoop = now() - start;
+
+    start = now();
+    for (int i = 0 ; i < rounds ; i++)
+    {
+        MRTentry_reset(bulk);
+        process_prefix_list(buffer, len, afi, bulk, 0);
+    }
+    tBulk = now() - start;
+
+    printf("%s, %d prefixes per list, identical outputs\n", afi == BGP_IPV6_AFI ? "IPv6" : "IPv4", nb);
+    printf("    prefix per prefix:   %8.2f ns/prefix\n", tLoop * 1e9 / rounds / nb);
+    printf("    process_prefix_list: %8.2f ns/prefix (x%.1f)\n", tBulk * 1e9 / rounds / nb, tLoop / tBulk);
+
+    MRTentry_free(loop);
+    MRTentry_free(bulk);
+    free(buffer);
+}
+
+
+int main(int argc, char** argv)
+{
+    int nb = argc > 1 ? atoi(argv[1]) : DEFAULT_NB_PREFIXES;
+    int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_NB_ROUNDS;
+
+    if (nb <= 0 || nb > 0xffff || rounds <= 0)
+    {
+        printf("Usage: %s [number_of_prefixes_per_list] [number_of_rounds]\n", argv[0]);
+        return 1;
+    }
+
+    bench(BGP_IPV4_AFI, nb, rounds);
+    bench(BGP_IPV6_AFI, nb, rounds);
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Benchmark of Prefix_to_str against the former inet_ntop + snprintf implementation. Both are
+ * run on the same random prefixes (plus the IPv6 corner cases of the zero compression and of
+ * the embedded IPv4 addresses), and their outputs are checked to be byte-identical.
+ *
+ * Usage: ./bench_prefix [number_of_prefixes]
+ */
+
+#include "mrt_entry.h"
+#include "bgp_macros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#define DEFAULT_NB_PREFIXES 1000000
+
+
+/* Former implementation of Prefix_to_str */
+static int Prefix_to_str_ntop(const Prefix_t* pfx, char* string, int len)
+{
+    char tmp_str[52];
+    int ret;
+
+    if (inet_ntop(pfx->afi == BGP_IPV6_AFI ? AF_INET6 : AF_INET, pfx->pfx, tmp_str, 52) == NULL)
+    {
+        return -1;
+    }
+
+    ret = snprintf(string, len, "%s/%d", tmp_str, pfx->pfxLen);
+    if (ret >= len)
+    {
+        return -1;
+    }
+
+    return ret;
+}
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static void random_prefix(Prefix_t* pfx, unsigned int* seed)
+{
+    memset(pfx, 0, sizeof(Prefix_t));
+
+    if (rand_r(seed) % 4)
+    {
+        pfx->afi = BGP_IPV4_AFI;
+        pfx->pfxLen = rand_r(seed) % 33;
+
+        for (int i = 0 ; i < 4 ; i++)
+        {
+            pfx->pfx[i] = rand_r(seed);
+        }
+    }
+    else
+    {
+        pfx->afi = BGP_IPV6_AFI;
+        pfx->pfxLen = rand_r(seed) % 129;
+
+        /* Mostly zero words, to exercise the "::" compression */
+        for (int i = 0 ; i < 16 ; i += 2)
+        {
+            if (rand_r(seed) % 2)
+            {
+                pfx->pfx[i] = rand_r(seed) % 3 ? 0 : rand_r(seed);
+                pfx->pfx[i + 1] = rand_r(seed);
+            }
+        }
+
+        /* IPv4-mapped and IPv4-compatible addresses */
+        if (rand_r(seed) % 8 == 0)
+        {
+            memset(pfx->pfx, 0, 12);
+            if (rand_r(seed) % 2)
+            {
+                pfx->pfx[10] = pfx->pfx[11] = 0xff;
+            }
+        }
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    int nb = argc > 1 ? atoi(argv[1]) : DEFAULT_NB_PREFIXES;
+    unsigned int seed = 42;
+    char str1[64], str2[64];
+    size_t total = 0;
+    Prefix_t* pfx;
+    double start, tNtop, tFast;
+    int len1, len2;
+
+    if (nb <= 0 || (pfx = malloc(nb * sizeof(Prefix_t))) == NULL)
+    {
+        printf("Usage: %s [number_of_prefixes]\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0 ; i < nb ; i++)
+    {
+        random_prefix(&pfx[i], &seed);
+    }
+
+    for (int i = 0 ; i < nb ; i++)
+    {
+        len1 = Prefix_to_str_ntop(&pfx[i], str1, sizeof(str1));
+        len2 = Prefix_to_str(&pfx[i], str2, sizeof(str2));
+
+        if (len1 != len2 || strcmp(str1, str2) != 0)
+        {
+            printf("Mismatch: inet_ntop gives '%s', Prefix_to_str gives '%s'\n", str1, str2);
+            free(pfx);
+            return 1;
+        }
+    }
+
+    start = now();
+    for (int i = 0 ; i < nb ; i++)
+    {
+        total += Prefix_to_str_ntop(&pfx[i], str1, sizeof(str1));
+    }
+    tNtop = now() - start;
+
+    start = now();
+    for (int i = 0 ; i < nb ; i++)
+    {
+        total += Prefix_to_str(&pfx[i], str2, sizeof(str2));
+    }
+    tFast = now() - start;
+
+    printf("%d prefixes, identical outputs (%zu bytes)\n", nb, total / 2);
+    printf("inet_ntop + snprintf: %8.1f ns/prefix\n", tNtop * 1e9 / nb);
+    printf("Prefix_to_str:        %8.1f ns/prefix (x%.1f)\n", tFast * 1e9 / nb, tNtop / tFast);
+
+    free(pfx);
+
+    return 0;
+}
@@ -40,6 +40,8 @@
 #define BGP_UPDATE_NLRI_COMMUNITIES 0x08
 #define BGP_UPDATE_ATTR_NLRI        0x0e
 #define BGP_UPDATE_NLRI_UNREACH     0x0f
+#define BGP_UPDATE_ATTR_EXT_COMMUNITIES     0x10
+#define BGP_UPDATE_ATTR_LARGE_COMMUNITIES   0x20
 
 /* SUBVALUES FOR BGP ATTRIBUTES */
 #define BGP_UPDATE_ORIGIN_IGP           0x00
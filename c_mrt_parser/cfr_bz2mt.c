@@ -0,0 +1,986 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "cfr_bz2mt.h"
+#include "gillstream-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <bzlib.h>
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#define BZ2MT_USE_MMAP
+#endif
+
+#define BZ2_MAGIC_MASK  0xffffffffffffULL
+
+#define SLOT_FREE   0
+#define SLOT_BUSY   1
+#define SLOT_READY  2
+#define SLOT_ERROR  3
+
+/* Maximum number of boundaries (following a block that cannot be decompressed) tried as the
+ * end of this block, in case a false magic number in the compressed data split it */
+#define BZ2MT_MAX_JOIN  4
+
+
+/**
+ * @brief Slot in which a worker thread writes a decompressed block.
+ */
+typedef struct
+{
+    size_t index;
+    int    state;
+    int    error;
+    char*  data;
+    size_t len;
+    size_t size;
+} bz2_slot_t;
+
+
+struct _CFR_BZ2MT
+{
+    /* Compressed data */
+    const unsigned char* in;
+    size_t  in_len;
+    int     in_mapped;
+
+    /* First block to decompress (offset in bits) */
+    uint64_t first_bit;
+
+    /* Offset of the next byte read in the decompressed stream, and number of blocks whose
+     * decompressed offset is known */
+    uint64_t out_pos;
+    size_t   nb_out;
+
+    /* Blocks located by the scanner (only the ones whose end is known) */
+    bz2_block_t* blocks;
+    size_t  nb_blocks;
+    size_t  blocks_size;
+    int     scan_done;
+
+    /* Ring of decompressed blocks */
+    bz2_slot_t* slots;
+    size_t  nb_slots;
+    size_t  next_task;
+    size_t  next_read;
+    size_t  read_pos;
+
+    int     stop;
+
+    /* Block that could only be decompressed joined with the next located blocks, and number of
+     * located blocks covered beyond the first one (skipped once it is read) */
+    char*   joined;
+    size_t  joined_len;
+    size_t  joined_size;
+    int     joined_active;
+    size_t  joined_blocks;
+    size_t  skip;
+
+    /* Single-threaded decoder taking over from a block that cannot be decompressed at all. Its
+     * first stream is rebuilt from this block (in_rebuilt), the next ones are read in place */
+    int       fallback;
+    int       fb_init;
+    int       fb_done;
+    bz_stream fb;
+    unsigned char* fb_rebuilt;
+    uint64_t  fb_start;
+
+    int        scanner_started;
+    pthread_t  scanner;
+    pthread_t* workers;
+    int        nb_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+};
+
+
+/**
+ * @brief Callback called by the block scanner each time the location of a block is known.
+ */
+typedef int (*bz2_found_cb)(void* ctx, uint64_t start, uint64_t end);
+
+
+static void bz2_scan(const unsigned char* in, size_t len, bz2_found_cb found, void* ctx)
+{
+    uint64_t window = 0;
+    uint64_t blockStart = 0;
+    int inBlock = 0;
+
+    for (size_t i = 0 ; i < len ; i++)
+    {
+        window = (window << 8) | in[i];
+
+        /* The first magic number cannot end before bit 80 (after "BZh" and the level) */
+        if (i < 7)
+        {
+            continue;
+        }
+
+        /* Check the 8 bit-offsets at which a magic number may end in this byte, from the
+         * lowest bit offset to the highest one */
+        for (int shift = 7 ; shift >= 0 ; shift--)
+        {
+            uint64_t val = (window >> shift) & BZ2_MAGIC_MASK;
+
+            if (val != BZ2_BLOCK_MAGIC && val != BZ2_EOS_MAGIC)
+            {
+                continue;
+            }
+
+            uint64_t pos = (uint64_t)(i + 1) * 8 - shift - 48;
+
+            if (inBlock && found(ctx, blockStart, pos) == 0)
+            {
+                return;
+            }
+
+            inBlock = (val == BZ2_BLOCK_MAGIC);
+            blockStart = pos;
+        }
+    }
+
+    /* Truncated stream: the last block ends with the data, and will fail to decompress */
+    if (inBlock)
+    {
+        found(ctx, blockStart, (uint64_t)len * 8);
+    }
+}
+
+
+static int bz2_append_block(bz2_block_t** blocks, size_t* nb, size_t* size, uint64_t start, uint64_t end)
+{
+    if (*nb == *size)
+    {
+        size_t newSize = *size ? *size * 2 : 256;
+        bz2_block_t* tmp = realloc(*blocks, newSize * sizeof(bz2_block_t));
+
+        if (!tmp)
+        {
+            return 0;
+        }
+
+        *blocks = tmp;
+        *size = newSize;
+    }
+
+    (*blocks)[*nb].start = start;
+    (*blocks)[*nb].end   = end;
+    (*blocks)[*nb].out   = 0;
+    (*nb)++;
+
+    return 1;
+}
+
+
+typedef struct
+{
+    bz2_block_t* blocks;
+    size_t nb;
+    size_t size;
+    int error;
+} bz2_list_t;
+
+
+static int bz2_list_found(void* ctx, uint64_t start, uint64_t end)
+{
+    bz2_list_t* list = ctx;
+
+    if (!bz2_append_block(&list->blocks, &list->nb, &list->size, start, end))
+    {
+        list->error = 1;
+        return 0;
+    }
+
+    return 1;
+}
+
+
+bz2_block_t* cfr_bz2_scan_blocks(const unsigned char* in, size_t len, size_t* nb)
+{
+    bz2_list_t list = {NULL, 0, 0, 0};
+
+    bz2_scan(in, len, bz2_list_found, &list);
+
+    if (list.error || list.nb == 0)
+    {
+        free(list.blocks);
+        *nb = 0;
+        return NULL;
+    }
+
+    *nb = list.nb;
+    return list.blocks;
+}
+
+
+/**
+ * @brief Simple bit writer, used to rebuild a standalone bzip2 stream around a block.
+ */
+typedef struct
+{
+    unsigned char* out;
+    size_t   pos;
+    uint64_t acc;
+    int      nbits;
+} bit_writer_t;
+
+
+static void put_bits(bit_writer_t* w, uint64_t val, int nbits)
+{
+    for (int i = nbits - 1 ; i >= 0 ; i--)
+    {
+        w->acc = (w->acc << 1) | ((val >> i) & 1);
+        w->nbits++;
+
+        if (w->nbits == 8)
+        {
+            w->out[w->pos++] = (unsigned char)w->acc;
+            w->acc = 0;
+            w->nbits = 0;
+        }
+    }
+}
+
+
+static uint64_t get_bits(const unsigned char* in, uint64_t pos, int nbits)
+{
+    uint64_t val = 0;
+
+    for (int i = 0 ; i < nbits ; i++, pos++)
+    {
+        val = (val << 1) | ((in[pos >> 3] >> (7 - (pos & 7))) & 1);
+    }
+
+    return val;
+}
+
+
+int cfr_bz2_decompress_block(const unsigned char* in, const bz2_block_t* block, char** out, size_t* outSize, size_t* outLen)
+{
+    uint64_t nbits = block->end - block->start;
+    size_t   nbytes = nbits / 8;
+    uint64_t pos = block->start;
+    bit_writer_t w;
+    bz_stream strm;
+    int ret;
+
+    /* Header, block bits, end of stream magic, stream CRC and padding */
+    w.out = malloc(4 + nbytes + 1 + 6 + 4 + 1);
+    w.pos = 0;
+    w.acc = 0;
+    w.nbits = 0;
+
+    if (!w.out)
+    {
+        return BZ_MEM_ERROR;
+    }
+
+    memcpy(w.out, "BZh9", 4);
+    w.pos = 4;
+
+    /* Copy the block byte by byte, whatever its bit alignment */
+    if ((pos & 7) == 0)
+    {
+        memcpy(w.out + w.pos, in + (pos >> 3), nbytes);
+        w.pos += nbytes;
+    }
+    else
+    {
+        int shift = pos & 7;
+        const unsigned char* src = in + (pos >> 3);
+
+        for (size_t i = 0 ; i < nbytes ; i++)
+        {
+            w.out[w.pos++] = (unsigned char)((src[i] << shift) | (src[i + 1] >> (8 - shift)));
+        }
+    }
+    pos += (uint64_t)nbytes * 8;
+    put_bits(&w, get_bits(in, pos, nbits & 7), nbits & 7);
+
+    /* A single-block stream has the CRC of its block as stream CRC */
+    put_bits(&w, BZ2_EOS_MAGIC, 48);
+    put_bits(&w, get_bits(in, block->start + 48, 32), 32);
+    if (w.nbits)
+    {
+        put_bits(&w, 0, 8 - w.nbits);
+    }
+
+    memset(&strm, 0, sizeof(strm));
+    if ((ret = BZ2_bzDecompressInit(&strm, 0, 0)) != BZ_OK)
+    {
+        free(w.out);
+        return ret;
+    }
+
+    if (*out == NULL || *outSize == 0)
+    {
+        *outSize = 1024 * 1024;
+        free(*out);
+        if ((*out = malloc(*outSize)) == NULL)
+        {
+            *outSize = 0;
+            BZ2_bzDecompressEnd(&strm);
+            free(w.out);
+            return BZ_MEM_ERROR;
+        }
+    }
+
+    strm.next_in = (char*)w.out;
+    strm.avail_in = w.pos;
+    *outLen = 0;
+
+    do
+    {
+        if (*outLen == *outSize)
+        {
+            char* tmp = realloc(*out, *outSize * 2);
+
+            if (!tmp)
+            {
+                ret = BZ_MEM_ERROR;
+                break;
+            }
+
+            *out = tmp;
+            *outSize *= 2;
+        }
+
+        strm.next_out = *out + *outLen;
+        strm.avail_out = *outSize - *outLen;
+
+        ret = BZ2_bzDecompress(&strm);
+        *outLen = *outSize - strm.avail_out;
+
+        /* The whole input is available, no progress means a corrupted block */
+        if (ret == BZ_OK && strm.avail_in == 0 && strm.avail_out != 0)
+        {
+            ret = BZ_UNEXPECTED_EOF;
+        }
+    }
+    while (ret == BZ_OK);
+
+    BZ2_bzDecompressEnd(&strm);
+    free(w.out);
+
+    return ret == BZ_STREAM_END ? BZ_OK : ret;
+}
+
+
+static int bz2mt_found(void* ctx, uint64_t start, uint64_t end)
+{
+    CFR_BZ2MT* mt = ctx;
+    uint64_t base = (mt->first_bit / 8 >= 8) ? (mt->first_bit / 8 - 8) * 8 : 0;
+    int ret;
+
+    /* The scan started a few bytes before the first block */
+    start += base;
+    end += base;
+    if (start < mt->first_bit)
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock(&mt->lock);
+    ret = !mt->stop && bz2_append_block(&mt->blocks, &mt->nb_blocks, &mt->blocks_size, start, end);
+    pthread_cond_broadcast(&mt->cond);
+    pthread_mutex_unlock(&mt->lock);
+
+    return ret;
+}
+
+
+static void* bz2mt_scanner(void* arg)
+{
+    CFR_BZ2MT* mt = arg;
+
+    /* Start a few bytes before the first block, as the scanner needs a whole magic number to
+     * follow its first bytes */
+    size_t base = (mt->first_bit / 8 >= 8) ? mt->first_bit / 8 - 8 : 0;
+
+    bz2_scan(mt->in + base, mt->in_len - base, bz2mt_found, mt);
+
+    pthread_mutex_lock(&mt->lock);
+    mt->scan_done = 1;
+    pthread_cond_broadcast(&mt->cond);
+    pthread_mutex_unlock(&mt->lock);
+
+    return NULL;
+}
+
+
+static void* bz2mt_worker(void* arg)
+{
+    CFR_BZ2MT* mt = arg;
+    bz2_slot_t* slot;
+    bz2_block_t block;
+    size_t index;
+    int ret;
+
+    pthread_mutex_lock(&mt->lock);
+
+    while (!mt->stop)
+    {
+        index = mt->next_task;
+
+        /* Next block is located and its slot has been read */
+        if (index < mt->nb_blocks && index < mt->next_read + mt->nb_slots)
+        {
+            mt->next_task++;
+            slot = &mt->slots[index % mt->nb_slots];
+            slot->index = index;
+            slot->state = SLOT_BUSY;
+            block = mt->blocks[index];
+            pthread_mutex_unlock(&mt->lock);
+
+            ret = cfr_bz2_decompress_block(mt->in, &block, &slot->data, &slot->size, &slot->len);
+
+            pthread_mutex_lock(&mt->lock);
+            slot->error = ret;
+            slot->state = (ret == BZ_OK) ? SLOT_READY : SLOT_ERROR;
+            pthread_cond_broadcast(&mt->cond);
+            continue;
+        }
+
+        /* Nothing left to decompress */
+        if (mt->scan_done && index >= mt->nb_blocks)
+        {
+            break;
+        }
+
+        pthread_cond_wait(&mt->cond, &mt->lock);
+    }
+
+    pthread_mutex_unlock(&mt->lock);
+
+    return NULL;
+}
+
+
+CFR_BZ2MT* cfr_bz2mt_open(FILE* in, int threads)
+{
+    return cfr_bz2mt_open_at(in, threads, 0, 0);
+}
+
+
+CFR_BZ2MT* cfr_bz2mt_open_at(FILE* in, int threads, uint64_t start, uint64_t out)
+{
+    CFR_BZ2MT* mt;
+    struct stat st;
+    int fd = fileno(in);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    /* More workers than CPUs only make them evict each other's tables from the caches */
+    if (cpus > 0 && threads > cpus)
+    {
+        threads = cpus;
+    }
+
+    if (threads < 1 || (mt = calloc(1, sizeof(CFR_BZ2MT))) == NULL)
+    {
+        return NULL;
+    }
+
+    /* Initialized first, as cfr_bz2mt_close uses them on every error */
+    pthread_mutex_init(&mt->lock, NULL);
+    pthread_cond_init(&mt->cond, NULL);
+
+    /* Get the whole compressed file in memory */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+#ifdef BZ2MT_USE_MMAP
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map != MAP_FAILED)
+        {
+            mt->in = map;
+            mt->in_len = st.st_size;
+            mt->in_mapped = 1;
+        }
+#endif
+    }
+
+    if (!mt->in)
+    {
+        size_t size = 1024 * 1024;
+        size_t len = 0;
+        size_t ret;
+        unsigned char* buf = malloc(size);
+
+        while (buf && (ret = fread(buf + len, 1, size - len, in)) > 0)
+        {
+            len += ret;
+            if (len == size)
+            {
+                unsigned char* tmp = realloc(buf, size * 2);
+                if (!tmp)
+                {
+                    free(buf);
+                    buf = NULL;
+                    break;
+                }
+                buf = tmp;
+                size *= 2;
+            }
+        }
+
+        if (!buf || ferror(in))
+        {
+            free(buf);
+            cfr_bz2mt_close(mt);
+            return NULL;
+        }
+
+        mt->in = buf;
+        mt->in_len = len;
+    }
+
+    if (start / 8 >= mt->in_len)
+    {
+        mt->nb_workers = 0;
+        cfr_bz2mt_close(mt);
+        return NULL;
+    }
+
+    mt->first_bit = start;
+    mt->out_pos = out;
+
+    mt->nb_workers = threads;
+    mt->nb_slots = threads * BZ2MT_BLOCKS_PER_THREAD;
+    mt->slots = calloc(mt->nb_slots, sizeof(bz2_slot_t));
+    mt->workers = calloc(threads, sizeof(pthread_t));
+
+    if (!mt->slots || !mt->workers || pthread_create(&mt->scanner, NULL, bz2mt_scanner, mt) != 0)
+    {
+        mt->nb_workers = 0;
+        cfr_bz2mt_close(mt);
+        return NULL;
+    }
+    mt->scanner_started = 1;
+
+    for (int i = 0 ; i < threads ; i++)
+    {
+        if (pthread_create(&mt->workers[i], NULL, bz2mt_worker, mt) != 0)
+        {
+            mt->nb_workers = i;
+            cfr_bz2mt_close(mt);
+            return NULL;
+        }
+    }
+
+    return mt;
+}
+
+
+/* Stops the scanner and the worker threads of a decoder */
+static void bz2mt_stop_threads(CFR_BZ2MT* mt)
+{
+    pthread_mutex_lock(&mt->lock);
+    mt->stop = 1;
+    pthread_cond_broadcast(&mt->cond);
+    pthread_mutex_unlock(&mt->lock);
+
+    if (mt->scanner_started)
+    {
+        pthread_join(mt->scanner, NULL);
+        mt->scanner_started = 0;
+    }
+
+    for (int i = 0 ; i < mt->nb_workers ; i++)
+    {
+        pthread_join(mt->workers[i], NULL);
+    }
+    mt->nb_workers = 0;
+}
+
+
+/* Decompresses the block being read (which failed) up to one of the next boundaries, in case a
+ * false magic number split it. Returns 1 if a joined block could be decompressed */
+static int bz2mt_join(CFR_BZ2MT* mt)
+{
+    size_t k = mt->next_read;
+    bz2_block_t block;
+    bz2_block_t next;
+    int tries = 0;
+
+    pthread_mutex_lock(&mt->lock);
+    block = mt->blocks[k];
+    pthread_mutex_unlock(&mt->lock);
+
+    for (size_t i = k + 1 ; tries < BZ2MT_MAX_JOIN ; i++)
+    {
+        pthread_mutex_lock(&mt->lock);
+        while (i >= mt->nb_blocks && !mt->scan_done && !mt->stop)
+        {
+            pthread_cond_wait(&mt->cond, &mt->lock);
+        }
+
+        if (i >= mt->nb_blocks)
+        {
+            pthread_mutex_unlock(&mt->lock);
+            return 0;
+        }
+        next = mt->blocks[i];
+        pthread_mutex_unlock(&mt->lock);
+
+        /* A false end of stream magic number leaves a gap up to the next block, which is tried
+         * first as the end of the block, then the end of the next block */
+        for (int step = (next.start > block.end) ? 0 : 1 ; step < 2 && tries < BZ2MT_MAX_JOIN ; step++, tries++)
+        {
+            block.end = step ? next.end : next.start;
+
+            if (cfr_bz2_decompress_block(mt->in, &block, &mt->joined, &mt->joined_size, &mt->joined_len) != BZ_OK)
+            {
+                continue;
+            }
+
+            /* The blocks covered by the joined block are located at it, for cfr_bz2mt_block_at */
+            pthread_mutex_lock(&mt->lock);
+            mt->blocks[k].end = block.end;
+            for (size_t j = k + 1 ; j < i + step ; j++)
+            {
+                mt->blocks[j] = mt->blocks[k];
+            }
+            pthread_mutex_unlock(&mt->lock);
+
+            mt->joined_active = 1;
+            mt->joined_blocks = i + step - k - 1;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Takes over the decompression from the block being read with a single-threaded decoder. The
+ * block is wrapped in a rebuilt stream that holds all the data from the block onwards. Returns
+ * 1 if the decoder could be started */
+static int bz2mt_fallback_start(CFR_BZ2MT* mt)
+{
+    uint64_t start = mt->blocks[mt->next_read].start;
+    size_t from = start >> 3;
+    int shift = start & 7;
+    size_t len = mt->in_len - from;
+
+    bz2mt_stop_threads(mt);
+
+    if ((mt->fb_rebuilt = malloc(4 + len)) == NULL)
+    {
+        return 0;
+    }
+
+    memcpy(mt->fb_rebuilt, "BZh9", 4);
+    for (size_t i = 0 ; i < len ; i++)
+    {
+        mt->fb_rebuilt[4 + i] = (unsigned char)((mt->in[from + i] << shift) |
+            ((shift && from + i + 1 < mt->in_len) ? mt->in[from + i + 1] >> (8 - shift) : 0));
+    }
+
+    memset(&mt->fb, 0, sizeof(bz_stream));
+    if (BZ2_bzDecompressInit(&mt->fb, 0, 0) != BZ_OK)
+    {
+        return 0;
+    }
+
+    mt->fb_init = 1;
+    mt->fb.next_in = (char*)mt->fb_rebuilt;
+    mt->fb.avail_in = 4 + len;
+    mt->fb_start = start;
+    mt->fallback = 1;
+
+    return 1;
+}
+
+
+/* Returns the offset of the bzip2 stream starting at one of the given offsets, 0 if none */
+static size_t bz2mt_stream_at(CFR_BZ2MT* mt, size_t first, size_t last)
+{
+    for (size_t pos = first ; pos <= last ; pos++)
+    {
+        if (pos + 4 <= mt->in_len && memcmp(mt->in + pos, "BZh", 3) == 0 &&
+            mt->in[pos + 3] >= '1' && mt->in[pos + 3] <= '9')
+        {
+            return pos;
+        }
+    }
+
+    return 0;
+}
+
+
+static size_t bz2mt_fallback_read(CFR_BZ2MT* mt, char* ptr, size_t bytes, int* error)
+{
+    size_t done = 0;
+    size_t next;
+    uint64_t end;
+    char probe;
+    int ret;
+
+    while (done < bytes && !mt->fb_done)
+    {
+        mt->fb.next_out = ptr + done;
+        mt->fb.avail_out = bytes - done;
+
+        ret = BZ2_bzDecompress(&mt->fb);
+        done = bytes - mt->fb.avail_out;
+
+        /* The CRC of the rebuilt stream also covers the blocks preceding its first one, so it
+         * does not match once its last block is decoded (each block CRC is still checked).
+         * The decoder is then idle instead of being stuck on the error */
+        if (ret == BZ_DATA_ERROR && mt->fb_rebuilt)
+        {
+            mt->fb.next_out = &probe;
+            mt->fb.avail_out = 1;
+            if (BZ2_bzDecompress(&mt->fb) == BZ_SEQUENCE_ERROR)
+            {
+                ret = BZ_STREAM_END;
+            }
+        }
+
+        if (ret == BZ_STREAM_END)
+        {
+            /* The next stream is byte-aligned in the compressed data. The decoder only consumes
+             * the bytes holding the end of the stream, which is known up to 7 bits in the
+             * rebuilt stream */
+            if (mt->fb_rebuilt)
+            {
+                end = mt->fb_start + ((char*)mt->fb.next_in - (char*)mt->fb_rebuilt) * 8 - 32;
+                next = bz2mt_stream_at(mt, end / 8, (end + 7) / 8);
+                free(mt->fb_rebuilt);
+                mt->fb_rebuilt = NULL;
+            }
+            else
+            {
+                next = bz2mt_stream_at(mt, (const unsigned char*)mt->fb.next_in - mt->in,
+                    (const unsigned char*)mt->fb.next_in - mt->in);
+            }
+
+            BZ2_bzDecompressEnd(&mt->fb);
+            mt->fb_init = 0;
+
+            memset(&mt->fb, 0, sizeof(bz_stream));
+            if (next == 0 || BZ2_bzDecompressInit(&mt->fb, 0, 0) != BZ_OK)
+            {
+                mt->fb_done = 1;
+                break;
+            }
+
+            mt->fb_init = 1;
+            mt->fb.next_in = (char*)mt->in + next;
+            mt->fb.avail_in = mt->in_len - next;
+            continue;
+        }
+
+        /* The whole input is available, no progress means a truncated stream */
+        if (ret == BZ_OK && mt->fb.avail_in == 0 && mt->fb.avail_out != 0)
+        {
+            ret = BZ_UNEXPECTED_EOF;
+        }
+
+        if (ret != BZ_OK)
+        {
+            *error = ret;
+            mt->fb_done = 1;
+            break;
+        }
+    }
+
+    mt->out_pos += done;
+
+    return done;
+}
+
+
+/* Gives the slot of the block being read back to the workers */
+static void bz2mt_release(CFR_BZ2MT* mt, bz2_slot_t* slot)
+{
+    pthread_mutex_lock(&mt->lock);
+    slot->state = SLOT_FREE;
+    mt->next_read++;
+    mt->read_pos = 0;
+    pthread_cond_broadcast(&mt->cond);
+    pthread_mutex_unlock(&mt->lock);
+}
+
+
+size_t cfr_bz2mt_read(CFR_BZ2MT* mt, void* ptr, size_t bytes, int* error)
+{
+    size_t done = 0;
+    size_t n;
+    size_t len;
+    const char* data;
+    bz2_slot_t* slot;
+
+    *error = BZ_OK;
+
+    while (done < bytes)
+    {
+        if (mt->fallback)
+        {
+            return done + bz2mt_fallback_read(mt, (char*)ptr + done, bytes - done, error);
+        }
+
+        pthread_mutex_lock(&mt->lock);
+
+        for (;;)
+        {
+            slot = &mt->slots[mt->next_read % mt->nb_slots];
+
+            if (slot->index == mt->next_read && (slot->state == SLOT_READY || slot->state == SLOT_ERROR))
+            {
+                if (mt->read_pos == 0 && mt->skip == 0)
+                {
+                    mt->blocks[mt->next_read].out = mt->out_pos;
+                }
+                mt->nb_out = mt->next_read + 1;
+                break;
+            }
+
+            /* End of the data */
+            if (mt->scan_done && mt->next_read >= mt->nb_blocks)
+            {
+                pthread_mutex_unlock(&mt->lock);
+                return done;
+            }
+
+            pthread_cond_wait(&mt->cond, &mt->lock);
+        }
+
+        pthread_mutex_unlock(&mt->lock);
+
+        /* Blocks covered by the joined block read last */
+        if (mt->skip > 0)
+        {
+            mt->skip--;
+            bz2mt_release(mt, slot);
+            continue;
+        }
+
+        if (slot->state == SLOT_ERROR && !mt->joined_active && !bz2mt_join(mt))
+        {
+            if (bz2mt_fallback_start(mt))
+            {
+                continue;
+            }
+
+            *error = slot->error;
+            return done;
+        }
+
+        data = mt->joined_active ? mt->joined : slot->data;
+        len  = mt->joined_active ? mt->joined_len : slot->len;
+
+        n = len - mt->read_pos;
+        if (n > bytes - done)
+        {
+            n = bytes - done;
+        }
+
+        memcpy((char*)ptr + done, data + mt->read_pos, n);
+        mt->read_pos += n;
+        mt->out_pos += n;
+        done += n;
+
+        /* Block entirely read, give its slot back to the workers */
+        if (mt->read_pos == len)
+        {
+            if (mt->joined_active)
+            {
+                mt->joined_active = 0;
+                mt->skip = mt->joined_blocks;
+            }
+            bz2mt_release(mt, slot);
+        }
+    }
+
+    return done;
+}
+
+
+int cfr_bz2mt_block_at(CFR_BZ2MT* mt, uint64_t offset, bz2_block_t* block)
+{
+    size_t lo = 0;
+    size_t hi;
+    int ret = 0;
+
+    pthread_mutex_lock(&mt->lock);
+
+    hi = mt->nb_out;
+
+    if (hi > 0 && offset >= mt->blocks[0].out && offset < mt->out_pos)
+    {
+        /* Last block starting at or before the offset */
+        while (hi - lo > 1)
+        {
+            size_t mid = (lo + hi) / 2;
+
+            if (mt->blocks[mid].out <= offset)
+            {
+                lo = mid;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        *block = mt->blocks[lo];
+        ret = 1;
+    }
+
+    pthread_mutex_unlock(&mt->lock);
+
+    return ret;
+}
+
+
+void cfr_bz2mt_close(CFR_BZ2MT* mt)
+{
+    if (!mt)
+    {
+        return;
+    }
+
+    bz2mt_stop_threads(mt);
+
+    if (mt->fb_init)
+    {
+        BZ2_bzDecompressEnd(&mt->fb);
+    }
+    free(mt->fb_rebuilt);
+    free(mt->joined);
+
+    for (size_t i = 0 ; mt->slots && i < mt->nb_slots ; i++)
+    {
+        free(mt->slots[i].data);
+    }
+
+#ifdef BZ2MT_USE_MMAP
+    if (mt->in_mapped)
+    {
+        munmap((void*)mt->in, mt->in_len);
+    }
+    else
+#endif
+    {
+        free((void*)mt->in);
+    }
+
+    pthread_mutex_destroy(&mt->lock);
+    pthread_cond_destroy(&mt->cond);
+
+    free(mt->slots);
+    free(mt->workers);
+    free(mt->blocks);
+    free(mt);
+}
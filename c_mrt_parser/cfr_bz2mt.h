@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __CFR_BZ2MT_H__
+#define __CFR_BZ2MT_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* 48-bit magic numbers starting each bzip2 block, and ending each bzip2 stream */
+#define BZ2_BLOCK_MAGIC     0x314159265359ULL
+#define BZ2_EOS_MAGIC       0x177245385090ULL
+
+/* Number of decompressed blocks that can wait to be read, per worker thread */
+#define BZ2MT_BLOCKS_PER_THREAD 2
+
+
+/**
+ * @brief Structure representing a multi-threaded bzip2 decoder. bzip2 streams are made
+ * of blocks that can be decompressed independently. The decoder locates the blocks by
+ * their magic number (blocks are not byte-aligned), decompresses them on a pool of worker
+ * threads, and delivers the decompressed data in order.
+ *
+ * As a magic number may also appear inside the compressed data, a block that cannot be
+ * decompressed is retried up to the next boundaries, and the rest of the data is decompressed
+ * by a single thread (from this block) if none works.
+ */
+typedef struct _CFR_BZ2MT CFR_BZ2MT;
+
+
+/**
+ * @brief Structure locating a bzip2 block in the compressed data.
+ */
+typedef struct
+{
+    /**
+     * @brief Offset (in bits) of the block magic number.
+     */
+    uint64_t start;
+
+    /**
+     * @brief Offset (in bits) of the magic number following the block, i.e., the end of
+     * the block.
+     */
+    uint64_t end;
+
+    /**
+     * @brief Offset of the decompressed data of the block in the decompressed stream, only
+     * known once the block is being read from a multi-threaded decoder.
+     */
+    uint64_t out;
+} bz2_block_t;
+
+
+/**
+ * @brief Opens a multi-threaded decoder reading the whole bzip2 file given in argument.
+ * Concatenated bzip2 streams are supported. Nothing must have been read from the file yet.
+ *
+ * @param in        File from which the compressed data is read.
+ * @param threads   Number of worker threads decompressing the blocks (at most the number of
+ * online CPUs).
+ *
+ * @return CFR_BZ2MT*   Returns a pointer to the decoder, NULL if it cannot be started.
+ */
+CFR_BZ2MT* cfr_bz2mt_open(FILE* in, int threads);
+
+
+/**
+ * @brief Opens a multi-threaded decoder reading a bzip2 file from one of its blocks, i.e.,
+ * skipping the decompression of all the previous blocks.
+ *
+ * @param in        File from which the compressed data is read.
+ * @param threads   Number of worker threads decompressing the blocks.
+ * @param start     Offset (in bits) of the magic number of the first block to decompress.
+ * @param out       Offset of the decompressed data of this block in the decompressed stream,
+ * from which the offsets of the next blocks are counted.
+ *
+ * @return CFR_BZ2MT*   Returns a pointer to the decoder, NULL if it cannot be started.
+ */
+CFR_BZ2MT* cfr_bz2mt_open_at(FILE* in, int threads, uint64_t start, uint64_t out);
+
+
+/**
+ * @brief Reads decompressed data from a multi-threaded decoder, in the order of the file.
+ *
+ * @param mt        Pointer to the decoder.
+ * @param ptr       Buffer in which the decompressed data is written.
+ * @param bytes     Number of bytes to read.
+ * @param error     Set to a BZ_* error code in case a block cannot be decompressed, BZ_OK
+ * otherwise.
+ *
+ * @return size_t   Returns the number of bytes read, which is lower than bytes only at the
+ * end of the data or in case of error.
+ */
+size_t cfr_bz2mt_read(CFR_BZ2MT* mt, void* ptr, size_t bytes, int* error);
+
+
+/**
+ * @brief Stops the worker threads of a multi-threaded decoder and frees it. The file given
+ * to cfr_bz2mt_open is not closed.
+ *
+ * @param mt        Pointer to the decoder.
+ */
+void cfr_bz2mt_close(CFR_BZ2MT* mt);
+
+
+/**
+ * @brief Finds the block holding a given offset of the decompressed stream, among the blocks
+ * that have already been read from a multi-threaded decoder.
+ *
+ * @param mt        Pointer to the decoder.
+ * @param offset    Offset in the decompressed stream.
+ * @param block     Set to the location of the block (including its decompressed offset).
+ *
+ * @return int      Returns 1 if the block was found, 0 otherwise.
+ */
+int cfr_bz2mt_block_at(CFR_BZ2MT* mt, uint64_t offset, bz2_block_t* block);
+
+
+/**
+ * @brief Locates all the bzip2 blocks of a compressed buffer.
+ *
+ * @param in        Compressed data.
+ * @param len       Length of the compressed data, in bytes.
+ * @param nb        Set to the number of blocks found.
+ *
+ * @return bz2_block_t*     Returns the (allocated) list of blocks, NULL if no memory can be
+ * allocated or if no block is found.
+ */
+bz2_block_t* cfr_bz2_scan_blocks(const unsigned char* in, size_t len, size_t* nb);
+
+
+/**
+ * @brief Decompresses a single bzip2 block, by wrapping it into a standalone bzip2 stream.
+ *
+ * @param in        Compressed data containing the block.
+ * @param block     Location of the block in the compressed data.
+ * @param out       Pointer to the (allocated) output buffer, grown if needed.
+ * @param outSize   Pointer to the size of the output buffer.
+ * @param outLen    Set to the number of decompressed bytes.
+ *
+ * @return int      Returns BZ_OK if the block was decompressed, a BZ_* error code otherwise.
+ */
+int cfr_bz2_decompress_block(const unsigned char* in, const bz2_block_t* block, char** out, size_t* outSize, size_t* outLen);
+
+#endif
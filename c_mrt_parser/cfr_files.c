@@ -23,7 +23,16 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "cfr_files.h"
+#include "cfr_bz2mt.h"
+#include "gillstream-config.h"
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#define CFR_USE_MMAP
+#endif
 
 // Concrete formats. remember to adjust CFR_NUM_FORMATS if changed!
 // Note: 0, 1 are special entries.
@@ -48,6 +57,10 @@ const char * cfr_extensions[CFR_NUM_FORMATS] =
 // Prototypes of non API functions (don't use these from outside this file)
 const char * _cfr_compressor_strerror(int format, int err);
 const char * _bz2_strerror(int err);
+int          _cfr_format(const char *path);
+int          _cfr_mmap(CFRFILE *stream, const char *path);
+size_t       _cfr_read_raw(CFRFILE *stream, void *ptr, size_t bytes);
+size_t       _cfr_fill(CFRFILE *stream, size_t bytes);
 
 
 // API Functions 
@@ -61,13 +74,9 @@ CFRFILE *cfr_open(const char *path)
     ** Opens a possibly compressed file for reading.
     ** File type is determined by file name ending */
 
-	int format, ext_len, name_len;
+	int format = 2;  // skip specials 0, 1 
 	CFRFILE * retval = NULL;
 
-	// determine file format
-	name_len = strlen(path);
-	format = 2;  // skip specials 0, 1 
-
 	// Do action dependent on file format
 	retval = (CFRFILE *) calloc(1,sizeof(CFRFILE));
 	if(retval == NULL)
@@ -106,21 +115,7 @@ CFRFILE *cfr_open(const char *path)
 		return (retval);
 	}
 
-	while (format < CFR_NUM_FORMATS) 
-	{
-    	ext_len = strlen(cfr_extensions[format]);
-    	if (strncmp(cfr_extensions[format], path+(name_len-ext_len), ext_len) == 0) 
-		{
-			break;
-		}
-    	format ++;
-  	}
-
-	if (format >= CFR_NUM_FORMATS) 
-	{
-		format = 1;  // uncompressed 
-	}
-
+	format = _cfr_format(path);
 	retval->format = format;
 
 	switch (format) 
@@ -128,6 +123,13 @@ CFRFILE *cfr_open(const char *path)
 		case 1:  // uncompressed
 		{
 			FILE * in;
+
+			// zero-copy reading if the file can be mapped
+			if (_cfr_mmap(retval, path)) 
+			{
+				return(retval);
+			}
+
 			in = fopen(path,"r");
 
 			if (in == NULL) 
@@ -200,6 +202,96 @@ CFRFILE *cfr_open(const char *path)
 
 
 
+CFRFILE *cfr_fdopen(int fd, const char *name) 
+{
+	/******************************************************************/
+	// Analog to 'fdopen'. Reads a possibly compressed file from a file
+	// descriptor, e.g., the read end of a pipe fed by a download, so
+	// that the data is decompressed while it is being received.
+	// The format is determined by the ending of 'name' (uncompressed
+	// if NULL). The descriptor belongs to the stream from then on: it
+	// is closed by cfr_close, or before returning NULL.
+
+	int format;
+	CFRFILE * retval = NULL;
+
+	if (fd < 0) 
+	{
+		errno = EBADF;
+		return (NULL);
+	}
+
+	retval = (CFRFILE *) calloc(1,sizeof(CFRFILE));
+	if(retval == NULL)
+	{
+		close(fd);
+		return (NULL);
+	}
+
+	format = (name == NULL) ? 1 : _cfr_format(name);
+	retval->format = format;
+
+	switch (format) 
+	{
+		case 1:  // uncompressed
+		case 2:  // bzip2
+		{
+			int bzerror;
+			BZFILE * bzin;
+			FILE * in;
+
+			in = fdopen(fd, "r");
+			if (in == NULL) 
+			{ 
+				close(fd);
+				free(retval);
+				return(NULL);
+			}
+
+			retval->data1 = in;
+			if (format == 1) 
+			{
+				return(retval);
+			}
+
+			bzin = BZ2_bzReadOpen( &bzerror, in, 0, 0, NULL, 0); 
+			if (bzerror != BZ_OK) 
+			{
+				BZ2_bzReadClose( &bzerror, bzin);
+				fclose(in);
+				free(retval);
+				return(NULL);
+			}
+
+			retval->data2 = bzin;
+			return(retval);
+		}
+		break;
+
+		case 3:  // gzip
+		{
+			gzFile f;
+
+			f = gzdopen(fd, "r");
+			if(f == NULL) 
+			{
+				close(fd);
+				free(retval);
+				return (NULL);
+			}
+
+			retval->data2 = f;
+			return (retval);
+		}
+		break;
+
+		default:  // this is an internal error, no diag yet.
+			fprintf(stderr,"illegal format '%d' in cfr_fdopen!\n", format);
+			exit(1);
+	}
+	return NULL;
+}
+
 int cfr_close(CFRFILE *stream) 
 {
 	/**************************/
@@ -217,14 +309,32 @@ int cfr_close(CFRFILE *stream)
 	{
 		case 1:  // uncompressed
 		{
-			retval = fclose((FILE *)(stream->data1));
+			if (stream->mapped) 
+			{
+#ifdef CFR_USE_MMAP
+				retval = munmap(stream->buf, stream->buf_size);
+#endif
+				stream->buf = NULL;
+			}
+			else 
+			{
+				retval = fclose((FILE *)(stream->data1));
+			}
 			stream->error1 = retval;
 		}
 		break;
 
 		case 2: // bzip2
 		{
-			BZ2_bzReadClose( &stream->error2, (BZFILE *)stream->data2);
+			if (stream->bz2_mt != NULL) 
+			{
+				cfr_bz2mt_close((CFR_BZ2MT *)stream->bz2_mt);
+				stream->bz2_mt = NULL;
+			}
+			else 
+			{
+				BZ2_bzReadClose( &stream->error2, (BZFILE *)stream->data2);
+			}
 			stream->error1 = retval = fclose((FILE *)(stream->data1));
 		}
 		break;
@@ -241,6 +351,7 @@ int cfr_close(CFRFILE *stream)
 			assert("illegal stream->format" && 0);
 	}
 
+	free(stream->buf);
 	free(stream);
 	return(retval);
 }
@@ -258,8 +369,11 @@ size_t cfr_read(void *ptr, size_t size, size_t nmemb, CFRFILE *stream)
 	// Analog to 'fread'. Will not return with partial elements, only
 	// full ones. Hence calling this function with one large element
 	// size will result in a complete or no read.
+	// Data is served from the internal buffer. Reads larger than the
+	// buffer copy what is buffered, and read the rest directly.
 	
-	size_t retval = 0;
+	size_t total, avail, done;
+
 	if (stream == NULL) 
 	{
 		return(0);
@@ -271,228 +385,419 @@ size_t cfr_read(void *ptr, size_t size, size_t nmemb, CFRFILE *stream)
 		return(0);
 	}
 
-	switch (stream->format) 
+	total = size * nmemb;
+
+	if (total <= CFR_BUFFER_SIZE) 
 	{
-		case 1:  // uncompressed
+		avail = _cfr_fill(stream, total);
+
+		if (avail < total) 
 		{
-			FILE * in;
-			in = (FILE *)(stream->data1);
-			retval = fread(ptr, size, nmemb, in);
+			// read past end, set eof
+			cfr_consume(stream, avail);
+			stream->eof = stream->raw_eof;
+			return(0);
+		}
 
-			if (retval != nmemb) 
-			{
-				// fprintf(stderr,"short read!!!\n");
-				stream->eof = feof(in);
-				stream->error1 = ferror(in);
-				retval = 0;
-			}
+		memcpy(ptr, stream->buf + stream->buf_pos, total);
+		cfr_consume(stream, total);
+		return(nmemb);
+	}
 
-			return (retval);
+	// large read: first the buffered bytes, then the remaining ones
+	done = stream->buf_len - stream->buf_pos;
+	if (done > total) 
+	{
+		done = total;
+	}
+
+	if (done > 0) 
+	{
+		memcpy(ptr, stream->buf + stream->buf_pos, done);
+		cfr_consume(stream, done);
+	}
+
+	while (done < total && !stream->raw_eof) 
+	{
+		avail = _cfr_read_raw(stream, (char *)ptr + done, total - done);
+		stream->buf_offset += avail;
+		done += avail;
+	}
+
+	if (done < total) 
+	{
+		stream->eof = 1;
+		return(0);
+	}
+
+	return(nmemb);
+} 
+
+
+size_t cfr_peek(CFRFILE *stream, void **ptr, size_t bytes) 
+{
+	/******************************************************************/
+	// Makes the next 'bytes' bytes of the stream available in place,
+	// without consuming them. '*ptr' is set to the first of them, and
+	// stays valid until the next read/peek on the stream.
+	// Returns the number of bytes available at '*ptr', which is lower
+	// than 'bytes' at the end of the data, or if 'bytes' is larger than
+	// CFR_BUFFER_SIZE.
+
+	size_t avail;
+
+	if (stream == NULL || stream->eof) 
+	{
+		return(0);
+	}
+
+	avail = _cfr_fill(stream, bytes);
+	*ptr = stream->buf + stream->buf_pos;
+
+	if (avail < bytes) 
+	{
+		// feof-behaviour: only set eof when reading past the end
+		if (stream->raw_eof) 
+		{
+			stream->eof = 1;
 		}
-		break;
 
-		case 2:  // bzip2
+		return(avail);
+	}
+
+	return(bytes);
+}
+
+
+void cfr_consume(CFRFILE *stream, size_t bytes) 
+{
+	/******************************************************************/
+	// Marks the next 'bytes' bytes of the buffer as read. Must not
+	// exceed what the last cfr_peek returned.
+
+	assert(bytes <= stream->buf_len - stream->buf_pos);
+	stream->buf_pos += bytes;
+}
+
+
+size_t cfr_skip(CFRFILE *stream, size_t bytes) 
+{
+	/******************************************************************/
+	// Skips the next 'bytes' bytes of the stream, without copying
+	// them anywhere (they still have to be decompressed).
+	// Returns the number of bytes skipped, which is lower than 'bytes'
+	// at the end of the data.
+
+	size_t done = 0;
+	size_t avail;
+	void *ptr;
+
+	while (done < bytes) 
+	{
+		avail = cfr_peek(stream, &ptr, (bytes - done < CFR_BUFFER_SIZE) ? bytes - done : CFR_BUFFER_SIZE);
+
+		if (avail == 0) 
 		{
-			BZFILE * bzin; 
-			int bzerror;
-			int buffsize;
+			break;
+		}
 
-			if (stream->bz2_stream_end == 1) 
+		cfr_consume(stream, avail);
+		done += avail;
+	}
+
+	return(done);
+}
+
+
+
+uint64_t cfr_tell(CFRFILE *stream) 
+{
+	/******************************************************************/
+	// Returns the offset of the next byte to read in the
+	// (decompressed) data.
+
+	return(stream->buf_offset + stream->buf_pos);
+}
+
+
+int cfr_block_at(CFRFILE *stream, uint64_t offset, uint64_t *block, uint64_t *block_offset) 
+{
+	/******************************************************************/
+	// Gives the location from which cfr_seek can restart reading to
+	// reach 'offset' (in the decompressed data, already read):
+	// '*block' is the offset of the compressed data to read from (in
+	// bits for bzip2, in bytes otherwise), and '*block_offset' the
+	// offset of its decompressed data. bzip2 files must be read with
+	// the thread pool (cfr_set_threads), the location of the blocks
+	// being unknown otherwise. gzip files can only be read from their
+	// beginning.
+	// Returns 1 if the location is known, 0 otherwise.
+
+	bz2_block_t bz2_block;
+
+	switch (stream->format) 
+	{
+		case 1:  // uncompressed
+			*block = offset;
+			*block_offset = offset;
+			return(1);
+
+		case 2:  // bzip2
+			if (stream->bz2_mt == NULL ||
+			    !cfr_bz2mt_block_at((CFR_BZ2MT *)stream->bz2_mt, offset, &bz2_block)) 
 			{
-				// feof-behaviour: Last read did consume last byte but not more
-				stream->eof = 1;
 				return(0);
 			}
+			*block = bz2_block.start;
+			*block_offset = bz2_block.out;
+			return(1);
 
-			bzerror = BZ_OK;
-			bzin = (BZFILE *) (stream->data2);
-			buffsize = size * nmemb;
+		case 3:  // gzip
+			*block = 0;
+			*block_offset = 0;
+			return(1);
+
+		default:
+			return(0);
+	}
+}
+
+
+int cfr_seek(CFRFILE *stream, uint64_t block, uint64_t block_offset, uint64_t offset) 
+{
+	/******************************************************************/
+	// Moves the reading forward to 'offset' (in the decompressed
+	// data), from a location given by cfr_block_at. bzip2 files are
+	// then read with the thread pool (with a single thread if
+	// cfr_set_threads was not called).
+	// Returns 1 on success, 0 otherwise (the position is then
+	// undefined).
+
+	uint64_t pos;
+
+	if (stream == NULL || stream->closed || block_offset > offset) 
+	{
+		return(0);
+	}
 
-			retval = BZ2_bzRead(&bzerror, bzin, ptr, buffsize);
+	pos = cfr_tell(stream);
 
-			if (bzerror == BZ_STREAM_END ) 
+	if (offset < pos) 
+	{
+		return(0);
+	}
+
+	// target already in the buffer, or close enough to just skip
+	if (offset - pos <= stream->buf_len - stream->buf_pos || block_offset <= pos) 
+	{
+		return(cfr_skip(stream, offset - pos) == offset - pos);
+	}
+
+	switch (stream->format) 
+	{
+		case 1:  // uncompressed
+		{
+			if (stream->mapped) 
 			{
-				stream->bz2_stream_end = 1;
-				stream->error2 = bzerror;
-				if (retval == buffsize) 
+				if (offset > stream->buf_len) 
 				{
-					// feof-behaviour: no eof yet
-				} 
-				else 
-				{
-					// feof-behaviour: read past end, set eof
-					stream->eof = 1;
-					retval = 0;
+					return(0);
 				}
-				return(retval/size);
+				stream->buf_pos = offset;
+				stream->eof = 0;
+				return(1);
 			}
-			if (bzerror == BZ_OK) 
+
+			if (fseeko((FILE *)stream->data1, offset, SEEK_SET) != 0) 
 			{
-				// Normal case, no error.
-				// A short read here is an error, so catch it
-				if (retval == buffsize) 
-				{
-					return(retval/size);
-				}
+				return(0);
 			}
+			stream->buf_offset = offset;
+			stream->buf_pos = 0;
+			stream->buf_len = 0;
+			return(1);
+		}
 
-			// Other error...
-			stream->error2 = bzerror;
-			BZ2_bzReadClose( &bzerror, bzin );
+		case 2:  // bzip2
+		{
+			CFR_BZ2MT * mt;
+			int bzerror;
 
-			if (bzerror != BZ_OK) 
+			if (stream->bz2_mt != NULL) 
 			{
-				stream->error2 = bzerror;
+				cfr_bz2mt_close((CFR_BZ2MT *)stream->bz2_mt);
+				stream->bz2_mt = NULL;
+			}
+			else 
+			{
+				BZ2_bzReadClose(&bzerror, (BZFILE *)stream->data2);
+				stream->data2 = NULL;
 			}
 
-			retval = fclose((FILE *)(stream->data1));
-			stream->error1 = retval;
-			stream->closed = 1;
-			return(0);
-		}
-		break;
+			rewind(stream->data1);
+			mt = cfr_bz2mt_open_at(stream->data1, (stream->threads > 0) ? stream->threads : 1, block, block_offset);
+			if (mt == NULL) 
+			{
+				stream->raw_eof = 1;
+				return(0);
+			}
 
-		case 3:  // gzip
-		{
-			gzFile in;
-			in = (gzFile)(stream->data2);
-			retval = gzread(in, ptr, size*nmemb);
-			if (retval != nmemb*size) 
+			stream->bz2_mt = mt;
+			if (stream->threads < 1) 
 			{
-				// fprintf(stderr,"short read!!!\n");
-				stream->eof = gzeof(in);
-				stream->error2 = errno;
-				retval = 0;
+				stream->threads = 1;
 			}
+			stream->bz2_stream_end = 0;
+			stream->raw_eof = 0;
+			stream->buf_offset = block_offset;
+			stream->buf_pos = 0;
+			stream->buf_len = 0;
 
-			return (retval/size);
+			return(cfr_skip(stream, offset - block_offset) == offset - block_offset);
 		}
-		break;
 
-		default:  // this is an internal error, no diag yet.
-			fprintf(stderr,"illegal format '%d' in cfr_read!\n",stream->format);
-			exit(1);
+		default:
+			return(cfr_skip(stream, offset - pos) == offset - pos);
 	}
-} 
-
-
+}
 
 
 
 ssize_t cfr_getline(char **lineptr, size_t *n, CFRFILE *stream) 
 {
 	/************************************************************/
-	// May not be very efficient, since it uses single-char reads
-	// for formats where there is no native getline in the library.
-	// For bzip2 the speedup for additional buffering was only 5%
-	// so I dropped it.
+	// Single-char reads are served from the internal buffer, so
+	// this is efficient for all formats.
 	// Returns -1 in case of an error.
 	char *tmp;
+	size_t count;
+	char c;
+	size_t ret;
 
 	if (stream == NULL) 
 	{
 		return(-1);  
 	}
 
-	switch (stream->format) 
+	// allocate initial buffer if none was passed or size was zero
+	if (*lineptr == NULL) 
 	{
-		case 1:  // uncompressed
+		*lineptr = (char *) calloc(120, 1);
+		if(*lineptr == NULL) 
+		{
+			stream->error1 = errno;
+			return(-1);
+		}
+		*n = 120;
+	}
+	
+	if (*n == 0) 
+	{
+		*n = 120;
+		tmp = (char *) realloc(*lineptr, *n); // to avoid memory-leaks
+		if(tmp == NULL) 
+		{
+			stream->error1 = errno;
+			return(-1);
+		}
+		*lineptr = tmp;
+	}
+
+	count = 0;
+	// read until '\n'
+	do 
+	{
+		ret = cfr_read(&c, 1, 1, stream);
+		if (ret != 1) 
+		{
+			return(-1);
+		}
+
+		count ++;
+		if (count >= *n) 
 		{
-			if (fgets(*lineptr, *n, (FILE *)(stream->data1)) == NULL) 
+			*n = 2 * *n;
+			tmp = (char *) realloc(*lineptr, *n);
+			if (tmp == NULL) 
 			{
 				stream->error1 = errno;
-				return -1;
+				return(-1);
 			}
-
-			return 0;
+			*lineptr = tmp;
 		}
-		break;
+		(*lineptr)[count-1] = c;
+	} 
+	while (c != '\n');
+	(*lineptr)[count] = 0;
 
-		case 2:  // bzip2       
-		{    
-			size_t count;
-			char c;
-			size_t ret;
+	return(count);
+}
 
-			//bzin = (BZFILE *) (stream->data2);
 
-			// allocate initial buffer if none was passed or size was zero
-			if (*lineptr == NULL) 
-			{
-				*lineptr = (char *) calloc(120, 1);
-				if(*lineptr == NULL) 
-				{
-					stream->error1 = errno;
-					return(-1);
-				}
-				*n = 120;
-			}
-			
-			if (*n == 0) 
-			{
-				*n = 120;
-				tmp = (char *) realloc(*lineptr, *n); // to avoid memory-leaks
-				if(tmp == NULL) 
-				{
-					stream->error1 = errno;
-					return(-1);
-				}
-				*lineptr = tmp;
-			}
 
-			count = 0;
-			// read until '\n'
-			do 
-			{
-				ret = cfr_read(&c, 1, 1, stream);
-				if (ret != 1) 
-				{
-					return(-1);
-				}
+int cfr_set_threads(CFRFILE *stream, int threads)
+{
+	/******************************************************************/
+	// Decompresses a bzip2 file with a pool of 'threads' threads, one
+	// bzip2 block per thread. Must be called before the first read.
+	// Returns 1 if the thread pool is used, 0 otherwise (other formats,
+	// threads < 1, data already read, not a regular file, or the pool
+	// cannot be started), the file is then read by the calling thread
+	// as usual.
+
+	int bzerror;
+	struct stat st;
+	CFR_BZ2MT * mt;
+
+	if (stream == NULL || stream->closed || stream->format != 2 || threads < 1)
+	{
+		return(0);
+	}
 
-				count ++;
-				if (count >= *n) 
-				{
-					*n = 2 * *n;
-					tmp = (char *) realloc(*lineptr, *n);
-					if (tmp == NULL) 
-					{
-						stream->error1 = errno;
-						return(-1);
-					}
-					*lineptr = tmp;
-				}
-				(*lineptr)[count-1] = c;
-			} 
-			while (c != '\n');
-			(*lineptr)[count] = 0;
+	if (stream->bz2_mt != NULL)
+	{
+		return(1);
+	}
 
-			return(count);
-		}
-		break;
+	if (stream->buf_len != 0 || stream->raw_eof)
+	{
+		return(0);
+	}
 
-		case 3:  // gzip
-		{
-			char * return_ptr = gzgets((gzFile)(stream->data2), *lineptr, *n );
-			if (return_ptr == Z_NULL) 
-			{
-				stream->error2 = errno;
-				return(-1);
-			}
-			return *n;
-		}
-		break;
-		
-		default:  // this is an internal error, no diag yet.
-			fprintf(stderr,"illegal format '%d' in cfr_getline!\n",stream->format);
-			exit(1);
-			return(-1);
-	}     
+	// the pool needs the whole compressed file: a stream (pipe, socket)
+	// keeps being decompressed as it arrives
+	if (fstat(fileno(stream->data1), &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		return(0);
+	}
+
+	// nothing has been read from the file by libbz2 yet
+	BZ2_bzReadClose(&bzerror, (BZFILE *)stream->data2);
+	stream->data2 = NULL;
+
+	mt = cfr_bz2mt_open(stream->data1, threads);
+	if (mt != NULL)
+	{
+		stream->bz2_mt = mt;
+		stream->threads = threads;
+		return(1);
+	}
+
+	// fall back to the single-threaded decoder
+	rewind(stream->data1);
+	stream->data2 = BZ2_bzReadOpen(&bzerror, stream->data1, 0, 0, NULL, 0);
+	if (bzerror != BZ_OK)
+	{
+		stream->error2 = bzerror;
+		stream->raw_eof = 1;
+	}
+
+	return(0);
 }
 
 
 
-int cfr_eof(CFRFILE *stream) 
+int cfr_eof(CFRFILE *stream)
 {
 	// Returns true on end of file/end of compressed data.
 	// The end of the compressed data is regarded as end of file
@@ -600,6 +905,257 @@ const char * cfr_compressor_str(CFRFILE *stream)
 }
 
 
+// Buffer management. 
+// * Not part of the API, do not call directly as they may change! *
+
+int _cfr_format(const char *path) 
+{
+	// Determines the format of a file by its name ending.
+	// Returns the uncompressed format if no known ending is found.
+
+	int format, ext_len, name_len;
+
+	name_len = strlen(path);
+	format = 2;  // skip specials 0, 1 
+
+	while (format < CFR_NUM_FORMATS) 
+	{
+		ext_len = strlen(cfr_extensions[format]);
+		if (name_len >= ext_len && strncmp(cfr_extensions[format], path+(name_len-ext_len), ext_len) == 0) 
+		{
+			return(format);
+		}
+		format ++;
+	}
+
+	return(1);  // uncompressed 
+}
+
+int _cfr_mmap(CFRFILE *stream, const char *path) 
+{
+	// Maps a whole uncompressed file in memory, and uses the mapping
+	// as the read buffer. Only done for non-empty regular files.
+	// Returns 1 on success, 0 if the file must be read with stdio.
+
+#ifdef CFR_USE_MMAP
+	struct stat st;
+	void * map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) 
+	{
+		return(0);
+	}
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+	    (unsigned long long)st.st_size > (size_t)-1) 
+	{
+		close(fd);
+		return(0);
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) 
+	{
+		return(0);
+	}
+
+#ifdef HAVE_MADVISE
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+#if defined(CFR_MMAP_HUGEPAGES) && defined(MADV_HUGEPAGE)
+	madvise(map, st.st_size, MADV_HUGEPAGE);
+#endif
+#endif
+
+	stream->buf = map;
+	stream->buf_size = st.st_size;
+	stream->buf_len = st.st_size;
+	stream->buf_pos = 0;
+	stream->raw_eof = 1;
+	stream->mapped = 1;
+	return(1);
+#else
+	(void)stream;
+	(void)path;
+	return(0);
+#endif
+}
+
+
+size_t _cfr_read_raw(CFRFILE *stream, void *ptr, size_t bytes) 
+{
+	// Reads up to 'bytes' bytes from the file or the decompressor.
+	// A short read means that the end of the data has been reached,
+	// or that an error occured. raw_eof is set in both cases.
+
+	size_t retval = 0;
+
+	if (stream->raw_eof || stream->closed) 
+	{
+		return(0);
+	}
+
+	switch (stream->format) 
+	{
+		case 1:  // uncompressed
+		{
+			FILE * in;
+			in = (FILE *)(stream->data1);
+			retval = fread(ptr, 1, bytes, in);
+
+			if (retval != bytes) 
+			{
+				stream->raw_eof = 1;
+				stream->error1 = ferror(in);
+			}
+
+			return (retval);
+		}
+		break;
+
+		case 2:  // bzip2
+		{
+			BZFILE * bzin; 
+			int bzerror;
+
+			if (stream->bz2_stream_end == 1) 
+			{
+				stream->raw_eof = 1;
+				return(0);
+			}
+
+			// blocks decompressed by the thread pool
+			if (stream->bz2_mt != NULL) 
+			{
+				retval = cfr_bz2mt_read((CFR_BZ2MT *)stream->bz2_mt, ptr, bytes, &bzerror);
+				if (retval != bytes) 
+				{
+					stream->bz2_stream_end = 1;
+					stream->raw_eof = 1;
+					stream->error2 = (bzerror == BZ_OK) ? BZ_STREAM_END : bzerror;
+				}
+				return(retval);
+			}
+
+			bzerror = BZ_OK;
+			bzin = (BZFILE *) (stream->data2);
+
+			retval = BZ2_bzRead(&bzerror, bzin, ptr, bytes);
+
+			if (bzerror == BZ_STREAM_END) 
+			{
+				stream->bz2_stream_end = 1;
+				stream->error2 = bzerror;
+				if (retval != bytes) 
+				{
+					stream->raw_eof = 1;
+				}
+				return(retval);
+			}
+			if (bzerror == BZ_OK) 
+			{
+				// Normal case, no error.
+				return(retval);
+			}
+
+			// Other error...
+			stream->error2 = bzerror;
+			BZ2_bzReadClose( &bzerror, bzin );
+
+			if (bzerror != BZ_OK) 
+			{
+				stream->error2 = bzerror;
+			}
+
+			stream->error1 = fclose((FILE *)(stream->data1));
+			stream->closed = 1;
+			stream->raw_eof = 1;
+			return(0);
+		}
+		break;
+
+		case 3:  // gzip
+		{
+			int ret;
+			gzFile in;
+			in = (gzFile)(stream->data2);
+			ret = gzread(in, ptr, bytes);
+
+			if (ret < 0) 
+			{
+				stream->error2 = errno;
+				stream->raw_eof = 1;
+				return(0);
+			}
+
+			if (ret != bytes) 
+			{
+				stream->raw_eof = 1;
+			}
+
+			return (ret);
+		}
+		break;
+
+		default:  // this is an internal error, no diag yet.
+			fprintf(stderr,"illegal format '%d' in cfr_read!\n",stream->format);
+			exit(1);
+	}
+}
+
+size_t _cfr_fill(CFRFILE *stream, size_t bytes) 
+{
+	// Makes sure that at least 'bytes' bytes (at most CFR_BUFFER_SIZE)
+	// are in the buffer, unless the end of the data is reached.
+	// The buffer is refilled by blocks as large as possible.
+	// Returns the number of bytes available in the buffer.
+
+	size_t avail;
+
+	// everything is already in the mapping
+	if (stream->mapped) 
+	{
+		return(stream->buf_len - stream->buf_pos);
+	}
+
+	if (stream->buf == NULL) 
+	{
+		stream->buf = malloc(CFR_BUFFER_SIZE);
+		if (stream->buf == NULL) 
+		{
+			stream->error1 = ENOMEM;
+			return(0);
+		}
+		stream->buf_size = CFR_BUFFER_SIZE;
+	}
+
+	avail = stream->buf_len - stream->buf_pos;
+	if (avail >= bytes) 
+	{
+		return(avail);
+	}
+
+	// move the remaining bytes at the beginning of the buffer
+	if (stream->buf_pos > 0) 
+	{
+		stream->buf_offset += stream->buf_pos;
+		memmove(stream->buf, stream->buf + stream->buf_pos, avail);
+		stream->buf_pos = 0;
+		stream->buf_len = avail;
+	}
+
+	while (stream->buf_len < bytes && stream->buf_len < stream->buf_size && !stream->raw_eof) 
+	{
+		stream->buf_len += _cfr_read_raw(stream, stream->buf + stream->buf_len, stream->buf_size - stream->buf_len);
+	}
+
+	return(stream->buf_len - stream->buf_pos);
+}
+
+
 // Utility functions for compressor errors. 
 // * Not part of the API, do not call directly as they may change! *
 
@@ -17,6 +17,18 @@
   Function prefixes are: 
      cfr_ = compressed file read   
 
+  Reading is buffered: data is read (and decompressed) by blocks of
+  CFR_BUFFER_SIZE bytes, and can be accessed in place with cfr_peek
+  and cfr_consume. Uncompressed regular files are memory-mapped when
+  possible, cfr_peek then points straight into the mapping.
+  bzip2 files can be decompressed by a pool of threads (cfr_set_threads),
+  one bzip2 block per thread, see cfr_bz2mt.h.
+  Reading can start further in the file with cfr_seek, from a location
+  given by cfr_block_at while the file was read before: uncompressed
+  files are seeked directly, bzip2 files from the block holding the
+  location (the previous blocks are not decompressed), gzip files by
+  decompressing and skipping the previous data.
+
   Supported:
   Reading: 
   - type recognition from file name extension 
@@ -29,10 +41,13 @@
 #ifndef _CFILE_TOOLS_DEFINES
 #define _CFILE_TOOLS_DEFINES
 
+#ifndef _GNU_SOURCE
 #define _GNU_SOURCE
+#endif
 #define _FILE_OFFSET_BITS 64
 
 #include <stdio.h>
+#include <stdint.h>
 #include <unistd.h>
 
 #include <bzlib.h>
@@ -52,6 +67,19 @@ struct _CFRFILE {
   // compressor specific stuff 
   int bz2_stream_end; // True when a bz2 stream has ended. Needed since
                       // further reading returns error and not eof.
+  void * bz2_mt;      // multi-threaded bzip2 decoder (see cfr_set_threads),
+                      // replaces data2 when set
+  // read buffer, filled by large blocks of (decompressed) data
+  unsigned char * buf; // buffer holding the data not consumed yet
+  size_t buf_size;     // size of the buffer (CFR_BUFFER_SIZE once allocated)
+  size_t buf_pos;      // position of the first byte not consumed yet
+  size_t buf_len;      // number of valid bytes in the buffer
+  int raw_eof;         // True when the underlying file/compressor is exhausted
+  int mapped;          // True when buf is a memory mapping of the whole
+                       // (uncompressed) file instead of a read buffer
+  uint64_t buf_offset; // offset of buf[0] in the (decompressed) data
+  int threads;         // number of bzip2 decompression threads, 0 if the
+                       // file is decompressed by the calling thread
 };
 
 typedef struct _CFRFILE CFRFILE;
@@ -60,13 +88,25 @@ typedef struct _CFRFILE CFRFILE;
 
 	#define CFR_NUM_FORMATS 4
 
+// Size of the internal read buffer
+
+	#define CFR_BUFFER_SIZE (1024 * 1024)
+
 // Functions
 
 CFRFILE    * cfr_open(const char *path); 
+CFRFILE    * cfr_fdopen(int fd, const char *name); 
 int          cfr_close(CFRFILE *stream);
 size_t       cfr_read(void *ptr, size_t size, size_t nmemb, CFRFILE *stream);
 size_t       cfr_read_n(CFRFILE *stream, void *ptr, size_t bytes);
+size_t       cfr_peek(CFRFILE *stream, void **ptr, size_t bytes);
+void         cfr_consume(CFRFILE *stream, size_t bytes);
+size_t       cfr_skip(CFRFILE *stream, size_t bytes);
+uint64_t     cfr_tell(CFRFILE *stream);
+int          cfr_block_at(CFRFILE *stream, uint64_t offset, uint64_t *block, uint64_t *block_offset);
+int          cfr_seek(CFRFILE *stream, uint64_t block, uint64_t block_offset, uint64_t offset);
 ssize_t      cfr_getline(char **lineptr, size_t *n, CFRFILE *stream);
+int          cfr_set_threads(CFRFILE *stream, int threads);
 int          cfr_eof(CFRFILE *stream);
 int          cfr_error(CFRFILE *stream);
 char       * cfr_strerror(CFRFILE *stream);
@@ -6,6 +6,12 @@
 
 #include "file_buffer.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 
 void print_raw_bgp_message(u_char* buffer, int len, uint16_t type, uint16_t subType)
 {   
@@ -64,12 +70,12 @@ void get_buf_n(u_char* buf, char* dest, int n)
 
 
 
-int process_prefix(u_char* buffer, char* string, int afi)
+int process_prefix(u_char* buffer, Prefix_t* pfx, int afi)
 {
     /* Get te prefix length */
     int pfxLen = get_buf_char(buffer);
     
-    if (pfxLen > 128)
+    if (pfxLen > (afi == BGP_IPV6_AFI ? 128 : 32))
     {
         return -1;
     }
@@ -77,38 +83,120 @@ int process_prefix(u_char* buffer, char* string, int afi)
     int nbBytesPfx = (pfxLen+7)/8;
 
     /* Get the prefix */
-    u_char peer_ip[16];
-    u_char tmp_str[52];
+    memset(pfx->pfx, 0, 16);
+    get_buf_n(buffer+1, (char*)pfx->pfx, nbBytesPfx);
+
+    pfx->afi    = afi;
+    pfx->pfxLen = pfxLen;
+
+    return 1+nbBytesPfx;
+}
 
-    memset(peer_ip, 0, 16);
-    get_buf_n(buffer+1, (char*)peer_ip, nbBytesPfx);
 
-    memset(tmp_str, 0, 52);
+/* Masks keeping the first n bytes of a 16-byte vector, loaded from prefixMask + 16 - n */
+static const u_int8_t prefixMask[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
 
-    if (inet_ntop(afi, peer_ip, (char*)tmp_str, 52) == NULL) 
+
+/* Copies the nbBytes significant bytes of a prefix and zeroes the other ones. At least 16 bytes
+ * must be readable from src */
+static inline void copy_prefix_bytes(u_int8_t* dst, const u_char* src, int nbBytes)
+{
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128((const __m128i*)src);
+    __m128i mask  = _mm_loadu_si128((const __m128i*)(prefixMask + 16 - nbBytes));
+
+    _mm_storeu_si128((__m128i*)dst, _mm_and_si128(bytes, mask));
+#elif defined(__ARM_NEON)
+    vst1q_u8(dst, vandq_u8(vld1q_u8(src), vld1q_u8(prefixMask + 16 - nbBytes)));
+#else
+    for (int i = 0 ; i < 16 ; i++)
     {
-        return -1;
+        dst[i] = src[i] & prefixMask[16 - nbBytes + i];
     }
+#endif
+}
 
-    /* Write the prefix in string format */
-    snprintf(string, 64, "%s/%d", tmp_str, pfxLen);
 
-    return 1+nbBytesPfx;
+int process_prefix_list(u_char* buffer, int len, int afi, MRTentry* entry, int withdraw)
+{
+    Prefix_t** list     = withdraw ? &entry->pfxWithdraw : &entry->pfxNLRI;
+    u_int16_t* size     = withdraw ? &entry->sizeWithdraw : &entry->sizeNLRI;
+    u_int16_t* nb       = withdraw ? &entry->nbWithdraw : &entry->nbNLRI;
+    int maxLen          = afi == BGP_IPV6_AFI ? 128 : 32;
+    u_int32_t nbPrefixes = *nb;
+    Prefix_t* pfx;
+
+    for (int off = 0 ; off < len ; )
+    {
+        int pfxLen = buffer[off];
+        int nbBytesPfx = (pfxLen + 7) / 8;
+
+        if (pfxLen > maxLen || off + 1 + nbBytesPfx > len)
+        {
+            return -1;
+        }
+
+        if (nbPrefixes == *size &&
+            !MRTentry_reserve_list(entry, (void**)list, size, nbPrefixes + 1, sizeof(Prefix_t)))
+        {
+            return -1;
+        }
+
+        pfx = *list + nbPrefixes++;
+        pfx->afi    = afi;
+        pfx->pfxLen = pfxLen;
+
+        /* The vector copy reads 16 bytes after the prefix length, the last prefixes of the list
+         * are copied byte per byte so as not to read past its end */
+        if (off + 17 <= len)
+        {
+            copy_prefix_bytes(pfx->pfx, buffer + off + 1, nbBytesPfx);
+        }
+        else
+        {
+            memset(pfx->pfx, 0, 16);
+            memcpy(pfx->pfx, buffer + off + 1, nbBytesPfx);
+        }
+
+        off += 1 + nbBytesPfx;
+    }
+
+    nbPrefixes -= *nb;
+    *nb += nbPrefixes;
+
+    return nbPrefixes;
 }
 
 
-File_buf_t* File_buf_create(const char *filename)
+/* Allocates the structures of a file buffer reading from an opened file, closed if it fails */
+static File_buf_t* file_buf_init(CFRFILE* f, const char *filename)
 {
     File_buf_t* dumper = calloc(1, sizeof(File_buf_t));
-    dumper->f = cfr_open(filename);
 
-    if (!dumper->f)
+    if (dumper)
     {
-        printf("Unable to open file %s\n", filename);
-        free(dumper);
+        dumper->arena = Arena_new();
+        dumper->attrCache = MRTattrCache_new();
+    }
+
+    if (!dumper || !dumper->arena || !dumper->attrCache)
+    {
+        printf("Unable to allocate any memory\n");
+        if (dumper)
+        {
+            Arena_free(dumper->arena);
+            MRTattrCache_free(dumper->attrCache);
+            free(dumper);
+        }
+        cfr_close(f);
         return NULL;
     }
 
+    dumper->f = f;
+    strncpy(dumper->filename, filename, BGPDUMP_MAX_FILE_LEN - 1);
     dumper->eof=0;
     dumper->parsed = 0;
     dumper->parsed_ok = 0;
@@ -117,16 +205,54 @@ File_buf_t* File_buf_create(const char *filename)
 }
 
 
+File_buf_t* File_buf_create(const char *filename)
+{
+    CFRFILE* f = cfr_open(filename);
+
+    if (!f)
+    {
+        printf("Unable to open file %s\n", filename);
+        return NULL;
+    }
+
+    return file_buf_init(f, filename);
+}
+
+
+File_buf_t* File_buf_create_fd(int fd, const char *name)
+{
+    CFRFILE* f = cfr_fdopen(fd, name);
+    File_buf_t* dumper;
+
+    if (!f)
+    {
+        printf("Unable to open stream %s\n", name ? name : "-");
+        return NULL;
+    }
+
+    if ((dumper = file_buf_init(f, name ? name : "-")) != NULL)
+    {
+        dumper->streamed = 1;
+    }
+
+    return dumper;
+}
+
+
 void File_buf_close_dump(File_buf_t *dump)
 {
     if(dump == NULL) {
         return;
     }
 
-    if (dump->actEntry)
-    {
-        MRTentry_free(dump->actEntry);
-    }
+    /* Stop the pipeline threads before closing the file they read */
+    MRTpipeline_free(dump->pipeline);
+    MRTfilter_free(dump->filter);
+
+    Arena_free(dump->arena);
+    MRTattrCache_free(dump->attrCache);
+    free(dump->recBuf);
+    free(dump->index);
 
 	cfr_close(dump->f);
     free(dump);
@@ -134,60 +260,119 @@ void File_buf_close_dump(File_buf_t *dump)
 
 
 
-MRTentry* Read_next_mrt_entry(File_buf_t *dump)
-{   
-    MRTentry* tmp;
-    /* In case we read something at the previous iteration */
-    if (dump->actEntry)
+int File_buf_set_decompress_threads(File_buf_t *dump, int threads)
+{
+    if (dump == NULL || dump->parsed != 0 || dump->pipeline != NULL)
     {
-        /* If there is still a next entry that has not been already read */
-        if (dump->actEntry->next)
-        {
-            tmp = dump->actEntry->next;
-            dump->actEntry = dump->actEntry->next;
-            return tmp;
-        }
-        /* If there is nothing left to read, free all entries */
-        else
-        {
-            MRTentry_free(dump->actEntry);
-        }
+        return 0;
     }
 
-    MRTentry* entry = MRTentry_new();
-    entry->dumper = dump;
+    return cfr_set_threads(dump->f, threads);
+}
 
-    if (!entry)
+
+
+int File_buf_set_parse_threads(File_buf_t *dump, int threads)
+{
+    if (dump == NULL || dump->parsed != 0 || dump->pipeline != NULL || threads < 1)
     {
-        printf("Unable to allocate any memory\n");
-        dump->actEntry = NULL;
+        return 0;
+    }
+
+    dump->pipeline = MRTpipeline_new(dump, threads);
+
+    return dump->pipeline != NULL;
+}
+
+
+
+int File_buf_set_filter(File_buf_t *dump, MRTfilter_t* filter)
+{
+    if (dump == NULL || filter == NULL || dump->parsed != 0 || dump->pipeline != NULL)
+    {
+        return 0;
+    }
+
+    MRTfilter_free(dump->filter);
+    dump->filter = filter;
+
+    return 1;
+}
+
+
+
+u_char* File_buf_record_buffer(File_buf_t *dump, u_int32_t len)
+{
+    u_char* tmp;
+    size_t newSize;
+
+    if (len <= dump->recBufSize)
+    {
+        return dump->recBuf;
+    }
+
+    newSize = dump->recBufSize ? dump->recBufSize : MIN_RECORD_BUFFER;
+    while (newSize < len)
+    {
+        newSize *= 2;
+    }
+
+    /* The previous content does not need to be kept */
+    free(dump->recBuf);
+
+    if ((tmp = malloc(newSize)) == NULL)
+    {
+        dump->recBuf = NULL;
+        dump->recBufSize = 0;
         return NULL;
     }
 
+    dump->recBuf = tmp;
+    dump->recBufSize = newSize;
+
+    return dump->recBuf;
+}
+
+
+void File_buf_print_stats(File_buf_t *dump, FILE* out)
+{
+    fprintf(out, "Parsed records:          %d\n", dump->parsed);
+    fprintf(out, "Parsed records (OK):     %d\n", dump->parsed_ok);
+    fprintf(out, "Filtered records:        %d\n", dump->filtered);
+    fprintf(out, "Largest record:          %u bytes\n", dump->recBufHighWater);
+    fprintf(out, "Record buffer size:      %zu bytes\n", dump->recBufSize);
+    fprintf(out, "Entry arena size:        %zu bytes\n", dump->arena->allocated);
+    fprintf(out, "Interned attributes:     %u (%llu hits, %zu bytes)\n", dump->attrCache->nbAttrs,
+            (unsigned long long)dump->attrCache->hits, dump->attrCache->arena->allocated);
+}
+
+
+
+int Read_next_mrt_header(File_buf_t *dump, MRTentry* entry)
+{
     u_int32_t bytes_read;
+    u_int32_t hdrLen = 12;
     u_int8_t ok=0;
-    u_int8_t* bgpMsgBuffer;
+    u_char* hdr;
 
-    bytes_read = cfr_read_n(dump->f, &entry->time, 4);
-    bytes_read += cfr_read_n(dump->f, &(entry->entryType), 2);
-    bytes_read += cfr_read_n(dump->f, &(entry->entrySubType), 2);
-    bytes_read += cfr_read_n(dump->f, &(entry->entryLength), 4);
+    /* Parse the MRT header in place, from the read buffer */
+    bytes_read = cfr_peek(dump->f, (void**)&hdr, 12);
 
     if (bytes_read == 12) 
     {
-        /* Intel byte ordering stuff ... */
-        entry->entryType = ntohs(entry->entryType);
-        entry->entrySubType = ntohs(entry->entrySubType);
-        entry->time = (time_t) ntohl (entry->time);
-        entry->entryLength = ntohl(entry->entryLength);
+        entry->time = get_buf_int(hdr);
+        entry->entryType = get_buf_short(hdr+4);
+        entry->entrySubType = get_buf_short(hdr+6);
+        entry->entryLength = get_buf_int(hdr+8);
         
         /* If Extended Header format, then reading the miscroseconds attribute */
         if (entry->entryType == MRT_TYPE_BGP4MP_ET) 
         {
-            bytes_read += cfr_read_n(dump->f, &(entry->time_ms), 4);
+            hdrLen = 16;
+            bytes_read = cfr_peek(dump->f, (void**)&hdr, 16);
             if (bytes_read == 16) 
             {
-                entry->time_ms = ntohl(entry->time_ms);
+                entry->time_ms = get_buf_int(hdr+12);
                 /* "The Microsecond Timestamp is included in the computation of
                  * the Length field value." (RFC6396 2011) */
                 entry->entryLength -= 4;
@@ -210,75 +395,333 @@ MRTentry* Read_next_mrt_entry(File_buf_t *dump)
             printf("Incomplete MRT header (%d bytes read, expecting 12 or 16)\n", bytes_read);
         }
         /* Nothing more to read, quit */
-        MRTentry_free(entry);
-        dump->eof = 1;
-        dump->actEntry = NULL;
-        return(NULL);
+        return 0;
     }
 
+    cfr_consume(dump->f, hdrLen);
     dump->parsed++;
 
     if(entry->entryLength == 0) 
     {
         printf("Iinvalid entry length: 0\n");
-        MRTentry_free(entry);
-        dump->eof = 1;
-        dump->actEntry = NULL;
-        return(NULL);
+        return 0;
     }
 
-    if ((bgpMsgBuffer = malloc(entry->entryLength)) == NULL) 
+    return 1;
+}
+
+
+
+int Read_mrt_record_body(File_buf_t *dump, MRTentry* entry, u_char** buffer)
+{
+    u_int32_t bytes_read;
+    u_int8_t* bgpMsgBuffer;
+
+    if (entry->entryLength > dump->recBufHighWater)
     {
-        printf("Out of memory\n");
-        MRTentry_free(entry);
-        dump->eof = 1;
-        dump->actEntry = NULL;
-        return(NULL);
+        dump->recBufHighWater = entry->entryLength;
     }
 
-    bytes_read = cfr_read_n(dump->f, bgpMsgBuffer, entry->entryLength);
+    /* Zero-copy case: the whole record is in the read buffer */
+    if (cfr_peek(dump->f, (void**)&bgpMsgBuffer, entry->entryLength) == entry->entryLength)
+    {
+        cfr_consume(dump->f, entry->entryLength);
+    }
+    /* Otherwise, copy the record in the record buffer */
+    else
+    {
+        if ((bgpMsgBuffer = File_buf_record_buffer(dump, entry->entryLength)) == NULL) 
+        {
+            printf("Out of memory\n");
+            return 0;
+        }
 
-    if(bytes_read != entry->entryLength) 
+        bytes_read = cfr_read_n(dump->f, bgpMsgBuffer, entry->entryLength);
+
+        if(bytes_read != entry->entryLength) 
+        {
+            printf("Incomplete dump record (%d bytes read, expecting %d)\n", bytes_read, entry->entryLength);
+            return 0;
+        }
+    }
+
+    *buffer = bgpMsgBuffer;
+    return 1;
+}
+
+
+
+int Skip_mrt_record_body(File_buf_t *dump, MRTentry* entry)
+{
+    u_int32_t bytes_read = cfr_skip(dump->f, entry->entryLength);
+
+    if (bytes_read != entry->entryLength)
     {
-	    printf("Incomplete dump record (%d bytes read, expecting %d)\n", bytes_read, entry->entryLength);
-        MRTentry_free(entry);
-        free(bgpMsgBuffer);
-        dump->eof = 1;
-        dump->actEntry = NULL;
-        return(NULL);
+        printf("Incomplete dump record (%d bytes read, expecting %d)\n", bytes_read, entry->entryLength);
+        return 0;
     }
 
+    return 1;
+}
+
+
+
+int Read_next_mrt_record(File_buf_t *dump, MRTentry* entry, u_char** buffer)
+{
+    return Read_next_mrt_header(dump, entry) && Read_mrt_record_body(dump, entry, buffer);
+}
+
+
+
+int process_mrt_record(u_char* buffer, MRTentry* entry)
+{
     switch(entry->entryType) 
     {
         case MRT_TYPE_BGP4MP:
         case MRT_TYPE_BGP4MP_ET:
-            ok = process_classic_message(bgpMsgBuffer, entry, entry->entryLength);
-            break;
+            return process_classic_message(buffer, entry, entry->entryLength);
 
         case MRT_TYPE_TABLE_DUMP_V2:
-            ok = process_bgp_rib(bgpMsgBuffer, entry, entry->entryLength);
-            break;
+            return process_bgp_rib(buffer, entry, entry->entryLength);
         
         default:
             printf("Sorry MRT type not handled\n");
+            return 0;
+    }
+}
+
+
+
+/* Decodes the next RIB entry of the cursor of the dumper that matches the filter, returns
+ * MRT_RECORD_FILTERED if there is none left */
+static int rib_cursor_next(File_buf_t *dump, MRTentry* entry)
+{
+    int ret;
+
+    while (dump->ribCursor.actEntry < dump->ribCursor.nbEntries)
+    {
+        if ((ret = MRTribCursor_next(&dump->ribCursor, entry)) != MRT_RECORD_FILTERED)
+        {
+            return ret;
+        }
+    }
+
+    return MRT_RECORD_FILTERED;
+}
+
+
+/* Decodes a RIB record with the cursor of the dumper, up to its first RIB entry that matches the
+ * filter. Returns the same as process_mrt_record */
+static int rib_cursor_start(File_buf_t *dump, u_char* buffer, MRTentry* entry)
+{
+    int ret;
+
+    if ((ret = MRTribCursor_start(&dump->ribCursor, buffer, entry, entry->entryLength)) != 1)
+    {
+        return ret;
+    }
+
+    if ((ret = rib_cursor_next(dump, entry)) == MRT_RECORD_FILTERED && !dump->filter)
+    {
+        return 0;
+    }
+
+    return ret;
+}
+
+
+static MRTentry* read_next_entry(File_buf_t *dump, int resetArena, int lazyRibs)
+{   
+    MRTentry* tmp;
+    int ret;
+
+    /* Next RIB entry of the record read with the cursor */
+    if (lazyRibs && dump->actEntry && dump->ribCursor.actEntry < dump->ribCursor.nbEntries)
+    {
+        if ((ret = rib_cursor_next(dump, dump->actEntry)) == 1)
+        {
+            return dump->actEntry;
+        }
+        else if (ret == 0)
+        {
+            dump->actEntry = NULL;
+            return NULL;
+        }
+    }
+
+    /* In case we read something at the previous iteration */
+    if (dump->actEntry)
+    {
+        /* If there is still a next entry that has not been already read */
+        if (dump->actEntry->next)
+        {
+            tmp = dump->actEntry->next;
+            dump->actEntry = dump->actEntry->next;
+            return tmp;
+        }
+    }
+
+    dump->actEntry = NULL;
+
+    /* Records framed and decoded by the pipeline threads */
+    if (dump->pipeline)
+    {
+        int end = 0;
+        MRTentry* entry = MRTpipeline_next_entry(dump->pipeline, &end);
+
+        if (end)
+        {
+            dump->eof = 1;
+        }
+        else if (entry)
+        {
+            dump->parsed_ok++;
+        }
+
+        dump->actEntry = entry;
+        return entry;
+    }
+
+    /* Release all the entries of the previous MRT record at once */
+    if (resetArena)
+    {
+        Arena_reset(dump->arena);
+    }
+
+    MRTentry* entry = MRTentry_new_from_arena(dump->arena);
+    u_int8_t* bgpMsgBuffer;
+
+    memset(&dump->ribCursor, 0, sizeof(MRTribCursor_t));
+
+    if (!entry)
+    {
+        printf("Unable to allocate any memory\n");
+        return NULL;
+    }
+
+    entry->dumper = dump;
+    entry->attrCache = dump->attrCache;
+
+    /* Skip the records that do not match the filter, reusing the same entry */
+    for (;;)
+    {
+        if (!Read_next_mrt_header(dump, entry))
+        {
+            dump->eof = 1;
+            return NULL;
+        }
+
+        /* Out of the filter: the body of the record is skipped without being decoded, and
+         * nothing is read after the end of the time range in monotonic mode */
+        if (dump->filter && !MRTfilter_match_header(dump->filter, entry))
+        {
+            if (MRTfilter_past_end(dump->filter, entry) || !Skip_mrt_record_body(dump, entry))
+            {
+                dump->eof = 1;
+                return NULL;
+            }
+
+            ret = MRT_RECORD_FILTERED;
+        }
+        else if (!Read_mrt_record_body(dump, entry, &bgpMsgBuffer))
+        {
+            dump->eof = 1;
+            return NULL;
+        }
+        /* The RIB entries are decoded one at a time by the cursor, from the record body */
+        else if (lazyRibs && entry->entryType == MRT_TYPE_TABLE_DUMP_V2 &&
+                 (entry->entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST || entry->entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST))
+        {
+            if ((ret = rib_cursor_start(dump, bgpMsgBuffer, entry)) == 0)
+            {
+                return NULL;
+            }
+        }
+        else if ((ret = process_mrt_record(bgpMsgBuffer, entry)) == 0)
+        {
+            return NULL;
+        }
+
+        if (ret != MRT_RECORD_FILTERED)
+        {
             break;
+        }
+
+        dump->filtered++;
+        MRTentry_reset(entry);
     }
 
-    free(bgpMsgBuffer);
+    dump->parsed_ok++;
+    dump->actEntry = entry;
+    return entry;
+}
+
+
+
+MRTentry* Read_next_mrt_entry(File_buf_t *dump)
+{
+    return read_next_entry(dump, 1, 0);
+}
+
+
+
+MRTentry* Read_next_mrt_entry_cursor(File_buf_t *dump)
+{
+    return read_next_entry(dump, 1, 1);
+}
+
+
+
+int Read_next_mrt_batch(File_buf_t *dump, MRTentry** entries, int maxEntries, size_t maxBytes)
+{
+    MRTentry* entry;
+    size_t nbBytes = 0;
+    int nbEntries = 0;
 
-    if(ok) 
+    if (!dump || !entries || maxEntries < 1)
     {
-	    dump->parsed_ok++;
-    } 
-    else 
+        return 0;
+    }
+
+    /* Release the entries of the previous batch, unless some RIB entries of its last MRT
+     * record remain to be read */
+    if (!dump->pipeline && !(dump->actEntry && dump->actEntry->next))
     {
-        MRTentry_free(entry);
+        Arena_reset(dump->arena);
         dump->actEntry = NULL;
-        return NULL;
     }
 
-    dump->actEntry = entry;
-    return entry;
+    while (nbEntries < maxEntries && dump->eof == 0)
+    {
+        /* Limits are only checked between two MRT records */
+        if (!(dump->actEntry && dump->actEntry->next))
+        {
+            if (maxBytes && nbBytes >= maxBytes)
+            {
+                break;
+            }
+
+            /* The entries of a pipeline batch are released when the next one is read */
+            if (dump->pipeline && nbEntries && MRTpipeline_batch_end(dump->pipeline))
+            {
+                break;
+            }
+        }
+
+        if ((entry = read_next_entry(dump, 0, 0)) == NULL)
+        {
+            continue;
+        }
+
+        if (entry->prev == NULL)
+        {
+            nbBytes += entry->entryLength;
+        }
+
+        entries[nbEntries++] = entry;
+    }
+
+    return nbEntries;
 }
 
 
@@ -290,9 +733,9 @@ int process_classic_message(u_char* buffer, MRTentry* entry, int max_len)
         return 0;
     }
 
+    MRTfilter_t* filter = entry->dumper ? entry->dumper->filter : NULL;
     u_char marker[16]; /* BGP marker */
     int actOff = 0;
-    u_char peer_ip[16];
     uint16_t msgSize;
     u_char msgType;
 
@@ -339,35 +782,34 @@ int process_classic_message(u_char* buffer, MRTentry* entry, int max_len)
     /* Parsing source peer IP */
     if (entry->afi == BGP_IPV4_AFI)
     {
-        get_buf_n(buffer+actOff, (char*)peer_ip, 4);
+        memset(entry->peerAddr, 0, sizeof(entry->peerAddr));
+        get_buf_n(buffer+actOff, (char*)entry->peerAddr, 4);
         UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0) 
 
         /* Skip destination IP */
         UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-
-        if (inet_ntop(AF_INET, peer_ip, entry->peerAddr, 64) == NULL) 
-        {
-            return 0;
-        }
     }
     else if (entry->afi == BGP_IPV6_AFI)
     {
-        get_buf_n(buffer+actOff, (char*)peer_ip, 16);
+        get_buf_n(buffer+actOff, (char*)entry->peerAddr, 16);
         UPDATE_AND_CHECK_LEN(actOff, 16, max_len, 0) 
 
         /* Skip destination IP */
         UPDATE_AND_CHECK_LEN(actOff, 16, max_len, 0) 
-
-        if (inet_ntop(AF_INET6, peer_ip, entry->peerAddr, 64) == NULL) 
-        {
-            return 0;
-        }
     }
     else
     {
         return 0;
     }
 
+    /* The peer of a BGP4MP message is not in any peer table */
+    entry->peerIndex = MRT_PEER_NO_INDEX;
+
+    if (filter && !MRTfilter_match_peer(filter, entry))
+    {
+        return MRT_RECORD_FILTERED;
+    }
+
     if (entry->entrySubType == MRT_SUBTYPE_BGP4MP_STATE_CHANGE ||
         entry->entrySubType == MRT_SUBTYPE_BGP4MP_STATE_CHANGE_AS4)
     {
@@ -379,7 +821,7 @@ int process_classic_message(u_char* buffer, MRTentry* entry, int max_len)
         /* skipp new state */
         UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
 
-        return 1;
+        return filter && !MRTfilter_match(filter, entry) ? MRT_RECORD_FILTERED : 1;
     }
 
     /* Get BGP marker */
@@ -407,15 +849,28 @@ int process_classic_message(u_char* buffer, MRTentry* entry, int max_len)
     msgType = get_buf_char(buffer+actOff);
     UPDATE_AND_CHECK_LEN(actOff, 1, max_len, 0)
 
-    switch (msgType)
+    entry->bgpType = msgType;
+
+    /* Only the updates are decoded further, so the other messages are filtered right away */
+    if (filter && (msgType != BGP_TYPE_UPDATE ? !MRTfilter_match(filter, entry) : !MRTfilter_match_bgp_type(filter, entry)))
     {
-        case BGP_TYPE_UPDATE:
-            entry->bgpType = BGP_TYPE_UPDATE;
-            return process_bgp_update(buffer+actOff, entry, msgSize - 19);
+        return MRT_RECORD_FILTERED;
+    }
 
-        default:
-            entry->bgpType = msgType;
-            return 1;
+    if (msgType != BGP_TYPE_UPDATE)
+    {
+        return 1;
+    }
+
+    if (!process_bgp_update(buffer+actOff, entry, msgSize - 19))
+    {
+        return 0;
+    }
+
+    /* Prefixes, origin and AS path are only known once the whole update is decoded */
+    if (filter && (!MRTfilter_match_prefixes(filter, entry) || !MRTfilter_match_attributes(filter, entry)))
+    {
+        return MRT_RECORD_FILTERED;
     }
 
     return 1;
@@ -426,46 +881,17 @@ int process_bgp_update(u_char* buffer, MRTentry* entry, int max_len)
 {
     int actOff = 0;
     int ret;
-    int parsedLen = 0;
 
     /* Get the withdraw length */
     uint16_t withdrawLen = get_buf_short(buffer+actOff);
     UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
 
-    uint16_t actWithLen = 0;
-
-
     /* parsing withdraw section */
-    while (actWithLen < withdrawLen)
-    {   
-        /* If already too much prefixes in the packet, just skip */
-        if (entry->nbWithdraw >= MAX_NB_PREFIXES)
-        {
-            parsedLen = get_buf_char(buffer+actOff);
-            if (parsedLen > 128)
-            {
-                return 0;
-            }
-            parsedLen = (parsedLen+7)/8;
-
-            UPDATE_AND_CHECK_LEN(actOff, parsedLen+1, max_len, 0)
-        }
-        else
-        {
-            /* Get te prefix length */
-            parsedLen = process_prefix(buffer+actOff, entry->pfxWithdraw[entry->nbWithdraw], AF_INET);
-            if (parsedLen == -1)
-            {
-                return 0;
-            }
-
-            UPDATE_AND_CHECK_LEN(actOff, parsedLen, max_len, 0)
-            actWithLen += parsedLen;
-            
-            entry->nbWithdraw++;
-        }
-        
+    if (actOff + withdrawLen > max_len || process_prefix_list(buffer+actOff, withdrawLen, BGP_IPV4_AFI, entry, 1) < 0)
+    {
+        return 0;
     }
+    actOff += withdrawLen;
 
     /* Get all attribute length */
     uint16_t allAttrLen = get_buf_short(buffer+actOff);
@@ -480,31 +906,9 @@ int process_bgp_update(u_char* buffer, MRTentry* entry, int max_len)
     actOff += allAttrLen;
 
     /* Parse IPv4 NLRI */
-    while (actOff < max_len)
+    if (actOff < max_len && process_prefix_list(buffer+actOff, max_len - actOff, BGP_IPV4_AFI, entry, 0) < 0)
     {
-        /* If already too much prefixes in the packet, just skip them */
-        if (entry->nbNLRI >= MAX_NB_PREFIXES)
-        {
-            parsedLen = get_buf_char(buffer+actOff);
-            if (parsedLen > 128)
-            {
-                return 0;
-            }
-            parsedLen = (parsedLen+7)/8;
-
-            UPDATE_AND_CHECK_LEN(actOff, parsedLen+1, max_len, 0)
-        }
-        else
-        {
-            ret = process_prefix(buffer+actOff, entry->pfxNLRI[entry->nbNLRI], AF_INET);
-            if (ret == -1)
-            {
-                return 0;
-            }
-
-            UPDATE_AND_CHECK_LEN(actOff, ret, max_len, 0)
-            entry->nbNLRI++;
-        }
+        return 0;
     }
 
     return 1;
@@ -535,11 +939,12 @@ int process_bgp_rib(u_char* buffer, MRTentry* entry, int max_len)
 
 int process_bgp_rib_index(u_char *buffer, MRTentry* entry, int max_len)
 {
+    File_buf_t* dump = entry->dumper;
+    rib_peer_index_t* peers;
     int actOff = 0;
     uint16_t viewLen;
     uint16_t peerCount;
     uint8_t peerType;
-    uint32_t peerIdx;
 
     /* Collector ID */
     UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0) 
@@ -555,188 +960,246 @@ int process_bgp_rib_index(u_char *buffer, MRTentry* entry, int max_len)
     peerCount = get_buf_short(buffer+actOff);
     UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
 
+    /* A new peer index replaces the previous one (if any) */
+    if (peerCount > dump->sizePeerIdx)
+    {
+        if ((peers = realloc(dump->index, peerCount * sizeof(rib_peer_index_t))) == NULL)
+        {
+            printf("Out of memory\n");
+            return 0;
+        }
+
+        dump->index = peers;
+        dump->sizePeerIdx = peerCount;
+    }
+    dump->actPeerIdx = 0;
+
     for (int i = 0 ; i < peerCount ; i++)
     {
+        rib_peer_index_t* peer = &dump->index[i];
+
         /* Get peer Type */
         peerType = get_buf_char(buffer+actOff);
         UPDATE_AND_CHECK_LEN(actOff, 1, max_len, 0)
         
         /* Skip peer ID */
         UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-        peerIdx = entry->dumper->actPeerIdx;
-        entry->dumper->actPeerIdx++;
 
-        if (peerIdx < 256)
+        memset(peer->addr, 0, sizeof(peer->addr));
+
+        if (peerType & 0x01) /* Case IPv6 peer */
         {
-            entry->dumper->index[peerIdx].afi = peerType;
-            entry->dumper->index[peerIdx].idx = peerIdx;
+            /* Get peer IP address */
+            peer->afi = BGP_IPV6_AFI;
+            memcpy(peer->addr, buffer+actOff, 16);
+            UPDATE_AND_CHECK_LEN(actOff, 16, max_len, 0)
+        }
+        else /* Case IPv4 peer */
+        {
+            /* Get peer IP address */
+            peer->afi = BGP_IPV4_AFI;
+            memcpy(peer->addr, buffer+actOff, 4);
+            UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
+        }
 
-            if (peerType & 0x01) /* Case IPv6 peer */
-            {
-                /* Get peer IP address */
-                if (inet_ntop(AF_INET6, buffer+actOff, entry->dumper->index[peerIdx].addr, 64) == NULL) 
-                {
-                    return 0;
-                }
-                UPDATE_AND_CHECK_LEN(actOff, 16, max_len, 0)
-            }
-            else /* Case IPv4 peer */
-            {
-                /* Get peer IP address */
-                if (inet_ntop(AF_INET, buffer+actOff, entry->dumper->index[peerIdx].addr, 64) == NULL) 
-                {
-                    return 0;
-                }
-                UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-            }
+        if (peerType & 0x02) /* Case ASN-32 peer */
+        {
+            /* Get peer ASN */
+            peer->asn = get_buf_int(buffer+actOff);
+            UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
+        }
+        else /* Case ASN-16 peer */
+        {
+            /* Get peer ASN */
+            peer->asn = get_buf_short(buffer+actOff);
+            UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
+        }
 
-            if (peerType & 0x02) /* Case ASN-32 peer */
-            {
-                /* Get peer ASN */
-                entry->dumper->index[peerIdx].asn = get_buf_int(buffer+actOff);
-                UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-            }
-            else /* Case ASN-16 peer */
-            {
-                /* Get peer ASN */
-                entry->dumper->index[peerIdx].asn = get_buf_short(buffer+actOff);
-                UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
-            }
+        /* The peer filter is evaluated once here, the RIB entries only check this flag */
+        peer->kept = dump->filter == NULL || MRTfilter_match_peer_addr(dump->filter, peer->asn, peer->afi, peer->addr);
+
+        dump->actPeerIdx++;
+    }
+
+    return 1;
+}
+
+int process_bgp_rib_entry(u_char *buffer, MRTentry* entry, int max_len)
+{
+    MRTribCursor_t cursor;
+    MRTentry* target = entry;
+    MRTentry* prevEntry = NULL;
+    int ret;
+
+    if ((ret = MRTribCursor_start(&cursor, buffer, entry, max_len)) != 1)
+    {
+        return ret;
+    }
+
+    /* One MRT entry per RIB entry, chained after the first one. The entry of a RIB entry that
+     * does not match the filter is reused for the next one */
+    while (cursor.actEntry < cursor.nbEntries)
+    {
+        if (!target && (target = MRTentry_copy_for_ribs(entry)) == NULL)
+        {
+            return 0;
+        }
 
+        if ((ret = MRTribCursor_next(&cursor, target)) == 0)
+        {
+            return 0;
         }
-        /* Just skip if to much IDs */
-        else
+
+        if (ret == MRT_RECORD_FILTERED)
         {
-            if (peerType & 0x01) /* Case IPv6 peer */
-            {
-                /* Skipp peer IP address */
-                UPDATE_AND_CHECK_LEN(actOff, 16, max_len, 0)
-            }
-            else /* Case IPv4 peer */
-            {
-                /* Skipp peer IP address */
-                UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-            }
+            continue;
+        }
 
-            if (peerType & 0x02) /* Case ASN-32 peer */
-            {
-                /* Skipp peer ASN */
-                UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-            }
-            else /* Case ASN-16 peer */
-            {
-                /* Skipp peer ASN */
-                UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
-            }
+        if (prevEntry)
+        {
+            target->prev = prevEntry;
+            prevEntry->next = target;
         }
+
+        prevEntry = target;
+        target = NULL;
+    }
+
+    /* The first kept RIB entry is always parsed in the first MRT entry */
+    if (!prevEntry)
+    {
+        return entry->dumper->filter ? MRT_RECORD_FILTERED : 0;
     }
 
     return 1;
 }
 
-int process_bgp_rib_entry(u_char *buffer, MRTentry* entry, int max_len)
+
+
+int MRTribCursor_start(MRTribCursor_t* cursor, u_char *buffer, MRTentry* entry, int max_len)
 {
+    MRTfilter_t* filter = entry->dumper->filter;
     int actOff = 0;
     int ret;
-    uint16_t nbEntries;
-    uint16_t peerIdx;
-    uint16_t attrLen;
+    Prefix_t* pfx;
+
+    memset(cursor, 0, sizeof(MRTribCursor_t));
 
     /* Skip sequence number */
     UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
 
     /* Process prefix */
+    if ((pfx = MRTentry_next_nlri(entry)) == NULL)
+    {
+        return 0;
+    }
+
     if (entry->entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST)
     {
-        ret = process_prefix(buffer+actOff, entry->pfxNLRI[entry->nbNLRI++], AF_INET);
+        ret = process_prefix(buffer+actOff, pfx, BGP_IPV4_AFI);
     }
     else
     {
-        ret = process_prefix(buffer+actOff, entry->pfxNLRI[entry->nbNLRI++], AF_INET6);
+        ret = process_prefix(buffer+actOff, pfx, BGP_IPV6_AFI);
     }
 
     if (ret == -1)
     {
         return 0;
     }
+    entry->nbNLRI++;
     UPDATE_AND_CHECK_LEN(actOff, ret, max_len, 0)
 
+    if (filter && !MRTfilter_match_prefixes(filter, entry))
+    {
+        return MRT_RECORD_FILTERED;
+    }
+
     /* Get the number of entries */
-    nbEntries = get_buf_short(buffer+actOff);
+    cursor->nbEntries = get_buf_short(buffer+actOff);
     UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
 
-    /* Process only the first RIB entry, skip other if exists */
+    cursor->buffer = buffer;
+    cursor->len    = max_len;
+    cursor->off    = actOff;
+
+    return 1;
+}
+
+
+
+int MRTribCursor_next(MRTribCursor_t* cursor, MRTentry* entry)
+{
+    MRTfilter_t* filter = entry->dumper->filter;
+    u_char* buffer = cursor->buffer;
+    int max_len = cursor->len;
+    int actOff = cursor->off;
+    uint16_t peerIdx;
+    uint16_t attrLen;
+    rib_peer_index_t* peer;
+    const MRTentry* attrs;
+
+    if (cursor->actEntry >= cursor->nbEntries)
+    {
+        return 0;
+    }
+    cursor->actEntry++;
+
+    /* The attributes of the previous RIB entry (if any) are replaced */
+    MRTentry_clear_attributes(entry);
+
     peerIdx = get_buf_short(buffer+actOff);
     UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
 
-
-    /* If peer Index is too long, skip */
-    if (peerIdx >= 256)
+    /* The peer must be in the peer index */
+    if (peerIdx >= entry->dumper->actPeerIdx)
     {
         return 0;
     }
 
-    /* Setup the peer infos according to index */
-    entry->peer_asn = entry->dumper->index[peerIdx].asn;
-    memcpy(entry->peerAddr, entry->dumper->index[peerIdx].addr, 32);
+    peer = &entry->dumper->index[peerIdx];
 
     /* Skip timestamp (already in MRT header) */
     UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
 
     /* Get attribute length */
     attrLen = get_buf_short(buffer+actOff);
-    UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0);
+    UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
 
-    /* Process attributes */
-    ret = process_bgp_attributes(buffer+actOff, entry, attrLen);
-    if (ret != attrLen)
+    if (actOff + attrLen > max_len)
     {
         return 0;
     }
+    cursor->off = actOff + attrLen;
 
-    UPDATE_AND_CHECK_LEN(actOff, attrLen, max_len, 0);
-    MRTentry* tmpEntry;
-    MRTentry* prevEntry = entry;
-
-    /* Skip other entries */
-    for (int i = 1 ; i < nbEntries ; i++)
+    /* Skip the attributes of the peers that are filtered out */
+    if (!peer->kept)
     {
-        tmpEntry = MRTentry_copy_for_ribs(entry);
-        tmpEntry->prev = prevEntry;
-        prevEntry->next = tmpEntry;
-
-        /* Process only the first RIB entry, skip other if exists */
-        peerIdx = get_buf_short(buffer+actOff);
-        UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
-
-
-        /* If peer Index is too long, skip */
-        if (peerIdx >= 256)
-        {
-            return 0;
-        }
-
-        /* Setup the peer infos according to index */
-        tmpEntry->peer_asn = entry->dumper->index[peerIdx].asn;
-        memcpy(tmpEntry->peerAddr, entry->dumper->index[peerIdx].addr, 32);
-
-        /* Skip timestamp */
-        UPDATE_AND_CHECK_LEN(actOff, 4, max_len, 0)
-
-        /* Get Attribute length */
-        attrLen = get_buf_short(buffer+actOff);
-        UPDATE_AND_CHECK_LEN(actOff, 2, max_len, 0)
-
-        /* Process attributes */
-        ret = process_bgp_attributes(buffer+actOff, tmpEntry, attrLen);
-        if (ret != attrLen)
-        {
-            return 0;
-        }
+        return MRT_RECORD_FILTERED;
+    }
 
-        UPDATE_AND_CHECK_LEN(actOff, attrLen, max_len, 0)
+    /* Setup the peer infos according to index */
+    entry->peerIndex = peerIdx;
+    entry->peer_asn = peer->asn;
+    entry->afi = peer->afi;
+    memcpy(entry->peerAddr, peer->addr, sizeof(entry->peerAddr));
+
+    /* The attributes are decoded once per distinct value and shared by the RIB entries
+     * holding it. They are decoded in the entry itself if they cannot be interned */
+    if (entry->attrCache && entry->arena &&
+        (attrs = MRTattrCache_get(entry->attrCache, buffer+actOff, attrLen, entry->entrySubType)) != NULL)
+    {
+        MRTentry_share_attributes(entry, attrs);
+    }
+    else if (process_bgp_attributes(buffer+actOff, entry, attrLen) != attrLen)
+    {
+        return 0;
+    }
 
-        prevEntry = tmpEntry;
+    if (filter && !MRTfilter_match_attributes(filter, entry))
+    {
+        MRTentry_clear_attributes(entry);
+        return MRT_RECORD_FILTERED;
     }
 
     return 1;
@@ -751,13 +1214,13 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
     uint8_t attrFlags, attrType;
     uint16_t attrLen;
     uint32_t asn, com;
-    uint32_t aspActStrLen = 0;
-    uint32_t comActStrlen = 0;
-    int ret;
+    uint32_t* asnList;
+    u_char* attrBuf;
     int parsedLen;
     uint8_t val;
     uint8_t segType;
     uint8_t segLen;
+    uint8_t asnSize;
     uint8_t nextHopLen;
     uint8_t isMRTcompressed;
 
@@ -828,6 +1291,8 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
                 segType   = 0;
                 segLen    = 0;
                 parsedLen = 0;
+                asnSize   = (entry->entrySubType == MRT_SUBTYPE_BGP4MP_MESSAGE ||
+                             entry->entrySubType == MRT_SUBTYPE_BGP4MP_MESSAGE_LOCAL) ? 2 : 4;
 
                 /* While we did not parse the entire AS path */
                 while (parsedLen < attrLen)
@@ -842,127 +1307,38 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
 
                     parsedLen += 2;
 
-                    /* Swicth AS path segment type */
-                    switch (segType)
-                    {   
-                        /* In case of an AS sequence */
-                        case BGP_UPDATE_AS_PATH_SEQ:
-                            /* AS seq */
-                            for (int i = 0 ; i < segLen ; i++)
-                            {
-                                // Parse the ASN
-                                if (entry->entrySubType == MRT_SUBTYPE_BGP4MP_MESSAGE || entry->entrySubType == MRT_SUBTYPE_BGP4MP_MESSAGE_LOCAL)
-                                {
-                                    asn = get_buf_short(buffer+actOff);
-                                    UPDATE_AND_CHECK_LEN(actOff, 2, allAttrLen, 0)
-                                    parsedLen += 2;
-                                }
-                                else
-                                {
-                                    asn = get_buf_int(buffer+actOff);
-                                    UPDATE_AND_CHECK_LEN(actOff, 4, allAttrLen, 0)
-                                    parsedLen += 4;
-                                }
-                                
-                                
-                                /* Do not add a extra space if last element of the AS-path */
-                                if (parsedLen == attrLen)
-                                {
-                                    ret = snprintf(entry->asPath+aspActStrLen, MAX_ATTR - aspActStrLen, "%u", asn);
-                                }
-                                else
-                                {
-                                    ret = snprintf(entry->asPath+aspActStrLen, MAX_ATTR - aspActStrLen, "%u ", asn);
-                                }
-                                
-                                if (ret < 0)
-                                {
-                                    return 0;
-                                }
-
-                                aspActStrLen += ret;
-                                if (aspActStrLen >= MAX_SEND_BUFF)
-                                {
-                                    return 0;
-                                }
-                            }
-                            break;
-
-                        /* Case of an AS set */
-                        case BGP_UPDATE_AS_PATH_SET:
-                            /* AS Set */
-                            ret = snprintf(entry->asPath+aspActStrLen, MAX_ATTR - aspActStrLen, "{");
-                            if (ret < 0)
-                            {
-                                return 0;
-                            }
-
-                            aspActStrLen += ret;
-                            if (aspActStrLen >= MAX_SEND_BUFF)
-                            {
-                                return 0;
-                            }
-
-                            for (int i = 0 ; i < segLen ; i++)
-                            {
-                                if (entry->entrySubType == MRT_SUBTYPE_BGP4MP_MESSAGE || entry->entrySubType ==MRT_SUBTYPE_BGP4MP_MESSAGE_LOCAL)
-                                {
-                                    asn = get_buf_short(buffer+actOff);
-                                    UPDATE_AND_CHECK_LEN(actOff, 2, allAttrLen, 0)
-                                    parsedLen += 2;
-                                }
-                                else
-                                {
-                                    asn = get_buf_int(buffer+actOff);
-                                    UPDATE_AND_CHECK_LEN(actOff, 4, allAttrLen, 0)
-                                    parsedLen += 4;
-                                }
-
-                                ret = snprintf(entry->asPath+aspActStrLen, MAX_SEND_BUFF-aspActStrLen, "%u", asn);
-                                if (ret < 0)
-                                {
-                                    return 0;
-                                }
-
-                                aspActStrLen += ret;
-                                if (aspActStrLen >= MAX_SEND_BUFF)
-                                {
-                                    return 0;
-                                }
-
-                                if (i < segLen-1)
-                                {
-                                    ret = snprintf(entry->asPath+aspActStrLen, MAX_SEND_BUFF-aspActStrLen, ",");
-                                    if (ret < 0)
-                                    {
-                                        return 0;
-                                    }
-
-                                    aspActStrLen += ret;
-                                    if (aspActStrLen >= MAX_SEND_BUFF)
-                                    {
-                                        return 0;
-                                    }
-                                }
-                            }
-
-                            ret = snprintf(entry->asPath+aspActStrLen, MAX_SEND_BUFF-aspActStrLen, "}");
-                            if (ret < 0)
-                            {
-                                return 0;
-                            }
-
-                            aspActStrLen += ret;
-                            if (aspActStrLen >= MAX_SEND_BUFF)
-                            {
-                                return 0;
-                            }
-
-                            break;
-
-                        default:
-                            break;
+                    /* The ASNs are kept in binary form, the string is only built on demand by
+                     * MRTentry_as_path_str. Segments of unknown type are skipped */
+                    if (segType == BGP_UPDATE_AS_PATH_SEQ || segType == BGP_UPDATE_AS_PATH_SET)
+                    {
+                        if ((asnList = MRTentry_add_as_path_segment(entry, segType, segLen)) == NULL)
+                        {
+                            return 0;
+                        }
+                    }
+                    else
+                    {
+                        asnList = NULL;
+                    }
 
+                    for (int i = 0 ; i < segLen ; i++)
+                    {
+                        // Parse the ASN
+                        if (asnSize == 2)
+                        {
+                            asn = get_buf_short(buffer+actOff);
+                        }
+                        else
+                        {
+                            asn = get_buf_int(buffer+actOff);
+                        }
+                        UPDATE_AND_CHECK_LEN(actOff, asnSize, allAttrLen, 0)
+                        parsedLen += asnSize;
+
+                        if (asnList)
+                        {
+                            asnList[i] = asn;
+                        }
                     }
                 }
                 break;
@@ -970,6 +1346,15 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
             /* Parse the BGP communities */
             case BGP_UPDATE_NLRI_COMMUNITIES:
                 parsedLen = 0;
+
+                /* The communities are kept in binary form, the string is only built on demand
+                 * by MRTentry_communities_str */
+                if (!MRTentry_reserve_list(entry, (void**)&entry->stdCommunities, &entry->sizeStdCommunities,
+                                           entry->nbStdCommunities + (attrLen + 3) / 4, sizeof(u_int32_t)))
+                {
+                    return 0;
+                }
+
                 while (parsedLen < attrLen)
                 {   
                     /* Get the first 2 bytes */
@@ -982,26 +1367,47 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
                     UPDATE_AND_CHECK_LEN(actOff, 2, allAttrLen, 0)
                     parsedLen += 2;
 
-                    /* Do not add extra space if end of community set */
-                    if (parsedLen == attrLen)
-                    {
-                        ret = snprintf(entry->communities+comActStrlen, MAX_ATTR-comActStrlen, "%d:%d", asn, com);
-                    }
-                    else
-                    {
-                        ret = snprintf(entry->communities+comActStrlen, MAX_ATTR-comActStrlen, "%d:%d ", asn, com);
-                    }
-                    
-                    if (ret < 0)
-                    {
-                        return -1;
-                    }
+                    entry->stdCommunities[entry->nbStdCommunities++] = (asn << 16) | com;
+                }
+                entry->communitiesFormatted = 0;
+                break;
 
-                    comActStrlen += ret;
-                    if (comActStrlen >= MAX_ATTR)
-                    {
-                        return -1;
-                    }
+            /* Parse the large communities (RFC 8092), 12 bytes each */
+            case BGP_UPDATE_ATTR_LARGE_COMMUNITIES:
+                if (!MRTentry_reserve_list(entry, (void**)&entry->largeCommunities, &entry->sizeLargeCommunities,
+                                           entry->nbLargeCommunities + attrLen / 12, sizeof(LargeCommunity_t)))
+                {
+                    return 0;
+                }
+
+                attrBuf = buffer+actOff;
+                UPDATE_AND_CHECK_LEN(actOff, attrLen, allAttrLen, 0)
+
+                for (parsedLen = 0 ; parsedLen + 12 <= attrLen ; parsedLen += 12)
+                {
+                    LargeCommunity_t* large = &entry->largeCommunities[entry->nbLargeCommunities++];
+
+                    large->global = get_buf_int(attrBuf+parsedLen);
+                    large->local1 = get_buf_int(attrBuf+parsedLen+4);
+                    large->local2 = get_buf_int(attrBuf+parsedLen+8);
+                }
+                break;
+
+            /* Parse the extended communities (RFC 4360), 8 bytes each */
+            case BGP_UPDATE_ATTR_EXT_COMMUNITIES:
+                if (!MRTentry_reserve_list(entry, (void**)&entry->extCommunities, &entry->sizeExtCommunities,
+                                           entry->nbExtCommunities + attrLen / 8, sizeof(u_int64_t)))
+                {
+                    return 0;
+                }
+
+                attrBuf = buffer+actOff;
+                UPDATE_AND_CHECK_LEN(actOff, attrLen, allAttrLen, 0)
+
+                for (parsedLen = 0 ; parsedLen + 8 <= attrLen ; parsedLen += 8)
+                {
+                    entry->extCommunities[entry->nbExtCommunities++] =
+                        ((u_int64_t)get_buf_int(attrBuf+parsedLen) << 32) | get_buf_int(attrBuf+parsedLen+4);
                 }
                 break;
 
@@ -1015,10 +1421,7 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
                     return 0;
                 }
 
-                if (inet_ntop(AF_INET, buffer+actOff, entry->nextHop, 64) == NULL) 
-                {
-                    return 0;
-                }
+                Addr_to_str(BGP_IPV4_AFI, buffer+actOff, entry->nextHop);
 
                 UPDATE_AND_CHECK_LEN(actOff, attrLen, allAttrLen, 0)
 
@@ -1053,10 +1456,7 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
                 UPDATE_AND_CHECK_LEN(actOff, 1, allAttrLen, 0)
 
                 /* Get string for IPv6 nexthop address */
-                if (inet_ntop(AF_INET6, buffer+actOff, entry->nextHop, 64) == NULL) 
-                {
-                    return 0;
-                }
+                Addr_to_str(BGP_IPV6_AFI, buffer+actOff, entry->nextHop);
 
                 UPDATE_AND_CHECK_LEN(actOff, nextHopLen, allAttrLen, 0);
 
@@ -1072,19 +1472,14 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
                 }
                 
 
-                while (parsedLen < attrLen)
-                { 
-                    /* Get the prefix length */
-                    ret = process_prefix(buffer+actOff, entry->pfxNLRI[entry->nbNLRI], AF_INET6);
-                    if (ret == -1)
+                if (parsedLen < attrLen)
+                {
+                    if (actOff + attrLen - parsedLen > allAttrLen ||
+                        process_prefix_list(buffer+actOff, attrLen - parsedLen, BGP_IPV6_AFI, entry, 0) < 0)
                     {
                         return 0;
                     }
-
-                    UPDATE_AND_CHECK_LEN(actOff, ret, allAttrLen, 0)
-                    parsedLen += ret;
-                    
-                    entry->nbNLRI++;
+                    actOff += attrLen - parsedLen;
                 }
                 break;
 
@@ -1100,19 +1495,14 @@ int process_bgp_attributes(u_char* buffer, MRTentry* entry, int allAttrLen)
 
                 parsedLen = 3;
 
-                while (parsedLen < attrLen)
+                if (parsedLen < attrLen)
                 {
-                    /* Get te prefix length */
-                    ret = process_prefix(buffer+actOff, entry->pfxWithdraw[entry->nbWithdraw], AF_INET6);
-                    if (ret == -1)
+                    if (actOff + attrLen - parsedLen > allAttrLen ||
+                        process_prefix_list(buffer+actOff, attrLen - parsedLen, BGP_IPV6_AFI, entry, 1) < 0)
                     {
                         return 0;
                     }
-
-                    UPDATE_AND_CHECK_LEN(actOff, ret, allAttrLen, 0)
-                    parsedLen += ret;
-                    
-                    entry->nbWithdraw++;
+                    actOff += attrLen - parsedLen;
                 }
 
                 break;
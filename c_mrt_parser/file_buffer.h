@@ -9,6 +9,9 @@
 
 #include "cfr_files.h"
 #include "mrt_entry.h"
+#include "mrt_pipeline.h"
+#include "mrt_filter.h"
+#include "mrt_attr_cache.h"
 #include "bgp_macros.h"
 #include "common.h"
 #include "gillstream-config.h"
@@ -21,35 +24,67 @@
         return ret;                         \
     }                                       
 
+#define MIN_RECORD_BUFFER       (64 * 1024)
+
 #define BGPDUMP_MAX_FILE_LEN	1024
 #define BGPDUMP_MAX_AS_PATH_LEN	2000
 
 typedef struct 
 {
     /**
-     * @brief Address Family of the BGP peer.
+     * @brief AS number of the BGP peer.
      */
-    int afi;
+    uint32_t asn;
 
     /**
-     * @brief Index of this peer in the RIB file. The index is used
-     * as a pointer in a RIB entry record to know to which peer the
-     * entry corresponds.
+     * @brief Address family of the BGP peer (BGP_IPV4_AFI or BGP_IPV6_AFI).
      */
-    int idx;
+    uint8_t afi;
 
     /**
-     * @brief IP address (in string mode) of the BGP peer.
+     * @brief IP address of the BGP peer, in binary form (the last 12 bytes are zero for an
+     * IPv4 address).
      */
-    char addr[64];
+    uint8_t addr[16];
 
     /**
-     * @brief AS number of the BGP peer.
+     * @brief 1 if the peer matches the peer filter of the File buffer (or if there is no filter),
+     * 0 if its RIB entries are skipped.
      */
-    uint32_t asn;
+    uint8_t kept;
 } rib_peer_index_t;
 
 
+/**
+ * @brief Cursor over the RIB entries of a RIB_IPV4_UNICAST or RIB_IPV6_UNICAST record (see
+ * MRTribCursor_start). The prefix of the record is decoded once, and each RIB entry is then
+ * decoded on demand, directly from the body of the record.
+ */
+typedef struct
+{
+    /**
+     * @brief Body of the RIB record, which must remain valid while the cursor is used.
+     */
+    u_char* buffer;
+
+    /**
+     * @brief Length of the body of the RIB record.
+     */
+    int     len;
+
+    /**
+     * @brief Offset of the next RIB entry in the body of the record.
+     */
+    int     off;
+
+    /**
+     * @brief Number of RIB entries of the record, and number of them already decoded.
+     */
+    u_int16_t nbEntries;
+    u_int16_t actEntry;
+} MRTribCursor_t;
+
+
 typedef struct FileBuffer {
 
     /**
@@ -87,20 +122,85 @@ typedef struct FileBuffer {
     int		parsed_ok;
 
     /**
-     * @brief Contains the list of peer index structures (only in case of parsing
-     * a RIB dump).
+     * @brief Peer table of the TABLE_DUMP_V2 peer index (only in case of parsing a RIB dump),
+     * sized after its peer count (up to 65535 peers). The RIB entries reference their peer by
+     * its position in this table.
      */
-    rib_peer_index_t index[256];
+    rib_peer_index_t* index;
 
     /**
      * @brief Number of peers currently in the index table.
      */
     int     actPeerIdx;
 
+    /**
+     * @brief Number of peers allocated for the index table.
+     */
+    int     sizePeerIdx;
+
     /**
      * @brief MRT entry that we are currently reading.
      */
     MRTentry* actEntry;
+
+    /**
+     * @brief Arena from which all the MRT entries of the current MRT record (and their
+     * content) are allocated. It is reset each time a new MRT record is read, so that
+     * the entries returned by Read_next_mrt_entry remain valid until the next record.
+     */
+    Arena_t* arena;
+
+    /**
+     * @brief Buffer in which the raw MRT records are read. It is reused for every record
+     * and only grows when a record does not fit in it.
+     */
+    u_char* recBuf;
+
+    /**
+     * @brief Number of bytes allocated for the record buffer.
+     */
+    size_t recBufSize;
+
+    /**
+     * @brief Length of the largest MRT record read so far (high-water mark of the record
+     * buffer).
+     */
+    u_int32_t recBufHighWater;
+
+    /**
+     * @brief Pipeline of threads framing and decoding the MRT records (see
+     * File_buf_set_parse_threads), NULL if the records are read by the calling thread.
+     */
+    MRTpipeline_t* pipeline;
+
+    /**
+     * @brief Filter applied while parsing (see File_buf_set_filter), NULL if every message is
+     * kept.
+     */
+    MRTfilter_t* filter;
+
+    /**
+     * @brief Number of MRT records skipped because they do not match the filter.
+     */
+    int     filtered;
+
+    /**
+     * @brief Cache in which the path attributes of the RIB entries read by the calling thread
+     * are interned (the pipeline threads have their own caches).
+     */
+    MRTattrCache_t* attrCache;
+
+    /**
+     * @brief Cursor over the RIB entries of the current record, when it is read by
+     * Read_next_mrt_entry_cursor.
+     */
+    MRTribCursor_t ribCursor;
+
+    /**
+     * @brief Set if the data is read from a stream (see File_buf_create_fd), which can only be
+     * read forward.
+     */
+    int     streamed;
 } File_buf_t;
 
 
@@ -162,6 +262,26 @@ void get_buf_n(u_char* buf, char* dest, int n);
 File_buf_t* File_buf_create(const char *filename);
 
 
+/**
+ * @brief Creates a File buffer structure reading MRT data from a file descriptor, e.g., the read
+ * end of a pipe fed by a download. The data is decompressed and parsed as it arrives, so that the
+ * first MRT entries can be read before the whole file is received.
+ * 
+ * A stream can only be read forward: its sidecar index is not used (see MRTindex_seek), and bzip2
+ * streams are always decompressed by the calling thread (see File_buf_set_decompress_threads).
+ * 
+ * @param fd        File descriptor from which the data is read. It is closed with the structure
+ * (see File_buf_close_dump), or before returning if the structure cannot be created.
+ * @param name      Name of the stream, whose ending gives the compression format (as for
+ * File_buf_create, e.g., '.bz2'). If NULL, the data is read uncompressed.
+ * 
+ * @return File_buf_t*  Returns a pointer to the allocated file buffer structure, NULL if the
+ * stream cannot be opened.
+ */
+
+File_buf_t* File_buf_create_fd(int fd, const char *name);
+
+
 /**
  * @brief Free memory allocated for a file buffer structure. Also close the file used to read MRT
  * data from.
@@ -173,11 +293,84 @@ File_buf_t* File_buf_create(const char *filename);
 void	    File_buf_close_dump(File_buf_t *dump);
 
 
+/**
+ * @brief Decompress the file of a File buffer structure with a pool of threads. Only bzip2 files
+ * can be decompressed this way (one bzip2 block per thread), and only before the first MRT record
+ * is read. Otherwise, the file keeps being decompressed by the calling thread.
+ * 
+ * @param dump      Pointer to the File buffer structure.
+ * @param threads   Number of decompression threads.
+ * 
+ * @return int      Returns 1 if the file is decompressed by the pool of threads, 0 otherwise.
+ */
+
+int         File_buf_set_decompress_threads(File_buf_t *dump, int threads);
+
+
+/**
+ * @brief Parse the MRT records of a File buffer structure with a pipeline of threads: one thread
+ * frames the records by batches, and a pool of threads decodes the batches. Read_next_mrt_entry
+ * still returns the entries in the order of the file, but an entry then remains valid until all
+ * the entries of its batch are read. Must be called before the first MRT record is read, and
+ * after File_buf_set_decompress_threads (if used).
+ * 
+ * @param dump      Pointer to the File buffer structure.
+ * @param threads   Number of decoding threads.
+ * 
+ * @return int      Returns 1 if the records are parsed by the pipeline, 0 otherwise.
+ */
+
+int         File_buf_set_parse_threads(File_buf_t *dump, int threads);
+
+
+/**
+ * @brief Sets the filter of the BGP messages read from a File buffer structure. The records
+ * that cannot match the filter are skipped as early as possible: on their MRT header, on their
+ * BGP peer before their attributes are parsed, or once decoded, but before any string is built.
+ * Skipped records are not returned by Read_next_mrt_entry nor by Read_next_mrt_batch. Must be
+ * called before the first MRT record is read, and before File_buf_set_parse_threads (if used).
+ * 
+ * @param dump      Pointer to the File buffer structure.
+ * @param filter    Filter to apply, which is then owned (and freed) by the File buffer structure.
+ * 
+ * @return int      Returns 1 if the filter is set, 0 otherwise (the filter is then not owned by
+ * the File buffer structure).
+ */
+
+int         File_buf_set_filter(File_buf_t *dump, MRTfilter_t* filter);
+
+
+/**
+ * @brief Returns the record buffer of a File buffer structure, after making sure that it can
+ * hold at least len bytes. The buffer is reused from one MRT record to the other, so its
+ * content is only valid until the next call.
+ * 
+ * @param dump      Pointer to the File buffer structure owning the record buffer.
+ * @param len       Number of bytes that the buffer must be able to hold.
+ * 
+ * @return u_char*  Returns a pointer to the record buffer, NULL if no memory can be allocated.
+ */
+
+u_char*     File_buf_record_buffer(File_buf_t *dump, u_int32_t len);
+
+
+/**
+ * @brief Print the statistics of a File buffer structure (number of parsed records, memory used
+ * by the record buffer and the entry arena, ...).
+ * 
+ * @param dump      Pointer to the File buffer structure.
+ * @param out       Stream on which the statistics are printed.
+ */
+
+void        File_buf_print_stats(File_buf_t *dump, FILE* out);
+
+
 /**
  * @brief Read the next MRT record from the corrsponding File buffer structure. In case something
  * wrong happen during the parsing (e.g., parsing issue, unexpected format, unsupported record, ...),
  * the function returns a NULL pointer. In case there is no more data to read in the File buffer
- * structure, dump->eof is set to 1.
+ * structure, dump->eof is set to 1. The returned entry is allocated from the arena of the File
+ * buffer structure, and remains valid until the next MRT record is read.
  * 
  * @param dump      Pointer to the File buffer structure from which we will read the new MRT entry.
  * 
@@ -187,6 +380,119 @@ void	    File_buf_close_dump(File_buf_t *dump);
 MRTentry*	Read_next_mrt_entry(File_buf_t *dump);
 
 
+/**
+ * @brief Same as Read_next_mrt_entry, but the RIB entries of a RIB record are decoded one at a
+ * time, on each call, into the same MRT entry (sharing the prefix decoded once for the record),
+ * instead of being decoded all at once into a list of entries. A RIB file is then read with a
+ * constant amount of memory. The returned entry is only valid until the next call.
+ *
+ * When the records are parsed by a pipeline of threads, the RIB entries are decoded by the
+ * pipeline as with Read_next_mrt_entry.
+ * 
+ * @param dump      Pointer to the File buffer structure from which we will read the new MRT entry.
+ * 
+ * @return MRTentry*    Returns a pointer to a structure containing the newly read MRT entry.
+ */
+
+MRTentry*	Read_next_mrt_entry_cursor(File_buf_t *dump);
+
+
+/**
+ * @brief Read a batch of MRT entries from the corresponding File buffer structure, i.e., call
+ * Read_next_mrt_entry until maxEntries entries are read, or until the MRT records read weight
+ * maxBytes bytes, or until the end of the file. MRT records that cannot be parsed are skipped.
+ * The returned entries remain valid until the next call to Read_next_mrt_batch or to
+ * Read_next_mrt_entry. When the records are parsed by a pipeline of threads, a batch never
+ * spans over two batches of the pipeline.
+ * 
+ * @param dump          Pointer to the File buffer structure from which we will read the entries.
+ * @param entries       Array in which the pointers to the read entries are written.
+ * @param maxEntries    Maximum number of entries to read (size of the entries array).
+ * @param maxBytes      Maximum number of bytes of MRT records to read (0 for no limit). The last
+ * MRT record is always read entirely, so this limit can be slightly exceeded.
+ * 
+ * @return int      Returns the number of entries read. 0 means that there is no more data to read
+ * (dump->eof is then set to 1).
+ */
+
+int         Read_next_mrt_batch(File_buf_t *dump, MRTentry** entries, int maxEntries, size_t maxBytes);
+
+
+/**
+ * @brief Read the next raw MRT record from the corresponding File buffer structure, without
+ * decoding it. The MRT header is parsed into the entry given in argument, and the body of the 
+ * record is returned in place (from the read buffer of the file, or from the record buffer of
+ * the File buffer structure), so it is only valid until the next record is read.
+ * 
+ * @param dump      Pointer to the File buffer structure from which we will read the record.
+ * @param entry     MRT entry structure in which the MRT header values are written.
+ * @param buffer    Set to the body of the MRT record.
+ * 
+ * @return int      Returns 1 if a record was read, 0 if there is no more record to read (end of
+ * the file, truncated or malformed record).
+ */
+
+int         Read_next_mrt_record(File_buf_t *dump, MRTentry* entry, u_char** buffer);
+
+
+/**
+ * @brief Read the MRT header of the next record from the corresponding File buffer structure.
+ * The body of the record must then be read with Read_mrt_record_body, or skipped with
+ * Skip_mrt_record_body.
+ * 
+ * @param dump      Pointer to the File buffer structure from which we will read the header.
+ * @param entry     MRT entry structure in which the MRT header values are written.
+ * 
+ * @return int      Returns 1 if a header was read, 0 if there is no more record to read (end of
+ * the file, truncated or malformed header).
+ */
+
+int         Read_next_mrt_header(File_buf_t *dump, MRTentry* entry);
+
+
+/**
+ * @brief Read the body of the MRT record whose header has just been read, in place (see
+ * Read_next_mrt_record).
+ * 
+ * @param dump      Pointer to the File buffer structure from which we will read the body.
+ * @param entry     MRT entry structure holding the MRT header of the record.
+ * @param buffer    Set to the body of the MRT record.
+ * 
+ * @return int      Returns 1 if the body was read, 0 if the record is truncated.
+ */
+
+int         Read_mrt_record_body(File_buf_t *dump, MRTentry* entry, u_char** buffer);
+
+
+/**
+ * @brief Skip the body of the MRT record whose header has just been read, without copying nor
+ * decoding it.
+ * 
+ * @param dump      Pointer to the File buffer structure from which we will read the body.
+ * @param entry     MRT entry structure holding the MRT header of the record.
+ * 
+ * @return int      Returns 1 if the body was skipped, 0 if the record is truncated.
+ */
+
+int         Skip_mrt_record_body(File_buf_t *dump, MRTentry* entry);
+
+
+/**
+ * @brief Function used to decode the body of an MRT record, according to the MRT type found in
+ * its header (entry->entryType). Decoding a PEER_INDEX_TABLE record updates the peer index of
+ * the File buffer structure of the entry (entry->dumper).
+ * 
+ * @param buffer    Byte array containing the body of the MRT record.
+ * @param entry     MRT entry structure holding the MRT header values, filled with the decoded
+ * values.
+ * 
+ * @return int      Returns 0 if something went wrong when parsing the MRT record, 1 if everything
+ * was parsed correctly
+ */
+
+int         process_mrt_record(u_char* buffer, MRTentry* entry);
+
+
 /**
  * @brief Function that processes a MRT entry corresponding to a BGP update record (i.e., either BGP4MP or
  * BGP4MP_ET type). The different parsed values are stored in a MRT entry structure (passed in the
@@ -302,19 +608,71 @@ int process_bgp_rib_index(u_char *buffer, MRTentry* entry, int max_len);
 int process_bgp_rib_entry(u_char *buffer, MRTentry* entry, int max_len);
 
 
+/**
+ * @brief Function that starts reading a RIB record (RIB_IPV4_UNICAST or RIB_IPV6_UNICAST) with a
+ * cursor: the prefix of the record is decoded in the MRT entry, and the cursor is set on the
+ * first RIB entry of the record (see MRTribCursor_next).
+ * 
+ * @param cursor    Cursor to set up.
+ * @param buffer    Body of the RIB record, which must remain valid while the cursor is used.
+ * @param entry     MRT entry structure holding the MRT header of the record, in which the prefix
+ * is decoded.
+ * @param max_len   Length of the body of the RIB record.
+ * 
+ * @return int      Returns 0 if the record is malformed, MRT_RECORD_FILTERED if its prefix does
+ * not match the filter of the File buffer structure, 1 otherwise.
+ */
+
+int MRTribCursor_start(MRTribCursor_t* cursor, u_char *buffer, MRTentry* entry, int max_len);
+
 
 /**
- * @brief Function used to transform a prefix in its binary form into the corresponding string
+ * @brief Function that decodes the next RIB entry of a cursor: the peer and the BGP attributes
+ * of the RIB entry replace the ones of the MRT entry, which keeps its MRT header and prefix. The
+ * RIB entries are exhausted once cursor->actEntry reaches cursor->nbEntries.
+ * 
+ * @param cursor    Cursor set up by MRTribCursor_start.
+ * @param entry     MRT entry structure in which the RIB entry is decoded.
+ * 
+ * @return int      Returns 0 if the RIB entry is malformed (or if there is no RIB entry left),
+ * MRT_RECORD_FILTERED if it does not match the filter of the File buffer structure, 1 otherwise.
+ */
+
+int MRTribCursor_next(MRTribCursor_t* cursor, MRTentry* entry);
+
+
+
+/**
+ * @brief Function used to parse a prefix in its binary (NLRI) form into a prefix structure
  * 
  * @param buffer    Binary representation of the prefix.
- * @param string    String in which the prefix value will be stored.
- * @param afi       Address family of the parsed prefix.
+ * @param pfx       Prefix structure in which the prefix value will be stored.
+ * @param afi       Address family of the parsed prefix (BGP_IPV4_AFI or BGP_IPV6_AFI).
+ * 
+ * @return int      Returns -1 if something went wrong when parsing the MRT entry, number of
+ * bytes read in the buffer if everything was parsed correctly
+ */
+
+int process_prefix(u_char* buffer, Prefix_t* pfx, int afi);
+
+
+/**
+ * @brief Function used to parse a list of prefixes in their binary (NLRI) form, e.g., the
+ * announced or withdrawn prefixes of a BGP update. The prefixes are appended to the announced
+ * (or withdrawn) prefixes of the entry. Each prefix is copied with a single masked vector
+ * load and store when the architecture has them (SSE2 or NEON).
+ * 
+ * @param buffer    Binary representation of the list of prefixes.
+ * @param len       Length (in number of bytes) of the list.
+ * @param afi       Address family of the parsed prefixes (BGP_IPV4_AFI or BGP_IPV6_AFI).
+ * @param entry     MRT entry to which the prefixes are added.
+ * @param withdraw  1 if the prefixes are withdrawn, 0 if they are announced.
  * 
- * @return int      Returns -1 if something went wrong when parsing the MRT entry, length of the
- * output string if everything was parsed correctly
+ * @return int      Returns -1 if the list is malformed or if no memory can be allocated (no
+ * prefix is then added to the entry), the number of decoded prefixes otherwise.
  */
 
-int process_prefix(u_char* buffer, char* string, int afi);
+int process_prefix_list(u_char* buffer, int len, int afi, MRTentry* entry, int withdraw);
 
 
 /**
@@ -6,47 +6,1000 @@
 
 #include "file_buffer.h"
 #include "mrt_entry.h"
+#include "mrt_index.h"
+#include "mrt_merge.h"
 
+#include <unistd.h>
+#include <dirent.h>
+#include <glob.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <limits.h>
 
 
-int main(int argc, char** argv)
+/* Initial size of the buffer of the lines printed for the MRT entries, grown as needed */
+#define LINE_LEN    (4096 * 8)
+
+#define USAGE "Please use './bgpgill [-t decompression_threads] [-p parsing_threads] [-j jobs] [-o output_dir] [-f from_time] [-u until_time] [-i] input [input ...]' (an input is a file, a directory or a glob pattern)\n"
+
+
+/* Files to read, in the order in which they are given */
+typedef struct
+{
+    char** names;
+    int nb;
+    int size;
+} Inputs_t;
+
+
+/* Header of a line in the sorted run of a file, followed by the line itself */
+typedef struct
+{
+    u_int32_t time;
+    u_int32_t time_ms;
+    u_int32_t len;
+} RunLine_t;
+
+
+/* Sorted run of a file, in a temporary file which is only open while it is written, then while
+ * it is merged */
+typedef struct
+{
+    char* name;
+    FILE* f;
+
+    /* Header of the first line of the run, whose len is 0 if the run is empty */
+    RunLine_t first;
+} Run_t;
+
+
+/* Start of a file (timestamp of its first MRT record, or of the first line of its run), by which
+ * the files are only opened once the merge reaches them */
+typedef struct
 {
-    if (argc != 2)
+    u_int32_t time;
+    u_int32_t time_ms;
+    int input;
+} InputStart_t;
+
+
+/* Files parsed by a pool of workers, each file being entirely read by one worker */
+typedef struct
+{
+    Inputs_t* inputs;
+    int threads;
+    int parseThreads;
+    u_int32_t fromTime;
+    u_int32_t untilTime;
+    int buildIndex;
+
+    /* Directory of the per-input output files, NULL if the files are merged in one stream */
+    const char* outDir;
+
+    /* Sorted run (lines prefixed with their timestamp) of each file, when they are merged */
+    Run_t* runs;
+
+    pthread_mutex_t lock;
+    int next;
+    u_int64_t nbEntries;
+    int nbErrors;
+} Batch_t;
+
+
+
+/* Opens a file, reading it from fromTime (with its sidecar index, if any) until untilTime */
+static File_buf_t* open_dump(const char* filename, int threads, int parseThreads, u_int32_t fromTime, u_int32_t untilTime)
+{
+    File_buf_t* dump = File_buf_create(filename);
+    MRTfilter_t* filter;
+
+    if (!dump)
     {
-        printf("Please use './bgpgill [file_name]'\n");
-        exit(1);
+        return NULL;
+    }
+
+    if (fromTime > 0 || untilTime < 0xffffffff)
+    {
+        if ((filter = MRTfilter_new()) == NULL)
+        {
+            File_buf_close_dump(dump);
+            return NULL;
+        }
+
+        MRTfilter_set_time(filter, fromTime, untilTime);
+        File_buf_set_filter(dump, filter);
+    }
+
+    if (threads > 0)
+    {
+        File_buf_set_decompress_threads(dump, threads);
+    }
+
+    /* Start from the sidecar index (if any) instead of the beginning of the file */
+    if (fromTime > 0 && MRTindex_seek(dump, fromTime) < 0)
+    {
+        File_buf_close_dump(dump);
+        return NULL;
+    }
+
+    if (parseThreads > 0)
+    {
+        File_buf_set_parse_threads(dump, parseThreads);
+    }
+
+    return dump;
+}
+
+
+static int inputs_add(Inputs_t* inputs, const char* name)
+{
+    if (inputs->nb == inputs->size)
+    {
+        int size = inputs->size ? inputs->size * 2 : 64;
+        char** names = realloc(inputs->names, size * sizeof(char*));
+
+        if (!names)
+        {
+            fprintf(stderr, "Unable to allocate any memory\n");
+            return 0;
+        }
+        inputs->names = names;
+        inputs->size = size;
+    }
+
+    if ((inputs->names[inputs->nb] = strdup(name)) == NULL)
+    {
+        fprintf(stderr, "Unable to allocate any memory\n");
+        return 0;
+    }
+    inputs->nb++;
+
+    return 1;
+}
+
+
+static int is_index(const char* name)
+{
+    size_t len = strlen(name);
+
+    return len > 4 && strcmp(name + len - 4, ".idx") == 0;
+}
+
+
+static int compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+
+/* Adds the regular files of a directory, sorted by name. Hidden files and sidecar indexes are
+ * skipped */
+static int inputs_add_dir(Inputs_t* inputs, const char* path)
+{
+    DIR* dir = opendir(path);
+    struct dirent* ent;
+    struct stat st;
+    char name[PATH_MAX];
+    int first = inputs->nb;
+    int len = strlen(path);
+
+    if (!dir)
+    {
+        fprintf(stderr, "Unable to open directory %s\n", path);
+        return 0;
+    }
+
+    while (len > 1 && path[len - 1] == '/')
+    {
+        len--;
+    }
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_name[0] == '.' || is_index(ent->d_name))
+        {
+            continue;
+        }
+
+        snprintf(name, sizeof(name), "%.*s/%s", len, path, ent->d_name);
+        if (stat(name, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            continue;
+        }
+
+        if (!inputs_add(inputs, name))
+        {
+            closedir(dir);
+            return 0;
+        }
+    }
+
+    closedir(dir);
+    qsort(inputs->names + first, inputs->nb - first, sizeof(char*), compare_names);
+
+    return 1;
+}
+
+
+/* Adds the files of an input: a file, a directory, or a glob pattern (for the patterns that the
+ * shell did not expand) */
+static int inputs_expand(Inputs_t* inputs, const char* arg)
+{
+    struct stat st;
+    glob_t matches;
+    int ret = 1;
+
+    if (stat(arg, &st) == 0)
+    {
+        return S_ISDIR(st.st_mode) ? inputs_add_dir(inputs, arg) : inputs_add(inputs, arg);
+    }
+
+    /* A missing file is reported when it is opened */
+    if (!strpbrk(arg, "*?["))
+    {
+        return inputs_add(inputs, arg);
+    }
+
+    if (glob(arg, 0, NULL, &matches) != 0)
+    {
+        fprintf(stderr, "No file matches %s\n", arg);
+        return 0;
+    }
+
+    for (size_t i = 0 ; ret && i < matches.gl_pathc ; i++)
+    {
+        if (stat(matches.gl_pathv[i], &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            ret = inputs_add_dir(inputs, matches.gl_pathv[i]);
+        }
+        else if (!is_index(matches.gl_pathv[i]))
+        {
+            ret = inputs_add(inputs, matches.gl_pathv[i]);
+        }
+    }
+
+    globfree(&matches);
+
+    return ret;
+}
+
+
+static void inputs_free(Inputs_t* inputs)
+{
+    for (int i = 0 ; i < inputs->nb ; i++)
+    {
+        free(inputs->names[i]);
+    }
+    free(inputs->names);
+}
+
+
+static u_int64_t file_size(const char* name)
+{
+    struct stat st;
+
+    return stat(name, &st) == 0 ? st.st_size : 0;
+}
+
+
+/* Only the BGP4MP messages and the unicast RIB entries are printed */
+static int printable(MRTentry* entry)
+{
+    if (entry->entryType == MRT_TYPE_BGP4MP || entry->entryType == MRT_TYPE_BGP4MP_ET)
+    {
+        return 1;
+    }
+
+    return entry->entryType == MRT_TYPE_TABLE_DUMP_V2 &&
+        (entry->entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST || entry->entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST);
+}
+
+
+/* Returns the name of the output file of an input: its path (with the '/' replaced by '_', so
+ * that files with the same name in different directories do not collide) followed by .txt */
+static char* output_name(const char* outDir, const char* input)
+{
+    size_t len;
+    char* name;
+    char* c;
+
+    while (input[0] == '/' || (input[0] == '.' && input[1] == '/'))
+    {
+        input += input[0] == '/' ? 1 : 2;
+    }
+
+    len = strlen(outDir) + strlen(input) + 6;
+    if ((name = malloc(len)) == NULL)
+    {
+        return NULL;
+    }
+
+    snprintf(name, len, "%s/", outDir);
+    for (c = name + strlen(name) ; *input ; input++)
+    {
+        *c++ = *input == '/' ? '_' : *input;
+    }
+    strcpy(c, ".txt");
+
+    return name;
+}
+
+
+/* Creates the temporary file of a run, in $TMPDIR (/tmp by default). Returns 1 on success, 0
+ * otherwise */
+static int open_run(Run_t* run)
+{
+    const char* dir = getenv("TMPDIR");
+    char name[PATH_MAX];
+    int fd;
+
+    snprintf(name, sizeof(name), "%s/bgpgill.XXXXXX", dir && dir[0] ? dir : "/tmp");
+    if ((fd = mkstemp(name)) < 0)
+    {
+        return 0;
+    }
+
+    if ((run->name = strdup(name)) == NULL || (run->f = fdopen(fd, "w")) == NULL)
+    {
+        close(fd);
+        unlink(name);
+        free(run->name);
+        run->name = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/* Closes and removes the temporary file of a run */
+static void close_run(Run_t* run)
+{
+    if (run->f)
+    {
+        fclose(run->f);
+        run->f = NULL;
+    }
+
+    if (run->name)
+    {
+        unlink(run->name);
+        free(run->name);
+        run->name = NULL;
+    }
+}
+
+
+/* Orders the files by start, then by input (as they are given) */
+static int compare_starts(const void* a, const void* b)
+{
+    const InputStart_t* sa = a;
+    const InputStart_t* sb = b;
+
+    if (sa->time != sb->time)
+    {
+        return sa->time < sb->time ? -1 : 1;
     }
 
-    File_buf_t* dump = File_buf_create(argv[1]);
+    if (sa->time_ms != sb->time_ms)
+    {
+        return sa->time_ms < sb->time_ms ? -1 : 1;
+    }
+
+    return sa->input - sb->input;
+}
+
+
+/* Makes a line buffer at least len bytes long. Returns 0 if no memory can be allocated */
+static int line_reserve(char** line, size_t* size, size_t len)
+{
+    char* tmp;
+
+    if (len <= *size)
+    {
+        return 1;
+    }
+
+    if ((tmp = realloc(*line, len)) == NULL)
+    {
+        fprintf(stderr, "Unable to allocate any memory\n");
+        return 0;
+    }
+
+    *line = tmp;
+    *size = len;
+
+    return 1;
+}
+
+
+/* Parses one file of a batch into its output file, or into its sorted run when the files are
+ * merged. Returns 1 on success, 0 otherwise */
+static int batch_parse_file(Batch_t* batch, int i, u_int64_t* nbEntries)
+{
+    const char* input = batch->inputs->names[i];
+    char* line = NULL;
+    size_t size = 0;
+    char* name = NULL;
+    File_buf_t* dump;
     MRTentry* entry;
+    RunLine_t header;
+    Run_t* run = NULL;
+    FILE* out;
+    int ret = 1;
+
+    if (batch->buildIndex)
+    {
+        return MRTindex_build(input, NULL) >= 0;
+    }
+
+    if ((dump = open_dump(input, batch->threads, batch->parseThreads, batch->fromTime, batch->untilTime)) == NULL)
+    {
+        return 0;
+    }
+
+    if (batch->outDir)
+    {
+        if ((name = output_name(batch->outDir, input)) == NULL || (out = fopen(name, "w")) == NULL)
+        {
+            fprintf(stderr, "Unable to open the output file of %s\n", input);
+            free(name);
+            File_buf_close_dump(dump);
+            return 0;
+        }
+    }
+    else if (!open_run(run = &batch->runs[i]))
+    {
+        fprintf(stderr, "Unable to open a temporary file for %s\n", input);
+        File_buf_close_dump(dump);
+        return 0;
+    }
+    else
+    {
+        out = run->f;
+    }
 
-    while (dump->eof==0)
+    while (dump->eof == 0)
     {
-        entry = Read_next_mrt_entry(dump);
-        if (entry)
+        if ((entry = Read_next_mrt_entry_cursor(dump)) == NULL || !printable(entry))
         {
-            if (entry->entryType == MRT_TYPE_BGP4MP || entry->entryType == MRT_TYPE_BGP4MP_ET)
+            continue;
+        }
+
+        if (!line_reserve(&line, &size, MAX(LINE_LEN, MRTentry_str_len(entry))))
+        {
+            ret = 0;
+            break;
+        }
+
+        header.len = MRTentry_to_str(entry, line, size);
+        if (!batch->outDir)
+        {
+            header.time = entry->time;
+            header.time_ms = entry->time_ms;
+            fwrite(&header, sizeof(RunLine_t), 1, out);
+
+            if (run->first.len == 0)
             {
-                MRTentry_print(entry);
+                run->first = header;
             }
-            else if (entry->entryType == MRT_TYPE_TABLE_DUMP_V2)
+        }
+        fwrite(line, 1, header.len, out);
+        (*nbEntries)++;
+    }
+
+    File_buf_close_dump(dump);
+    free(line);
+
+    if (fflush(out) != 0 || ferror(out))
+    {
+        fprintf(stderr, "Unable to write the output of %s\n", input);
+        ret = 0;
+    }
+
+    /* A run is opened again once the merge reaches its first line */
+    fclose(out);
+    free(name);
+    if (run)
+    {
+        run->f = NULL;
+    }
+
+    return ret;
+}
+
+
+static void* batch_worker(void* arg)
+{
+    Batch_t* batch = arg;
+    u_int64_t nbEntries;
+    int stop;
+    int ok;
+    int i;
+
+    while (1)
+    {
+        pthread_mutex_lock(&batch->lock);
+        i = batch->next++;
+        /* A merged stream is not written at all if any file cannot be read */
+        stop = i >= batch->inputs->nb || (batch->runs && batch->nbErrors);
+        pthread_mutex_unlock(&batch->lock);
+
+        if (stop)
+        {
+            break;
+        }
+
+        nbEntries = 0;
+        ok = batch_parse_file(batch, i, &nbEntries);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->nbEntries += nbEntries;
+        batch->nbErrors += !ok;
+        pthread_mutex_unlock(&batch->lock);
+    }
+
+    return NULL;
+}
+
+
+/* Orders the current lines of the runs by timestamp, then by file (as MRTmerge_next does) */
+static int run_before(RunLine_t* heads, int a, int b)
+{
+    if (heads[a].time != heads[b].time)
+    {
+        return heads[a].time < heads[b].time;
+    }
+
+    if (heads[a].time_ms != heads[b].time_ms)
+    {
+        return heads[a].time_ms < heads[b].time_ms;
+    }
+
+    return a < b;
+}
+
+
+static void run_sift_down(RunLine_t* heads, int* heap, int heapSize, int pos)
+{
+    int child;
+    int tmp;
+
+    while ((child = 2 * pos + 1) < heapSize)
+    {
+        if (child + 1 < heapSize && run_before(heads, heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+
+        if (!run_before(heads, heap[child], heap[pos]))
+        {
+            break;
+        }
+
+        tmp = heap[pos];
+        heap[pos] = heap[child];
+        heap[child] = tmp;
+        pos = child;
+    }
+}
+
+
+static void run_sift_up(RunLine_t* heads, int* heap, int pos)
+{
+    int parent;
+    int tmp;
+
+    while (pos > 0)
+    {
+        parent = (pos - 1) / 2;
+
+        if (!run_before(heads, heap[pos], heap[parent]))
+        {
+            break;
+        }
+
+        tmp = heap[pos];
+        heap[pos] = heap[parent];
+        heap[parent] = tmp;
+        pos = parent;
+    }
+}
+
+
+/* Writes the lines of the sorted runs of all the files, ordered by timestamp. Only the header
+ * of the current line of each run is kept in memory, and a run is only opened once the merge
+ * reaches its first line (and closed once read), so that only the runs overlapping the current
+ * time are open */
+static int batch_merge_runs(Batch_t* batch, FILE* out)
+{
+    int nb = batch->inputs->nb;
+    RunLine_t* heads = calloc(nb, sizeof(RunLine_t));
+    InputStart_t* starts = calloc(nb, sizeof(InputStart_t));
+    int* heap = calloc(nb, sizeof(int));
+    char* line = malloc(LINE_LEN);
+    size_t size = LINE_LEN;
+    int heapSize = 0;
+    int nbStarts = 0;
+    int next = 0;
+    int ret = 1;
+    Run_t* run;
+    int i;
+
+    if (!heads || !starts || !heap || !line)
+    {
+        fprintf(stderr, "Unable to allocate any memory\n");
+        free(heads);
+        free(starts);
+        free(heap);
+        free(line);
+        return 0;
+    }
+
+    for (i = 0 ; i < nb ; i++)
+    {
+        if (batch->runs[i].first.len > 0)
+        {
+            starts[nbStarts].time = batch->runs[i].first.time;
+            starts[nbStarts].time_ms = batch->runs[i].first.time_ms;
+            starts[nbStarts++].input = i;
+        }
+    }
+    qsort(starts, nbStarts, sizeof(InputStart_t), compare_starts);
+
+    while (ret)
+    {
+        /* Opens the runs starting before the current line (or at the same time, as the lines
+         * with the same timestamp are ordered by file) */
+        while (next < nbStarts && (heapSize == 0 ||
+               heads[heap[0]].time > starts[next].time ||
+               (heads[heap[0]].time == starts[next].time && heads[heap[0]].time_ms >= starts[next].time_ms)))
+        {
+            i = starts[next++].input;
+            run = &batch->runs[i];
+
+            if ((run->f = fopen(run->name, "r")) == NULL ||
+                fread(&heads[i], sizeof(RunLine_t), 1, run->f) != 1)
             {
-                if (entry->entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST || entry->entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST)
-                {
-                    MRTentry_print(entry);
-                    // if (entry->entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST)
-                    // {
-                    //     MRTentry_print(entry);
-                    // }
-                }
+                fprintf(stderr, "Unable to read the temporary file of %s\n", batch->inputs->names[i]);
+                ret = 0;
+                break;
             }
 
-            //MRTentry_free(entry);
+            /* Removed as soon as it is open, the run being read from its descriptor */
+            unlink(run->name);
+            free(run->name);
+            run->name = NULL;
+
+            heap[heapSize++] = i;
+            run_sift_up(heads, heap, heapSize - 1);
+        }
+
+        if (!ret || heapSize == 0)
+        {
+            break;
+        }
+
+        i = heap[0];
+        run = &batch->runs[i];
+
+        if (!line_reserve(&line, &size, heads[i].len))
+        {
+            ret = 0;
+            break;
+        }
+
+        if (fread(line, 1, heads[i].len, run->f) != heads[i].len)
+        {
+            fprintf(stderr, "Unable to read the temporary file of %s\n", batch->inputs->names[i]);
+            ret = 0;
+            break;
+        }
+        fwrite(line, 1, heads[i].len, out);
+
+        if (fread(&heads[i], sizeof(RunLine_t), 1, run->f) != 1)
+        {
+            close_run(run);
+            heap[0] = heap[--heapSize];
+        }
+        run_sift_down(heads, heap, heapSize, 0);
+    }
+
+    free(heads);
+    free(starts);
+    free(heap);
+    free(line);
+
+    return ret;
+}
+
+
+/* Parses the files on jobs workers. Returns the number of files that could not be parsed */
+static int batch_run(Batch_t* batch, int jobs)
+{
+    pthread_t* workers = calloc(jobs, sizeof(pthread_t));
+    int started = 0;
+
+    if (!batch->outDir && !batch->buildIndex &&
+        (batch->runs = calloc(batch->inputs->nb, sizeof(Run_t))) == NULL)
+    {
+        fprintf(stderr, "Unable to allocate any memory\n");
+        free(workers);
+        return batch->inputs->nb;
+    }
+
+    pthread_mutex_init(&batch->lock, NULL);
+
+    while (workers && started < jobs && pthread_create(&workers[started], NULL, batch_worker, batch) == 0)
+    {
+        started++;
+    }
+
+    /* The files are parsed by the main thread if no worker can be started */
+    if (started == 0)
+    {
+        batch_worker(batch);
+    }
+
+    for (int i = 0 ; i < started ; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    if (batch->runs)
+    {
+        if (batch->nbErrors == 0 && !batch_merge_runs(batch, stdout))
+        {
+            batch->nbErrors++;
+        }
+
+        for (int i = 0 ; i < batch->inputs->nb ; i++)
+        {
+            close_run(&batch->runs[i]);
         }
+        free(batch->runs);
     }
 
-    //printf("PArsed OK: %d\n", dump->parsed_ok);
+    pthread_mutex_destroy(&batch->lock);
+    free(workers);
+
+    return batch->nbErrors;
+}
+
+
+
+/* Reads the timestamp of the first MRT record of a file (0 if it has none). Returns 1 on success,
+ * 0 if the file cannot be opened */
+static int dump_start(const char* filename, u_int32_t* start)
+{
+    File_buf_t* dump = File_buf_create(filename);
+    MRTentry hdr;
+
+    if (!dump)
+    {
+        return 0;
+    }
+
+    memset(&hdr, 0, sizeof(MRTentry));
+    *start = Read_next_mrt_header(dump, &hdr) ? hdr.time : 0;
     File_buf_close_dump(dump);
-    return 0;
+
+    return 1;
 }
 
+
+/* Prints the entries of the files merged by timestamp as they are read. The files are sorted by
+ * start, and each of them is only opened once the merge reaches its start (see
+ * MRTmerge_set_horizon), so that only the files overlapping the current time are open. Returns 1
+ * on success, 0 otherwise */
+static int merge_inputs(Inputs_t* inputs, int threads, int parseThreads, u_int32_t fromTime, u_int32_t untilTime,
+                        u_int64_t* nbEntries)
+{
+    InputStart_t* starts = calloc(inputs->nb, sizeof(InputStart_t));
+    MRTmerge_t* merge = MRTmerge_new();
+    File_buf_t* dump;
+    MRTentry* entry;
+    u_int32_t start;
+    int next = 0;
+    int ret = 1;
+    int i;
+
+    if (!starts || !merge)
+    {
+        fprintf(stderr, "Unable to allocate any memory\n");
+        free(starts);
+        MRTmerge_free(merge);
+        return 0;
+    }
+
+    for (i = 0 ; i < inputs->nb && ret ; i++)
+    {
+        starts[i].input = i;
+        ret = dump_start(inputs->names[i], &starts[i].time);
+    }
+    qsort(starts, inputs->nb, sizeof(InputStart_t), compare_starts);
+
+    while (ret)
+    {
+        MRTmerge_set_horizon(merge, next < inputs->nb ? starts[next].time : 0);
+
+        while ((entry = MRTmerge_next(merge)) != NULL)
+        {
+            if (printable(entry))
+            {
+                MRTentry_print(entry);
+                (*nbEntries)++;
+            }
+        }
+
+        if (next == inputs->nb)
+        {
+            break;
+        }
+
+        /* The merge reached the start of the next files (or read all the files added), which
+         * keep their order for the entries with the same timestamp */
+        start = starts[next].time;
+
+        while (ret && next < inputs->nb && starts[next].time == start)
+        {
+            i = starts[next++].input;
+
+            if ((dump = open_dump(inputs->names[i], threads, parseThreads, fromTime, untilTime)) == NULL ||
+                !MRTmerge_add_ranked(merge, dump, i))
+            {
+                File_buf_close_dump(dump);
+                ret = 0;
+            }
+        }
+    }
+
+    MRTmerge_free(merge);
+    free(starts);
+
+    return ret;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    int threads = 0;
+    int parseThreads = 0;
+    int buildIndex = 0;
+    int jobs = 1;
+    const char* outDir = NULL;
+    u_int32_t fromTime = 0;
+    u_int32_t untilTime = 0xffffffff;
+    Inputs_t inputs = { NULL, 0, 0 };
+    Batch_t batch;
+    u_int64_t nbBytes = 0;
+    u_int64_t nbEntries = 0;
+    struct timespec start, end;
+    double elapsed;
+    int nbErrors = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:p:j:o:if:u:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                threads = atoi(optarg);
+                break;
+
+            case 'p':
+                parseThreads = atoi(optarg);
+                break;
+
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+
+            case 'o':
+                outDir = optarg;
+                break;
+
+            case 'i':
+                buildIndex = 1;
+                break;
+
+            case 'f':
+                fromTime = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'u':
+                untilTime = strtoul(optarg, NULL, 10);
+                break;
+
+            default:
+                printf(USAGE);
+                exit(1);
+        }
+    }
+
+    if (optind >= argc)
+    {
+        printf(USAGE);
+        exit(1);
+    }
+
+    for (int i = optind ; i < argc ; i++)
+    {
+        if (!inputs_expand(&inputs, argv[i]))
+        {
+            inputs_free(&inputs);
+            exit(1);
+        }
+    }
+
+    if (inputs.nb == 0)
+    {
+        fprintf(stderr, "No file to read\n");
+        exit(1);
+    }
+
+    for (int i = 0 ; i < inputs.nb ; i++)
+    {
+        nbBytes += file_size(inputs.names[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* With a single worker, the files are merged by timestamp as they are read */
+    if (jobs <= 1 && !outDir && !buildIndex)
+    {
+        if (!merge_inputs(&inputs, threads, parseThreads, fromTime, untilTime, &nbEntries))
+        {
+            inputs_free(&inputs);
+            exit(1);
+        }
+    }
+    /* Otherwise each file is entirely parsed by one worker (into its own output file, or into a
+     * sorted run, the runs being then merged by timestamp) */
+    else
+    {
+        memset(&batch, 0, sizeof(Batch_t));
+        batch.inputs       = &inputs;
+        batch.threads      = threads;
+        batch.parseThreads = parseThreads;
+        batch.fromTime     = fromTime;
+        batch.untilTime    = untilTime;
+        batch.buildIndex   = buildIndex;
+        batch.outDir       = outDir;
+
+        nbErrors  = batch_run(&batch, MAX(1, MIN(jobs, inputs.nb)));
+        nbEntries = batch.nbEntries;
+    }
+
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* Aggregate throughput (over the size of the files as they are stored) */
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (elapsed <= 0)
+    {
+        elapsed = 1e-9;
+    }
+
+    if (buildIndex)
+    {
+        fprintf(stderr, "Indexed %d files (%.1f MB) in %.2f s: %.1f MB/s\n",
+            inputs.nb - nbErrors, nbBytes / 1e6, elapsed, nbBytes / 1e6 / elapsed);
+    }
+    else
+    {
+        fprintf(stderr, "Parsed %d files (%.1f MB) in %.2f s: %llu entries, %.0f entries/s, %.1f MB/s\n",
+            inputs.nb - nbErrors, nbBytes / 1e6, elapsed, (unsigned long long) nbEntries,
+            nbEntries / elapsed, nbBytes / 1e6 / elapsed);
+    }
+
+    if (nbErrors)
+    {
+        fprintf(stderr, "%d files could not be parsed\n", nbErrors);
+    }
+
+    inputs_free(&inputs);
+
+    return nbErrors ? 1 : 0;
+}
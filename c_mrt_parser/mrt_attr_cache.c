@@ -0,0 +1,181 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mrt_attr_cache.h"
+#include "file_buffer.h"
+
+
+static u_int32_t attr_hash(const u_char* raw, u_int16_t len)
+{
+    /* FNV-1a */
+    u_int32_t h = 2166136261u;
+
+    for (int i = 0 ; i < len ; i++)
+    {
+        h = (h ^ raw[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+
+static int attr_cache_resize(MRTattrCache_t* cache, u_int32_t newSize)
+{
+    MRTattr_t** slots = calloc(newSize, sizeof(MRTattr_t*));
+    u_int32_t slot;
+
+    if (!slots)
+    {
+        return 0;
+    }
+
+    for (u_int32_t i = 0 ; i < cache->nbSlots ; i++)
+    {
+        if (!cache->slots[i])
+        {
+            continue;
+        }
+
+        slot = cache->slots[i]->hash & (newSize - 1);
+        while (slots[slot])
+        {
+            slot = (slot + 1) & (newSize - 1);
+        }
+        slots[slot] = cache->slots[i];
+    }
+
+    free(cache->slots);
+    cache->slots = slots;
+    cache->nbSlots = newSize;
+
+    return 1;
+}
+
+
+/* Decodes the attributes in a new interned attribute, returns NULL if no memory can be
+ * allocated */
+static MRTattr_t* attr_new(MRTattrCache_t* cache, u_char* raw, u_int16_t len, u_int16_t subType, u_int32_t hash)
+{
+    MRTattr_t* attr = Arena_calloc(cache->arena, sizeof(MRTattr_t));
+
+    if (!attr || (attr->raw = Arena_alloc(cache->arena, len ? len : 1)) == NULL)
+    {
+        return NULL;
+    }
+
+    memcpy(attr->raw, raw, len);
+    attr->hash = hash;
+    attr->len  = len;
+
+    attr->decoded.arena        = cache->arena;
+    attr->decoded.entrySubType = subType;
+
+    if (process_bgp_attributes(attr->raw, &attr->decoded, len) != len ||
+        attr->decoded.nbNLRI || attr->decoded.nbWithdraw)
+    {
+        return attr;
+    }
+
+    /* The strings are built once, the entries sharing the attributes only read them */
+    if (!MRTentry_as_path_str(&attr->decoded) || !MRTentry_communities_str(&attr->decoded))
+    {
+        return NULL;
+    }
+
+    attr->shareable = 1;
+
+    return attr;
+}
+
+
+MRTattrCache_t* MRTattrCache_new(void)
+{
+    MRTattrCache_t* cache = calloc(1, sizeof(MRTattrCache_t));
+
+    if (!cache)
+    {
+        return NULL;
+    }
+
+    if ((cache->arena = Arena_new()) == NULL)
+    {
+        free(cache);
+        return NULL;
+    }
+
+    cache->maxBytes = MRT_ATTR_CACHE_MAX_BYTES;
+
+    return cache;
+}
+
+
+const MRTentry* MRTattrCache_get(MRTattrCache_t* cache, u_char* raw, u_int16_t len, u_int16_t subType)
+{
+    u_int32_t hash = attr_hash(raw, len);
+    u_int32_t slot;
+    MRTattr_t* attr;
+
+    if (!cache->slots && !attr_cache_resize(cache, MRT_ATTR_CACHE_MIN_SLOTS))
+    {
+        return NULL;
+    }
+
+    slot = hash & (cache->nbSlots - 1);
+    while ((attr = cache->slots[slot]) != NULL)
+    {
+        if (attr->hash == hash && attr->len == len && memcmp(attr->raw, raw, len) == 0)
+        {
+            cache->hits++;
+            return attr->shareable ? &attr->decoded : NULL;
+        }
+        slot = (slot + 1) & (cache->nbSlots - 1);
+    }
+
+    cache->misses++;
+
+    if (cache->arena->allocated >= cache->maxBytes)
+    {
+        return NULL;
+    }
+
+    /* Load factor of at most 1/2 */
+    if (2 * (cache->nbAttrs + 1) > cache->nbSlots)
+    {
+        if (!attr_cache_resize(cache, cache->nbSlots * 2))
+        {
+            return NULL;
+        }
+
+        slot = hash & (cache->nbSlots - 1);
+        while (cache->slots[slot])
+        {
+            slot = (slot + 1) & (cache->nbSlots - 1);
+        }
+    }
+
+    if ((attr = attr_new(cache, raw, len, subType, hash)) == NULL)
+    {
+        return NULL;
+    }
+
+    cache->slots[slot] = attr;
+    cache->nbAttrs++;
+
+    return attr->shareable ? &attr->decoded : NULL;
+}
+
+
+void MRTattrCache_free(MRTattrCache_t* cache)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    Arena_free(cache->arena);
+    free(cache->slots);
+    free(cache);
+}
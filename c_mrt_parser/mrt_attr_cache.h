@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __MRT_ATTR_CACHE_H__
+#define __MRT_ATTR_CACHE_H__
+
+#include "mrt_entry.h"
+
+/* Initial number of slots of the hash table of a cache (a power of two) */
+#define MRT_ATTR_CACHE_MIN_SLOTS    1024
+
+/* Default number of bytes (raw and decoded attributes) above which a cache stops interning new
+ * attributes. The attributes already interned remain shared */
+#define MRT_ATTR_CACHE_MAX_BYTES    (64 * 1024 * 1024)
+
+
+/**
+ * @brief Path attributes interned in a cache: the raw bytes of the attributes, and the entry
+ * in which they are decoded, whose attributes are shared by the RIB entries (see
+ * MRTentry_share_attributes).
+ */
+typedef struct
+{
+    /**
+     * @brief Hash of the raw attributes.
+     */
+    u_int32_t hash;
+
+    /**
+     * @brief Length of the raw attributes.
+     */
+    u_int16_t len;
+
+    /**
+     * @brief Raw attributes, as found in the RIB entry.
+     */
+    u_char* raw;
+
+    /**
+     * @brief Set if the attributes can be shared. Malformed attributes, and attributes carrying
+     * prefixes, are interned unshared, so that they are only decoded once to find it out.
+     */
+    u_int8_t shareable;
+
+    /**
+     * @brief Entry holding the decoded attributes, with their AS path and communities strings
+     * already built.
+     */
+    MRTentry decoded;
+} MRTattr_t;
+
+
+/**
+ * @brief Structure representing a cache of the path attributes of the RIB entries. In a RIB
+ * dump, the same attributes are found for many prefixes and peers: they are decoded once, and
+ * the RIB entries reference the decoded attributes instead of holding their own copy.
+ *
+ * Interned attributes are never evicted, so that they remain valid for all the entries
+ * referencing them until the cache is freed. A cache must only be used by one thread at a
+ * time.
+ */
+typedef struct MRTattrCache
+{
+    /**
+     * @brief Arena from which the interned attributes are allocated.
+     */
+    Arena_t* arena;
+
+    /**
+     * @brief Hash table (with linear probing) of the interned attributes.
+     */
+    MRTattr_t** slots;
+    u_int32_t nbSlots;
+
+    /**
+     * @brief Number of interned attributes.
+     */
+    u_int32_t nbAttrs;
+
+    /**
+     * @brief Number of bytes above which no new attributes are interned
+     * (MRT_ATTR_CACHE_MAX_BYTES by default). Caches used together split this budget.
+     */
+    size_t maxBytes;
+
+    /**
+     * @brief Number of lookups that found interned attributes, and that did not.
+     */
+    u_int64_t hits;
+    u_int64_t misses;
+} MRTattrCache_t;
+
+
+/**
+ * @brief Creates an empty attribute cache. No memory is allocated for the hash table until
+ * the first attributes are interned.
+ *
+ * @return MRTattrCache_t*  Returns a pointer to the cache, NULL if no memory can be allocated.
+ */
+MRTattrCache_t* MRTattrCache_new(void);
+
+
+/**
+ * @brief Returns the decoded form of the path attributes of a RIB entry, decoding and
+ * interning them if they are not in the cache yet.
+ *
+ * @param cache     Pointer to the cache.
+ * @param raw       Raw path attributes.
+ * @param len       Length of the raw path attributes.
+ * @param subType   MRT subtype of the RIB entry (the attributes are decoded accordingly).
+ *
+ * @return const MRTentry*  Returns the entry holding the decoded attributes, NULL if they cannot
+ * be interned (the cache is full, or the attributes are malformed or carry prefixes). The
+ * attributes must then be decoded in the RIB entry itself.
+ */
+const MRTentry* MRTattrCache_get(MRTattrCache_t* cache, u_char* raw, u_int16_t len, u_int16_t subType);
+
+
+/**
+ * @brief Frees an attribute cache and all the attributes interned in it. The entries sharing
+ * these attributes must not be used anymore.
+ *
+ * @param cache     Pointer to the cache.
+ */
+void MRTattrCache_free(MRTattrCache_t* cache);
+
+#endif
@@ -0,0 +1,406 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mrt_columns.h"
+#include "file_buffer.h"
+#include "mrt_index.h"
+#include "mrt_filter.h"
+
+
+static int grow_array(void** ptr, size_t* size, size_t needed, size_t elemSize)
+{
+    size_t newSize;
+    void* tmp;
+
+    if (needed <= *size)
+    {
+        return 1;
+    }
+
+    newSize = *size ? *size : MRT_COLUMNS_MIN_ROWS;
+    while (newSize < needed)
+    {
+        newSize *= 2;
+    }
+
+    if ((tmp = realloc(*ptr, newSize * elemSize)) == NULL)
+    {
+        return 0;
+    }
+
+    *ptr = tmp;
+    *size = newSize;
+
+    return 1;
+}
+
+
+static int grow_rows(MRTcolumns_t* cols, size_t needed)
+{
+    size_t newSize;
+    void* tmp;
+
+    if (needed <= cols->sizeRows)
+    {
+        return 1;
+    }
+
+    newSize = cols->sizeRows ? cols->sizeRows : MRT_COLUMNS_MIN_ROWS;
+    while (newSize < needed)
+    {
+        newSize *= 2;
+    }
+
+#define GROW_COLUMN(col, nb)                                        \
+    if ((tmp = realloc(cols->col, (nb) * sizeof(*cols->col))) == NULL) \
+    {                                                               \
+        return 0;                                                   \
+    }                                                               \
+    cols->col = tmp;
+
+    GROW_COLUMN(time, newSize)
+    GROW_COLUMN(timeMs, newSize)
+    GROW_COLUMN(peerId, newSize)
+    GROW_COLUMN(msgType, newSize)
+    GROW_COLUMN(origin, newSize)
+    GROW_COLUMN(nlriOffsets, newSize + 1)
+    GROW_COLUMN(withdrawOffsets, newSize + 1)
+    GROW_COLUMN(asPathOffsets, newSize + 1)
+    GROW_COLUMN(communityOffsets, newSize + 1)
+    GROW_COLUMN(largeCommunityOffsets, newSize + 1)
+    GROW_COLUMN(extCommunityOffsets, newSize + 1)
+
+#undef GROW_COLUMN
+
+    /* The first row starts at offset 0 */
+    if (cols->sizeRows == 0)
+    {
+        cols->nlriOffsets[0] = 0;
+        cols->withdrawOffsets[0] = 0;
+        cols->asPathOffsets[0] = 0;
+        cols->communityOffsets[0] = 0;
+        cols->largeCommunityOffsets[0] = 0;
+        cols->extCommunityOffsets[0] = 0;
+    }
+
+    cols->sizeRows = newSize;
+
+    return 1;
+}
+
+
+static u_int32_t peer_hash(u_int32_t asn, const u_int8_t* addr)
+{
+    /* FNV-1a */
+    u_int32_t h = 2166136261u;
+
+    for (int i = 0 ; i < 16 ; i++)
+    {
+        h = (h ^ addr[i]) * 16777619u;
+    }
+
+    for (int i = 0 ; i < 4 ; i++, asn >>= 8)
+    {
+        h = (h ^ (asn & 0xff)) * 16777619u;
+    }
+
+    return h;
+}
+
+
+static int peer_hash_resize(MRTcolumns_t* cols, u_int32_t newSize)
+{
+    u_int32_t* table = calloc(newSize, sizeof(u_int32_t));
+    u_int32_t slot;
+
+    if (!table)
+    {
+        return 0;
+    }
+
+    for (u_int32_t id = 0 ; id < cols->nbPeers ; id++)
+    {
+        slot = peer_hash(cols->peers[id].asn, cols->peers[id].bin) & (newSize - 1);
+        while (table[slot])
+        {
+            slot = (slot + 1) & (newSize - 1);
+        }
+        table[slot] = id + 1;
+    }
+
+    free(cols->peerHash);
+    cols->peerHash = table;
+    cols->peerHashSize = newSize;
+
+    return 1;
+}
+
+
+/* Returns the id of the peer, after adding it to the peer table if needed, -1 if no memory can be
+ * allocated */
+static int64_t peer_id(MRTcolumns_t* cols, u_int32_t asn, u_int8_t afi, const u_int8_t* addr)
+{
+    MRTpeer_t* peer;
+    u_int32_t slot;
+    u_int32_t id;
+    size_t size;
+
+    /* Keep the load factor of the hash table under 1/2 */
+    if (2 * (cols->nbPeers + 1) > cols->peerHashSize &&
+        !peer_hash_resize(cols, cols->peerHashSize ? cols->peerHashSize * 2 : 256))
+    {
+        return -1;
+    }
+
+    slot = peer_hash(asn, addr) & (cols->peerHashSize - 1);
+    while ((id = cols->peerHash[slot]) != 0)
+    {
+        peer = &cols->peers[id - 1];
+        if (peer->asn == asn && peer->afi == afi && memcmp(peer->bin, addr, sizeof(peer->bin)) == 0)
+        {
+            return id - 1;
+        }
+        slot = (slot + 1) & (cols->peerHashSize - 1);
+    }
+
+    size = cols->sizePeers;
+    if (!grow_array((void**)&cols->peers, &size, cols->nbPeers + 1, sizeof(MRTpeer_t)))
+    {
+        return -1;
+    }
+    cols->sizePeers = size;
+
+    /* The string form is only built once per peer */
+    peer = &cols->peers[cols->nbPeers];
+    peer->asn = asn;
+    peer->afi = afi;
+    memcpy(peer->bin, addr, sizeof(peer->bin));
+    Addr_to_str(afi, addr, peer->addr);
+    cols->peerHash[slot] = ++cols->nbPeers;
+
+    return cols->nbPeers - 1;
+}
+
+
+static u_int8_t origin_code(const char* origin)
+{
+    if (strcmp(origin, "IGP") == 0)
+    {
+        return BGP_UPDATE_ORIGIN_IGP;
+    }
+    else if (strcmp(origin, "EGP") == 0)
+    {
+        return BGP_UPDATE_ORIGIN_EGP;
+    }
+    else if (strcmp(origin, "INCOMPLETE") == 0)
+    {
+        return BGP_UPDATE_ORIGIN_INCOMPLETE;
+    }
+
+    return MRT_COLUMNS_NO_ORIGIN;
+}
+
+
+static u_int8_t msg_type_code(MRTentry* entry)
+{
+    if (entry->entryType == MRT_TYPE_TABLE_DUMP_V2)
+    {
+        return 'R';
+    }
+
+    switch (entry->bgpType)
+    {
+        case BGP_TYPE_OPEN:
+            return 'O';
+        case BGP_TYPE_UPDATE:
+            return 'U';
+        case BGP_TYPE_NOTIFICATION:
+            return 'N';
+        case BGP_TYPE_KEEPALIVE:
+            return 'K';
+        case BGP_TYPE_STATE_CHANGE:
+            return 'S';
+        default:
+            return '?';
+    }
+}
+
+
+MRTcolumns_t* MRTcolumns_new(void)
+{
+    return calloc(1, sizeof(MRTcolumns_t));
+}
+
+
+int MRTcolumns_append(MRTcolumns_t* cols, MRTentry* entry)
+{
+    size_t row = cols->nbRows;
+    size_t nbAsn = entry->nbAsPathAsn;
+    size_t nbCom = entry->nbStdCommunities;
+    size_t nbLarge = entry->nbLargeCommunities;
+    size_t nbExt = entry->nbExtCommunities;
+    int64_t id;
+
+    /* Allocate everything first, so that a failure leaves the columns untouched */
+    if (!grow_rows(cols, row + 1) ||
+        !grow_array((void**)&cols->nlri, &cols->sizeNLRI, cols->nbNLRI + entry->nbNLRI, sizeof(Prefix_t)) ||
+        !grow_array((void**)&cols->withdraws, &cols->sizeWithdraws, cols->nbWithdraws + entry->nbWithdraw, sizeof(Prefix_t)) ||
+        !grow_array((void**)&cols->asPath, &cols->sizeAsPath, cols->nbAsPath + nbAsn, sizeof(u_int32_t)) ||
+        !grow_array((void**)&cols->communities, &cols->sizeCommunities, cols->nbCommunities + nbCom, sizeof(u_int32_t)) ||
+        !grow_array((void**)&cols->largeCommunities, &cols->sizeLargeCommunities, cols->nbLargeCommunities + nbLarge, sizeof(LargeCommunity_t)) ||
+        !grow_array((void**)&cols->extCommunities, &cols->sizeExtCommunities, cols->nbExtCommunities + nbExt, sizeof(u_int64_t)) ||
+        (id = peer_id(cols, entry->peer_asn, entry->afi, entry->peerAddr)) < 0)
+    {
+        return 0;
+    }
+
+    cols->time[row]    = entry->time;
+    cols->timeMs[row]  = entry->time_ms;
+    cols->peerId[row]  = id;
+    cols->msgType[row] = msg_type_code(entry);
+    cols->origin[row]  = origin_code(entry->origin);
+
+    memcpy(cols->nlri + cols->nbNLRI, entry->pfxNLRI, entry->nbNLRI * sizeof(Prefix_t));
+    cols->nbNLRI += entry->nbNLRI;
+    cols->nlriOffsets[row + 1] = cols->nbNLRI;
+
+    memcpy(cols->withdraws + cols->nbWithdraws, entry->pfxWithdraw, entry->nbWithdraw * sizeof(Prefix_t));
+    cols->nbWithdraws += entry->nbWithdraw;
+    cols->withdrawOffsets[row + 1] = cols->nbWithdraws;
+
+    memcpy(cols->asPath + cols->nbAsPath, entry->asPathAsn, nbAsn * sizeof(u_int32_t));
+    cols->nbAsPath += nbAsn;
+    cols->asPathOffsets[row + 1] = cols->nbAsPath;
+
+    memcpy(cols->communities + cols->nbCommunities, entry->stdCommunities, nbCom * sizeof(u_int32_t));
+    cols->nbCommunities += nbCom;
+    cols->communityOffsets[row + 1] = cols->nbCommunities;
+
+    memcpy(cols->largeCommunities + cols->nbLargeCommunities, entry->largeCommunities, nbLarge * sizeof(LargeCommunity_t));
+    cols->nbLargeCommunities += nbLarge;
+    cols->largeCommunityOffsets[row + 1] = cols->nbLargeCommunities;
+
+    memcpy(cols->extCommunities + cols->nbExtCommunities, entry->extCommunities, nbExt * sizeof(u_int64_t));
+    cols->nbExtCommunities += nbExt;
+    cols->extCommunityOffsets[row + 1] = cols->nbExtCommunities;
+
+    cols->nbRows++;
+
+    return 1;
+}
+
+
+MRTcolumns_t* MRTcolumns_read_file(const char* filename, u_int32_t fromTime, u_int32_t untilTime, int threads, int parseThreads)
+{
+    MRTentry* entry;
+    MRTcolumns_t* cols;
+    MRTfilter_t* filter;
+    File_buf_t* dump;
+
+    if ((dump = File_buf_create(filename)) == NULL)
+    {
+        return NULL;
+    }
+
+    if ((cols = MRTcolumns_new()) == NULL)
+    {
+        printf("Unable to allocate any memory\n");
+        File_buf_close_dump(dump);
+        return NULL;
+    }
+
+    /* The records out of the time window are skipped before being decoded */
+    if (fromTime > 0 || untilTime < 0xffffffff)
+    {
+        if ((filter = MRTfilter_new()) == NULL)
+        {
+            printf("Unable to allocate any memory\n");
+            MRTcolumns_free(cols);
+            File_buf_close_dump(dump);
+            return NULL;
+        }
+
+        MRTfilter_set_time(filter, fromTime, untilTime);
+        File_buf_set_filter(dump, filter);
+    }
+
+    if (threads > 0)
+    {
+        File_buf_set_decompress_threads(dump, threads);
+    }
+
+    /* Start from the sidecar index of the file (if any) instead of its beginning */
+    if (fromTime > 0 && MRTindex_seek(dump, fromTime) < 0)
+    {
+        MRTcolumns_free(cols);
+        File_buf_close_dump(dump);
+        return NULL;
+    }
+
+    if (parseThreads > 0)
+    {
+        File_buf_set_parse_threads(dump, parseThreads);
+    }
+
+    /* The RIB entries are copied in the columns one at a time, so that they are decoded one at
+     * a time as well */
+    while (dump->eof == 0)
+    {
+        if ((entry = Read_next_mrt_entry_cursor(dump)) == NULL)
+        {
+            continue;
+        }
+
+        if (entry->entryType != MRT_TYPE_BGP4MP && entry->entryType != MRT_TYPE_BGP4MP_ET &&
+            !(entry->entryType == MRT_TYPE_TABLE_DUMP_V2 &&
+              (entry->entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST || entry->entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST)))
+        {
+            continue;
+        }
+
+        if (!MRTcolumns_append(cols, entry))
+        {
+            printf("Unable to allocate any memory\n");
+            MRTcolumns_free(cols);
+            File_buf_close_dump(dump);
+            return NULL;
+        }
+    }
+
+    File_buf_close_dump(dump);
+
+    return cols;
+}
+
+
+void MRTcolumns_free(MRTcolumns_t* cols)
+{
+    if (!cols)
+    {
+        return;
+    }
+
+    free(cols->time);
+    free(cols->timeMs);
+    free(cols->peerId);
+    free(cols->msgType);
+    free(cols->origin);
+    free(cols->nlriOffsets);
+    free(cols->nlri);
+    free(cols->withdrawOffsets);
+    free(cols->withdraws);
+    free(cols->asPathOffsets);
+    free(cols->asPath);
+    free(cols->communityOffsets);
+    free(cols->communities);
+    free(cols->largeCommunityOffsets);
+    free(cols->largeCommunities);
+    free(cols->extCommunityOffsets);
+    free(cols->extCommunities);
+    free(cols->peers);
+    free(cols->peerHash);
+    free(cols);
+}
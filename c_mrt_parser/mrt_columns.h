@@ -0,0 +1,180 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __MRT_COLUMNS_H__
+#define __MRT_COLUMNS_H__
+
+#include "mrt_entry.h"
+
+/* Value of the origin column when the message has no (or an unknown) ORIGIN attribute */
+#define MRT_COLUMNS_NO_ORIGIN   255
+
+/* Initial number of rows of the columns */
+#define MRT_COLUMNS_MIN_ROWS    1024
+
+
+/**
+ * @brief BGP peer referenced by the peer_id column.
+ */
+typedef struct
+{
+    /**
+     * @brief AS number of the BGP peer.
+     */
+    u_int32_t asn;
+
+    /**
+     * @brief Address family and binary IP address of the BGP peer (see MRTentry.peerAddr),
+     * used to look the peer up.
+     */
+    u_int8_t afi;
+    u_int8_t bin[16];
+
+    /**
+     * @brief IP address (in string mode) of the BGP peer.
+     */
+    char addr[64];
+} MRTpeer_t;
+
+
+/**
+ * @brief Structure holding the BGP messages of an MRT file in columnar form: one row per BGP
+ * message (BGP4MP message or RIB entry), one array per field. Variable-length fields (prefixes,
+ * AS path, communities) are stored as a flat array of values plus an array of nbRows+1 offsets:
+ * the values of row i are values[offsets[i]] to values[offsets[i+1]-1].
+ */
+typedef struct
+{
+    /**
+     * @brief Number of rows (i.e., BGP messages).
+     */
+    size_t      nbRows;
+
+    /**
+     * @brief Per-row columns: timestamp (seconds and microseconds), peer id (index in the peers
+     * array), message type (same letter as BGPmessage.msgType: 'U', 'R', 'O', 'N', 'K', 'S',
+     * or '?'), and origin (0 = IGP, 1 = EGP, 2 = INCOMPLETE, MRT_COLUMNS_NO_ORIGIN otherwise).
+     */
+    u_int32_t*  time;
+    u_int32_t*  timeMs;
+    u_int32_t*  peerId;
+    u_int8_t*   msgType;
+    u_int8_t*   origin;
+
+    /**
+     * @brief Announced prefixes.
+     */
+    u_int64_t*  nlriOffsets;
+    Prefix_t*   nlri;
+    size_t      nbNLRI;
+
+    /**
+     * @brief Withdrawn prefixes.
+     */
+    u_int64_t*  withdrawOffsets;
+    Prefix_t*   withdraws;
+    size_t      nbWithdraws;
+
+    /**
+     * @brief ASNs of the AS path (AS sets are flattened).
+     */
+    u_int64_t*  asPathOffsets;
+    u_int32_t*  asPath;
+    size_t      nbAsPath;
+
+    /**
+     * @brief Standard communities, each stored as a single 32-bit value (ASN << 16 | value).
+     */
+    u_int64_t*  communityOffsets;
+    u_int32_t*  communities;
+    size_t      nbCommunities;
+
+    /**
+     * @brief Large communities (RFC 8092).
+     */
+    u_int64_t*  largeCommunityOffsets;
+    LargeCommunity_t* largeCommunities;
+    size_t      nbLargeCommunities;
+
+    /**
+     * @brief Extended communities (RFC 4360), each stored as the 64-bit value of its 8 bytes
+     * (see MRTentry.extCommunities).
+     */
+    u_int64_t*  extCommunityOffsets;
+    u_int64_t*  extCommunities;
+    size_t      nbExtCommunities;
+
+    /**
+     * @brief Table of the BGP peers, referenced by the peerId column.
+     */
+    MRTpeer_t*  peers;
+    u_int32_t   nbPeers;
+
+    /* Allocated sizes (in number of elements) of the arrays above */
+    size_t      sizeRows;
+    size_t      sizeNLRI;
+    size_t      sizeWithdraws;
+    size_t      sizeAsPath;
+    size_t      sizeCommunities;
+    size_t      sizeLargeCommunities;
+    size_t      sizeExtCommunities;
+    u_int32_t   sizePeers;
+
+    /**
+     * @brief Hash table of the peers (peer id + 1, 0 for an empty slot).
+     */
+    u_int32_t*  peerHash;
+    u_int32_t   peerHashSize;
+} MRTcolumns_t;
+
+
+/**
+ * @brief Creates an empty set of columns.
+ *
+ * @return MRTcolumns_t*    Returns a pointer to the allocated columns, NULL if no memory can be
+ * allocated.
+ */
+MRTcolumns_t* MRTcolumns_new(void);
+
+
+/**
+ * @brief Appends a BGP message (MRT entry) as a new row of the columns.
+ *
+ * @param cols      Pointer to the columns.
+ * @param entry     MRT entry to append.
+ *
+ * @return int      Returns 1 if the row was appended, 0 if no memory can be allocated (the
+ * columns are then left untouched).
+ */
+int MRTcolumns_append(MRTcolumns_t* cols, MRTentry* entry);
+
+
+/**
+ * @brief Parses a whole MRT file into columns. Only the BGP messages (BGP4MP messages and
+ * IPv4/IPv6 unicast RIB entries) whose timestamp is in [fromTime, untilTime] are kept, the
+ * records out of this window being skipped before being decoded (see File_buf_set_filter). The
+ * reading starts from the sidecar index of the file, if any (see MRTindex_seek).
+ *
+ * @param filename      Name of the MRT file (compressed or not).
+ * @param fromTime      Minimum timestamp of the kept messages.
+ * @param untilTime     Maximum timestamp of the kept messages.
+ * @param threads       Number of decompression threads (see File_buf_set_decompress_threads).
+ * @param parseThreads  Number of parsing threads (see File_buf_set_parse_threads).
+ *
+ * @return MRTcolumns_t*    Returns a pointer to the allocated columns, NULL if the file cannot
+ * be opened or if no memory can be allocated.
+ */
+MRTcolumns_t* MRTcolumns_read_file(const char* filename, u_int32_t fromTime, u_int32_t untilTime, int threads, int parseThreads);
+
+
+/**
+ * @brief Frees the columns and all their arrays.
+ *
+ * @param cols      Pointer to the columns.
+ */
+void MRTcolumns_free(MRTcolumns_t* cols);
+
+#endif
@@ -7,10 +7,14 @@
 #include "mrt_entry.h"
 #include "bgp_macros.h"
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 
 
-#define MAX_BUFF_LEN 4096 * 8
+/* Size of the buffer of the lines printed on the stack, longer lines being allocated */
+#define MAX_BUFF_LEN (4096 * 8)
+
+#define STR_OR_EMPTY(s) ((s) ? (s) : "")
 
 
 MRTentry* MRTentry_new()
@@ -21,11 +25,31 @@ MRTentry* MRTentry_new()
 }
 
 
+MRTentry* MRTentry_new_from_arena(Arena_t* arena)
+{
+    MRTentry* entry = Arena_calloc(arena, sizeof(MRTentry));
+
+    if (entry)
+    {
+        entry->arena = arena;
+    }
+
+    return entry;
+}
+
+
 MRTentry* MRTentry_copy_for_ribs(MRTentry* entry)
 {
-    MRTentry* new_ = MRTentry_new();
+    MRTentry* new_ = entry->arena ? MRTentry_new_from_arena(entry->arena) : MRTentry_new();
+    Prefix_t* pfx;
+
+    if (!new_)
+    {
+        return NULL;
+    }
 
     new_->dumper       = entry->dumper;
+    new_->attrCache    = entry->attrCache;
     new_->time         = entry->time;
     new_->time_ms      = entry->time_ms;
     new_->entryType    = entry->entryType;
@@ -34,17 +58,691 @@ MRTentry* MRTentry_copy_for_ribs(MRTentry* entry)
 
     for (int i = 0 ; i < entry->nbNLRI ; i++)
     {
-        memcpy(new_->pfxNLRI[i], entry->pfxNLRI[i], 64);
+        if ((pfx = MRTentry_next_nlri(new_)) == NULL)
+        {
+            MRTentry_free_one(new_);
+            return NULL;
+        }
+
+        memcpy(pfx, &entry->pfxNLRI[i], sizeof(Prefix_t));
+        new_->nbNLRI++;
     }
-    new_->nbNLRI = entry->nbNLRI;
 
     return new_;
 }
 
 
+/* Drops the attributes shared with another entry, without touching them */
+static void unshare_attributes(MRTentry* entry)
+{
+    entry->asPathSegs       = NULL;
+    entry->asPathAsn        = NULL;
+    entry->stdCommunities   = NULL;
+    entry->largeCommunities = NULL;
+    entry->extCommunities   = NULL;
+    entry->asPath           = NULL;
+    entry->communities      = NULL;
+
+    entry->sizeAsPathSegs       = 0;
+    entry->sizeAsPathAsn        = 0;
+    entry->sizeStdCommunities   = 0;
+    entry->sizeLargeCommunities = 0;
+    entry->sizeExtCommunities   = 0;
+    entry->asPathSize           = 0;
+    entry->communitiesSize      = 0;
+
+    entry->attrs = NULL;
+}
+
+
+void MRTentry_reset(MRTentry* entry)
+{
+    if (entry->attrs)
+    {
+        unshare_attributes(entry);
+    }
+
+    Prefix_t* pfxNLRI          = entry->pfxNLRI;
+    Prefix_t* pfxWithdraw      = entry->pfxWithdraw;
+    u_int16_t sizeNLRI         = entry->sizeNLRI;
+    u_int16_t sizeWithdraw     = entry->sizeWithdraw;
+    AsPathSeg_t* asPathSegs    = entry->asPathSegs;
+    u_int32_t* asPathAsn       = entry->asPathAsn;
+    u_int16_t sizeAsPathSegs   = entry->sizeAsPathSegs;
+    u_int16_t sizeAsPathAsn    = entry->sizeAsPathAsn;
+    u_int32_t* stdCommunities  = entry->stdCommunities;
+    LargeCommunity_t* largeCommunities = entry->largeCommunities;
+    u_int64_t* extCommunities  = entry->extCommunities;
+    u_int16_t sizeStdCommunities   = entry->sizeStdCommunities;
+    u_int16_t sizeLargeCommunities = entry->sizeLargeCommunities;
+    u_int16_t sizeExtCommunities   = entry->sizeExtCommunities;
+    char*     asPath           = entry->asPath;
+    u_int32_t asPathSize       = entry->asPathSize;
+    char*     communities      = entry->communities;
+    u_int32_t communitiesSize  = entry->communitiesSize;
+    struct FileBuffer* dumper  = entry->dumper;
+    struct MRTattrCache* attrCache = entry->attrCache;
+    Arena_t*  arena            = entry->arena;
+
+    memset(entry, 0, sizeof(MRTentry));
+
+    entry->pfxNLRI         = pfxNLRI;
+    entry->pfxWithdraw     = pfxWithdraw;
+    entry->sizeNLRI        = sizeNLRI;
+    entry->sizeWithdraw    = sizeWithdraw;
+    entry->asPathSegs      = asPathSegs;
+    entry->asPathAsn       = asPathAsn;
+    entry->sizeAsPathSegs  = sizeAsPathSegs;
+    entry->sizeAsPathAsn   = sizeAsPathAsn;
+    entry->stdCommunities       = stdCommunities;
+    entry->largeCommunities     = largeCommunities;
+    entry->extCommunities       = extCommunities;
+    entry->sizeStdCommunities   = sizeStdCommunities;
+    entry->sizeLargeCommunities = sizeLargeCommunities;
+    entry->sizeExtCommunities   = sizeExtCommunities;
+    entry->asPath          = asPath;
+    entry->asPathSize      = asPathSize;
+    entry->communities     = communities;
+    entry->communitiesSize = communitiesSize;
+    entry->dumper          = dumper;
+    entry->attrCache       = attrCache;
+    entry->arena           = arena;
+
+    if (entry->asPath)
+    {
+        entry->asPath[0] = 0;
+    }
+
+    if (entry->communities)
+    {
+        entry->communities[0] = 0;
+    }
+}
+
+
+void MRTentry_clear_attributes(MRTentry* entry)
+{
+    if (entry->attrs)
+    {
+        unshare_attributes(entry);
+    }
+
+    entry->origin[0]  = 0;
+    entry->nextHop[0] = 0;
+
+    entry->nbAsPathSegs       = 0;
+    entry->nbAsPathAsn        = 0;
+    entry->asPathFormatted    = 0;
+    entry->nbStdCommunities   = 0;
+    entry->nbLargeCommunities = 0;
+    entry->nbExtCommunities   = 0;
+    entry->communitiesFormatted = 0;
+}
+
+
+void MRTentry_share_attributes(MRTentry* entry, const MRTentry* attrs)
+{
+    memcpy(entry->origin, attrs->origin, sizeof(entry->origin));
+    memcpy(entry->nextHop, attrs->nextHop, sizeof(entry->nextHop));
+
+    /* The sizes are left to zero, so that nothing is ever written in the shared lists */
+    unshare_attributes(entry);
+
+    entry->asPathSegs         = attrs->asPathSegs;
+    entry->asPathAsn          = attrs->asPathAsn;
+    entry->nbAsPathSegs       = attrs->nbAsPathSegs;
+    entry->nbAsPathAsn        = attrs->nbAsPathAsn;
+    entry->asPath             = attrs->asPath;
+    entry->asPathFormatted    = attrs->asPathFormatted;
+
+    entry->stdCommunities     = attrs->stdCommunities;
+    entry->largeCommunities   = attrs->largeCommunities;
+    entry->extCommunities     = attrs->extCommunities;
+    entry->nbStdCommunities   = attrs->nbStdCommunities;
+    entry->nbLargeCommunities = attrs->nbLargeCommunities;
+    entry->nbExtCommunities   = attrs->nbExtCommunities;
+    entry->communities        = attrs->communities;
+    entry->communitiesFormatted = attrs->communitiesFormatted;
+
+    entry->attrs = attrs;
+}
+
+
+static void* entry_realloc(Arena_t* arena, void* ptr, size_t oldSize, size_t newSize)
+{
+    if (arena)
+    {
+        return Arena_realloc(arena, ptr, oldSize, newSize);
+    }
+
+    return realloc(ptr, newSize);
+}
+
+
+static Prefix_t* next_prefix_slot(Arena_t* arena, Prefix_t** list, u_int16_t* size, u_int16_t nb)
+{
+    Prefix_t* tmp;
+    u_int32_t newSize;
+
+    if (nb < *size)
+    {
+        return &(*list)[nb];
+    }
+
+    /* The counters are 16-bit long, we cannot store more prefixes */
+    if (*size == 0xffff)
+    {
+        return NULL;
+    }
+
+    newSize = *size ? *size * 2 : MIN_NB_PREFIXES;
+    if (newSize > 0xffff)
+    {
+        newSize = 0xffff;
+    }
+
+    if ((tmp = entry_realloc(arena, *list, *size * sizeof(Prefix_t), newSize * sizeof(Prefix_t))) == NULL)
+    {
+        return NULL;
+    }
+
+    *list = tmp;
+    *size = newSize;
+
+    return &(*list)[nb];
+}
+
+
+Prefix_t* MRTentry_next_nlri(MRTentry* entry)
+{
+    return next_prefix_slot(entry->arena, &entry->pfxNLRI, &entry->sizeNLRI, entry->nbNLRI);
+}
+
+
+Prefix_t* MRTentry_next_withdraw(MRTentry* entry)
+{
+    return next_prefix_slot(entry->arena, &entry->pfxWithdraw, &entry->sizeWithdraw, entry->nbWithdraw);
+}
+
+
+int MRTentry_reserve_list(MRTentry* entry, void** list, u_int16_t* size, u_int32_t needed, size_t elemSize)
+{
+    void* tmp;
+    u_int32_t newSize;
+
+    if (needed <= *size)
+    {
+        return 1;
+    }
+
+    /* The counters are 16-bit long, we cannot store more elements */
+    if (needed > 0xffff)
+    {
+        return 0;
+    }
+
+    newSize = *size ? *size : MIN_NB_LIST_ELEMS;
+    while (newSize < needed)
+    {
+        newSize *= 2;
+    }
+
+    if (newSize > 0xffff)
+    {
+        newSize = 0xffff;
+    }
+
+    if ((tmp = entry_realloc(entry->arena, *list, *size * elemSize, newSize * elemSize)) == NULL)
+    {
+        return 0;
+    }
+
+    *list = tmp;
+    *size = newSize;
+
+    return 1;
+}
+
+
+u_int32_t* MRTentry_add_as_path_segment(MRTentry* entry, u_int8_t type, u_int8_t len)
+{
+    u_int32_t* asn;
+
+    if (!MRTentry_reserve_list(entry, (void**)&entry->asPathSegs, &entry->sizeAsPathSegs,
+                               entry->nbAsPathSegs + 1, sizeof(AsPathSeg_t)) ||
+        !MRTentry_reserve_list(entry, (void**)&entry->asPathAsn, &entry->sizeAsPathAsn,
+                               entry->nbAsPathAsn + len, sizeof(u_int32_t)))
+    {
+        return NULL;
+    }
+
+    entry->asPathSegs[entry->nbAsPathSegs].type = type;
+    entry->asPathSegs[entry->nbAsPathSegs].len  = len;
+    entry->nbAsPathSegs++;
+
+    asn = &entry->asPathAsn[entry->nbAsPathAsn];
+    entry->nbAsPathAsn += len;
+    entry->asPathFormatted = 0;
+
+    return asn;
+}
+
+
+const char* MRTentry_as_path_str(MRTentry* entry)
+{
+    u_int32_t* asn = entry->asPathAsn;
+    u_int32_t off = 0;
+    int last;
+
+    if (entry->asPathFormatted)
+    {
+        return entry->asPath;
+    }
+
+    if (entry->nbAsPathSegs == 0)
+    {
+        return "";
+    }
+
+    /* At most 10 digits and a separator per ASN, plus the braces of the AS sets */
+    if (!MRTentry_reserve_str(entry, &entry->asPath, &entry->asPathSize,
+                              11 * entry->nbAsPathAsn + 2 * entry->nbAsPathSegs + 1))
+    {
+        return NULL;
+    }
+
+    for (int s = 0 ; s < entry->nbAsPathSegs ; s++)
+    {
+        AsPathSeg_t* seg = &entry->asPathSegs[s];
+
+        switch (seg->type)
+        {
+            /* ASNs separated by spaces, without any space after the last ASN of the path */
+            case BGP_UPDATE_AS_PATH_SEQ:
+                for (int i = 0 ; i < seg->len ; i++)
+                {
+                    last = s == entry->nbAsPathSegs - 1 && i == seg->len - 1;
+                    off += sprintf(entry->asPath + off, last ? "%u" : "%u ", asn[i]);
+                }
+                break;
+
+            /* ASNs separated by commas, between braces */
+            case BGP_UPDATE_AS_PATH_SET:
+                entry->asPath[off++] = '{';
+                for (int i = 0 ; i < seg->len ; i++)
+                {
+                    off += sprintf(entry->asPath + off, i < seg->len - 1 ? "%u," : "%u", asn[i]);
+                }
+                entry->asPath[off++] = '}';
+                break;
+        }
+
+        asn += seg->len;
+    }
+
+    entry->asPath[off] = 0;
+    entry->asPathFormatted = 1;
+
+    return entry->asPath;
+}
+
+
+u_int32_t MRTentry_origin_asn(MRTentry* entry)
+{
+    AsPathSeg_t* seg;
+
+    if (entry->nbAsPathSegs == 0)
+    {
+        return 0;
+    }
+
+    seg = &entry->asPathSegs[entry->nbAsPathSegs - 1];
+    if (seg->len == 0 || (seg->type == BGP_UPDATE_AS_PATH_SET && seg->len > 1))
+    {
+        return 0;
+    }
+
+    return entry->asPathAsn[entry->nbAsPathAsn - 1];
+}
+
+
+int MRTentry_as_path_len(MRTentry* entry)
+{
+    int len = 0;
+
+    for (int s = 0 ; s < entry->nbAsPathSegs ; s++)
+    {
+        len += entry->asPathSegs[s].type == BGP_UPDATE_AS_PATH_SET ? 1 : entry->asPathSegs[s].len;
+    }
+
+    return len;
+}
+
+
+int MRTentry_as_path_contains(MRTentry* entry, u_int32_t asn)
+{
+    for (int i = 0 ; i < entry->nbAsPathAsn ; i++)
+    {
+        if (entry->asPathAsn[i] == asn)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+const char* MRTentry_communities_str(MRTentry* entry)
+{
+    u_int32_t off = 0;
+
+    if (entry->communitiesFormatted)
+    {
+        return entry->communities;
+    }
+
+    if (entry->nbStdCommunities == 0)
+    {
+        return "";
+    }
+
+    /* At most 12 characters per community ("65535:65535 ") */
+    if (!MRTentry_reserve_str(entry, &entry->communities, &entry->communitiesSize, 12 * entry->nbStdCommunities + 1))
+    {
+        return NULL;
+    }
+
+    for (int i = 0 ; i < entry->nbStdCommunities ; i++)
+    {
+        off += sprintf(entry->communities + off, i < entry->nbStdCommunities - 1 ? "%u:%u " : "%u:%u",
+                       entry->stdCommunities[i] >> 16, entry->stdCommunities[i] & 0xffff);
+    }
+
+    entry->communities[off] = 0;
+    entry->communitiesFormatted = 1;
+
+    return entry->communities;
+}
+
+
+/* The match helpers scan the whole list without any early exit, so that the compiler can
+ * vectorize the loops */
+int MRTentry_has_community(MRTentry* entry, u_int32_t value, u_int32_t mask)
+{
+    int found = 0;
+
+    for (int i = 0 ; i < entry->nbStdCommunities ; i++)
+    {
+        found |= (entry->stdCommunities[i] & mask) == value;
+    }
+
+    return found;
+}
+
+
+int MRTentry_has_large_community(MRTentry* entry, LargeCommunity_t value, LargeCommunity_t mask)
+{
+    int found = 0;
+
+    for (int i = 0 ; i < entry->nbLargeCommunities ; i++)
+    {
+        found |= (entry->largeCommunities[i].global & mask.global) == value.global &&
+                 (entry->largeCommunities[i].local1 & mask.local1) == value.local1 &&
+                 (entry->largeCommunities[i].local2 & mask.local2) == value.local2;
+    }
+
+    return found;
+}
+
+
+int MRTentry_has_ext_community(MRTentry* entry, u_int64_t value, u_int64_t mask)
+{
+    int found = 0;
+
+    for (int i = 0 ; i < entry->nbExtCommunities ; i++)
+    {
+        found |= (entry->extCommunities[i] & mask) == value;
+    }
+
+    return found;
+}
+
+
+int MRTentry_reserve_str(MRTentry* entry, char** str, u_int32_t* size, u_int32_t needed)
+{
+    char* tmp;
+    u_int32_t newSize;
+
+    if (needed <= *size)
+    {
+        return 1;
+    }
+
+    newSize = *size ? *size : 64;
+    while (newSize < needed)
+    {
+        newSize *= 2;
+    }
+
+    if ((tmp = entry_realloc(entry->arena, *str, *size, newSize)) == NULL)
+    {
+        return 0;
+    }
+
+    /* A freshly allocated string must be empty */
+    if (*size == 0)
+    {
+        tmp[0] = 0;
+    }
+
+    *str  = tmp;
+    *size = newSize;
+
+    return 1;
+}
+
+
+/* Decimal representation of each byte value, for the IPv4 addresses and prefix lengths */
+static const char decTable[256][4] = {
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15",
+    "16", "17", "18", "19", "20", "21", "22", "23", "24", "25", "26", "27", "28", "29", "30", "31",
+    "32", "33", "34", "35", "36", "37", "38", "39", "40", "41", "42", "43", "44", "45", "46", "47",
+    "48", "49", "50", "51", "52", "53", "54", "55", "56", "57", "58", "59", "60", "61", "62", "63",
+    "64", "65", "66", "67", "68", "69", "70", "71", "72", "73", "74", "75", "76", "77", "78", "79",
+    "80", "81", "82", "83", "84", "85", "86", "87", "88", "89", "90", "91", "92", "93", "94", "95",
+    "96", "97", "98", "99", "100", "101", "102", "103", "104", "105", "106", "107", "108", "109", "110", "111",
+    "112", "113", "114", "115", "116", "117", "118", "119", "120", "121", "122", "123", "124", "125", "126", "127",
+    "128", "129", "130", "131", "132", "133", "134", "135", "136", "137", "138", "139", "140", "141", "142", "143",
+    "144", "145", "146", "147", "148", "149", "150", "151", "152", "153", "154", "155", "156", "157", "158", "159",
+    "160", "161", "162", "163", "164", "165", "166", "167", "168", "169", "170", "171", "172", "173", "174", "175",
+    "176", "177", "178", "179", "180", "181", "182", "183", "184", "185", "186", "187", "188", "189", "190", "191",
+    "192", "193", "194", "195", "196", "197", "198", "199", "200", "201", "202", "203", "204", "205", "206", "207",
+    "208", "209", "210", "211", "212", "213", "214", "215", "216", "217", "218", "219", "220", "221", "222", "223",
+    "224", "225", "226", "227", "228", "229", "230", "231", "232", "233", "234", "235", "236", "237", "238", "239",
+    "240", "241", "242", "243", "244", "245", "246", "247", "248", "249", "250", "251", "252", "253", "254", "255"
+};
+
+static const char hexDigits[] = "0123456789abcdef";
+
+
+/* Writes the decimal representation of a byte, the destination must have room for 3 characters */
+static inline char* write_dec(char* dst, u_int8_t val)
+{
+    dst[0] = decTable[val][0];
+    dst[1] = decTable[val][1];
+    dst[2] = decTable[val][2];
+
+    return dst + (val >= 100 ? 3 : val >= 10 ? 2 : 1);
+}
+
+
+static inline char* write_ipv4(char* dst, const u_int8_t* addr)
+{
+    dst = write_dec(dst, addr[0]);
+    *dst++ = '.';
+    dst = write_dec(dst, addr[1]);
+    *dst++ = '.';
+    dst = write_dec(dst, addr[2]);
+    *dst++ = '.';
+
+    return write_dec(dst, addr[3]);
+}
+
+
+/* Writes a 16-bit word in hexadecimal, without leading zeros */
+static inline char* write_hex16(char* dst, u_int16_t word)
+{
+    if (word >= 0x1000)
+    {
+        *dst++ = hexDigits[word >> 12];
+    }
+
+    if (word >= 0x100)
+    {
+        *dst++ = hexDigits[(word >> 8) & 0xf];
+    }
+
+    if (word >= 0x10)
+    {
+        *dst++ = hexDigits[(word >> 4) & 0xf];
+    }
+
+    *dst++ = hexDigits[word & 0xf];
+
+    return dst;
+}
+
+
+/* Same output as the inet_ntop of the glibc: the first longest run of (at least two) zero words
+ * is replaced by "::", and IPv4-compatible or IPv4-mapped addresses end in dotted-quad form */
+static char* write_ipv6(char* dst, const u_int8_t* addr)
+{
+    u_int16_t words[8];
+    int bestBase = -1, bestLen = 0;
+    int curBase = -1, curLen = 0;
+
+    for (int i = 0 ; i < 8 ; i++)
+    {
+        words[i] = (addr[2 * i] << 8) | addr[2 * i + 1];
+
+        if (words[i] == 0)
+        {
+            if (curBase == -1)
+            {
+                curBase = i;
+                curLen = 0;
+            }
+
+            if (++curLen > bestLen)
+            {
+                bestBase = curBase;
+                bestLen = curLen;
+            }
+        }
+        else
+        {
+            curBase = -1;
+        }
+    }
+
+    if (bestLen < 2)
+    {
+        bestBase = -1;
+    }
+
+    for (int i = 0 ; i < 8 ; i++)
+    {
+        if (bestBase != -1 && i >= bestBase && i < bestBase + bestLen)
+        {
+            if (i == bestBase)
+            {
+                *dst++ = ':';
+            }
+            continue;
+        }
+
+        if (i != 0)
+        {
+            *dst++ = ':';
+        }
+
+        if (i == 6 && bestBase == 0 && (bestLen == 6 || (bestLen == 5 && words[5] == 0xffff)))
+        {
+            return write_ipv4(dst, addr + 12);
+        }
+
+        dst = write_hex16(dst, words[i]);
+    }
+
+    if (bestBase != -1 && bestBase + bestLen == 8)
+    {
+        *dst++ = ':';
+    }
+
+    return dst;
+}
+
+
+int Addr_to_str(u_int8_t afi, const u_int8_t* addr, char* string)
+{
+    char* end = afi == BGP_IPV6_AFI ? write_ipv6(string, addr) : write_ipv4(string, addr);
+
+    *end = 0;
+
+    return end - string;
+}
+
+
+int Prefix_to_str(const Prefix_t* pfx, char* string, int len)
+{
+    char tmp_str[PREFIX_STR_LEN];
+    char* dst = len >= PREFIX_STR_LEN ? string : tmp_str;
+    char* end;
+
+    if (len <= 0)
+    {
+        return -1;
+    }
+
+    end = pfx->afi == BGP_IPV6_AFI ? write_ipv6(dst, pfx->pfx) : write_ipv4(dst, pfx->pfx);
+    *end++ = '/';
+    end = write_dec(end, pfx->pfxLen);
+    *end = 0;
+
+    /* Short destinations only get the string if it fits */
+    if (dst == tmp_str)
+    {
+        if (end - tmp_str >= len)
+        {
+            return -1;
+        }
+
+        memcpy(string, tmp_str, end - tmp_str + 1);
+    }
+
+    return end - dst;
+}
+
+
 
 void MRTentry_free_one(MRTentry* entry)
 {
+    /* Released when the arena is reset */
+    if (entry->arena)
+    {
+        return;
+    }
+
+    free(entry->pfxNLRI);
+    free(entry->pfxWithdraw);
+    free(entry->asPathSegs);
+    free(entry->asPathAsn);
+    free(entry->asPath);
+    free(entry->stdCommunities);
+    free(entry->largeCommunities);
+    free(entry->extCommunities);
+    free(entry->communities);
     free(entry);
 }
 
@@ -69,104 +767,147 @@ void MRTentry_free(MRTentry* entry)
 
 
 
-void MRTentry_print(MRTentry* entry)
+/* Appends a formatted string to a line of len bytes from *off. Returns 0 once the line is full,
+ * the string being then truncated (the line stays terminated, and *off is its length) */
+static int line_printf(char* buffer, int len, int* off, const char* fmt, ...)
 {
+    va_list args;
+    int ret;
+
+    if (*off >= len - 1)
+    {
+        return 0;
+    }
+
+    va_start(args, fmt);
+    ret = vsnprintf(buffer + *off, len - *off, fmt, args);
+    va_end(args);
+
+    if (ret < 0 || ret >= len - *off)
+    {
+        *off = len - 1;
+        return 0;
+    }
+
+    *off += ret;
+
+    return 1;
+}
+
+
+/* Appends a list of prefixes, separated by commas, followed by a '|'. Returns 0 once the line
+ * is full (only the prefixes that fit are written) */
+static int line_prefixes(char* buffer, int len, int* off, const Prefix_t* pfx, int nb)
+{
+    int ret;
+
+    for (int i = 0 ; i < nb ; i++)
+    {
+        if (i > 0 && !line_printf(buffer, len, off, ","))
+        {
+            return 0;
+        }
+
+        if ((ret = Prefix_to_str(&pfx[i], buffer + *off, len - *off)) < 0)
+        {
+            return 0;
+        }
+        *off += ret;
+    }
+
+    return line_printf(buffer, len, off, "|");
+}
+
+
+int MRTentry_str_len(MRTentry* entry)
+{
+    /* Type, time, separators, origin, next hop, peer ASN and address, newline and terminator */
+    size_t len = 2 + 11 + 2 + sizeof(entry->origin) + sizeof(entry->nextHop) + 4 + 11 + ADDR_STR_LEN + 2;
+
+    len += (size_t) (entry->nbNLRI + entry->nbWithdraw) * PREFIX_STR_LEN;
+    len += strlen(STR_OR_EMPTY(MRTentry_as_path_str(entry)));
+    len += strlen(STR_OR_EMPTY(MRTentry_communities_str(entry)));
+
+    return len;
+}
+
+
+int MRTentry_to_str(MRTentry* entry, char* buffer, int len)
+{
+    const char* type = "R|";
+    char peerAddr[ADDR_STR_LEN];
     int actOff = 0;
-    int ret = 0;
-    char buffer[MAX_BUFF_LEN];
-    memset(buffer, 0, MAX_BUFF_LEN);
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+    buffer[0] = '\0';
 
     if (entry->entryType == MRT_TYPE_BGP4MP || entry->entryType == MRT_TYPE_BGP4MP_ET)
-    {   
+    {
         switch (entry->bgpType)
         {
             case BGP_TYPE_OPEN:
-                ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "O|");
-                actOff += ret;
+                type = "O|";
                 break;
 
             case BGP_TYPE_UPDATE:
-                ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "U|");
-                actOff += ret;
+                type = "U|";
                 break;
 
             case BGP_TYPE_NOTIFICATION:
-                ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "N|");
-                actOff += ret;
+                type = "N|";
                 break;
 
             case BGP_TYPE_KEEPALIVE:
-                ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "K|");
-                actOff += ret;
+                type = "K|";
                 break;
 
             case BGP_TYPE_STATE_CHANGE:
-                ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "S|");
-                actOff += ret;
+                type = "S|";
                 break;
-        }
-    }
-    else
-    {
-        ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "R|");
-        actOff += ret; 
-    }
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%d|", entry->time);
-    actOff += ret;
-
-    for (int i = 0 ; i < entry->nbNLRI ; i++)
-    {
-        if (i == entry->nbNLRI-1)
-        {
-            ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s", entry->pfxNLRI[i]);
-            actOff += ret;
-        }
-        else
-        {
-            ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s,", entry->pfxNLRI[i]);
-            actOff += ret;
+            default:
+                type = "";
+                break;
         }
     }
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "|");
-    actOff += ret; 
+    Addr_to_str(entry->afi, entry->peerAddr, peerAddr);
 
-
-    for (int i = 0 ; i < entry->nbWithdraw ; i++)
+    /* Each part is only written if the previous ones fit */
+    if (line_printf(buffer, len, &actOff, "%s%d|", type, entry->time) &&
+        line_prefixes(buffer, len, &actOff, entry->pfxNLRI, entry->nbNLRI) &&
+        line_prefixes(buffer, len, &actOff, entry->pfxWithdraw, entry->nbWithdraw) &&
+        line_printf(buffer, len, &actOff, "%s|%s|%s|", entry->origin, entry->nextHop, STR_OR_EMPTY(MRTentry_as_path_str(entry))) &&
+        line_printf(buffer, len, &actOff, "%s|%d|", STR_OR_EMPTY(MRTentry_communities_str(entry)), entry->peer_asn))
     {
-        if (i == entry->nbWithdraw-1)
-        {
-            ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s", entry->pfxWithdraw[i]);
-            actOff += ret;
-        }
-        else
-        {
-            ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s,", entry->pfxWithdraw[i]);
-            actOff += ret;
-        }
+        line_printf(buffer, len, &actOff, "%s\n", peerAddr);
     }
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "|");
-    actOff += ret; 
-
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s|", entry->origin);
-    actOff += ret;
-
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s|", entry->nextHop);
-    actOff += ret;
+    return actOff;
+}
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s|", entry->asPath);
-    actOff += ret;
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s|", entry->communities);
-    actOff += ret;
+void MRTentry_print(MRTentry* entry)
+{
+    char buffer[MAX_BUFF_LEN];
+    int len = MRTentry_str_len(entry);
+    char* line = buffer;
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%d|", entry->peer_asn);
-    actOff += ret;
+    /* Entries have no cap on their prefixes nor on their attributes: long lines are allocated */
+    if (len > MAX_BUFF_LEN && (line = malloc(len)) == NULL)
+    {
+        printf("Unable to allocate any memory\n");
+        return;
+    }
 
-    ret = snprintf(buffer+actOff, MAX_BUFF_LEN-actOff, "%s\n", entry->peerAddr);
-    actOff += ret;
+    MRTentry_to_str(entry, line, line == buffer ? MAX_BUFF_LEN : len);
+    fputs(line, stdout);
 
-    printf("%s", buffer);
+    if (line != buffer)
+    {
+        free(line);
+    }
 }
\ No newline at end of file
@@ -8,10 +8,18 @@
 #define __MRT_ENTRY_H__
 
 #include <stdlib.h>
+#include "arena.h"
 
-#define MAX_NB_PREFIXES 2048
+#define MIN_NB_PREFIXES 16
+#define MIN_NB_LIST_ELEMS 16
 
-#define MAX_ATTR 4096
+/* Maximum length (with the final \0) of the string of an IP address, and of a prefix. The
+ * formatters may write a few bytes past the end of the string, hence the margin */
+#define ADDR_STR_LEN    48
+#define PREFIX_STR_LEN  56
+
+/* Value of MRTentry.peerIndex for the messages whose peer is not in a peer table */
+#define MRT_PEER_NO_INDEX   0xffff
 
 
 /**
@@ -20,7 +28,7 @@
 typedef struct
 {
     /**
-     * @brief Address family of the IP prefix.
+     * @brief Address family of the IP prefix (BGP_IPV4_AFI or BGP_IPV6_AFI).
      */
     u_int8_t afi;
 
@@ -36,7 +44,37 @@ typedef struct
 } Prefix_t;
 
 
+/**
+ * @brief Structure describing a segment of an AS path. The ASNs of all the segments of a path
+ * are stored one after the other in the asPathAsn array of the MRT entry.
+ */
+typedef struct
+{
+    /**
+     * @brief Type of the segment (BGP_UPDATE_AS_PATH_SEQ or BGP_UPDATE_AS_PATH_SET).
+     */
+    u_int8_t type;
+
+    /**
+     * @brief Number of ASNs in the segment.
+     */
+    u_int8_t len;
+} AsPathSeg_t;
+
+
+/**
+ * @brief Structure containing a large community (RFC 8092).
+ */
+typedef struct
+{
+    u_int32_t global;
+    u_int32_t local1;
+    u_int32_t local2;
+} LargeCommunity_t;
+
+
 struct FileBuffer;
+struct MRTattrCache;
 
 /**
  * @brief Structure representing a MRT entry (only for BGP-related records.). Most
@@ -78,9 +116,16 @@ typedef struct mrt_entry_t
     u_int16_t afi;
 
     /**
-     * @brief IP addess of the BGP peer. The address is stored in string mode.
+     * @brief Position of the BGP peer in the peer table of the file (see File_buf_t.index)
+     * for a RIB entry, MRT_PEER_NO_INDEX for a BGP4MP message.
+     */
+    u_int16_t peerIndex;
+
+    /**
+     * @brief IP addess of the BGP peer, in binary form (the last 12 bytes are zero for an IPv4
+     * address). See Addr_to_str for its string form.
      */
-    char peerAddr[64];
+    u_int8_t peerAddr[16];
 
     /**
      * @brief UNIX timestamp at which the BGP message as been received. Represents
@@ -105,18 +150,30 @@ typedef struct mrt_entry_t
      */
     u_int16_t nbNLRI;
 
+    /**
+     * @brief Number of prefixes that can be stored in pfxWithdraw before it needs
+     * to grow.
+     */
+    u_int16_t sizeWithdraw;
+
+    /**
+     * @brief Number of prefixes that can be stored in pfxNLRI before it needs
+     * to grow.
+     */
+    u_int16_t sizeNLRI;
+
 
     /**
      * @brief List of prefixes that are announced in this BGP message. Each prefix 
-     * is stored in string representation.
+     * is stored in binary representation, use Prefix_to_str to get its string.
      */
-    char pfxNLRI[MAX_NB_PREFIXES][64];
+    Prefix_t* pfxNLRI;
 
     /**
      * @brief List of prefixes that are withdrawn in this BGP message. Each prefix 
-     * is stored in string representation.
+     * is stored in binary representation, use Prefix_to_str to get its string.
      */
-    char pfxWithdraw[MAX_NB_PREFIXES][64];
+    Prefix_t* pfxWithdraw;
 
 
     /**
@@ -125,16 +182,84 @@ typedef struct mrt_entry_t
     char nextHop[64];
 
     /**
-     * @brief AS path attribute value announced in this BGP message. The AS path is
-     * stored in string mode.
+     * @brief Segments of the AS path attribute announced in this BGP message.
+     */
+    AsPathSeg_t* asPathSegs;
+
+    /**
+     * @brief ASNs of the AS path, segment after segment.
+     */
+    u_int32_t* asPathAsn;
+
+    /**
+     * @brief Number of segments and of ASNs of the AS path, and number of them that can
+     * be stored before the arrays need to grow.
+     */
+    u_int16_t nbAsPathSegs;
+    u_int16_t nbAsPathAsn;
+    u_int16_t sizeAsPathSegs;
+    u_int16_t sizeAsPathAsn;
+
+    /**
+     * @brief String representation of the AS path. Only written by MRTentry_as_path_str,
+     * use this function rather than reading the field.
+     */
+    char* asPath;
+
+    /**
+     * @brief Number of bytes allocated for the asPath string.
+     */
+    u_int32_t asPathSize;
+
+    /**
+     * @brief Set once asPath holds the string representation of the current AS path.
+     */
+    u_int8_t asPathFormatted;
+
+    /**
+     * @brief Communities announced in this BGP message, each stored as a single 32-bit
+     * value (ASN << 16 | value).
+     */
+    u_int32_t* stdCommunities;
+
+    /**
+     * @brief Large communities (RFC 8092) announced in this BGP message.
+     */
+    LargeCommunity_t* largeCommunities;
+
+    /**
+     * @brief Extended communities (RFC 4360) announced in this BGP message, each stored as
+     * the 64-bit value of its 8 bytes (type in the most significant byte).
      */
-    char asPath[MAX_ATTR];
+    u_int64_t* extCommunities;
 
     /**
-     * @brief Community attribute values announced in this BGP message. The community
-     * values are stored in string mode.
+     * @brief Number of communities of each kind, and number of them that can be stored
+     * before the arrays need to grow.
      */
-    char communities[MAX_ATTR];
+    u_int16_t nbStdCommunities;
+    u_int16_t nbLargeCommunities;
+    u_int16_t nbExtCommunities;
+    u_int16_t sizeStdCommunities;
+    u_int16_t sizeLargeCommunities;
+    u_int16_t sizeExtCommunities;
+
+    /**
+     * @brief String representation of the (standard) communities. Only written by
+     * MRTentry_communities_str, use this function rather than reading the field.
+     */
+    char* communities;
+
+    /**
+     * @brief Number of bytes allocated for the communities string.
+     */
+    u_int32_t communitiesSize;
+
+    /**
+     * @brief Set once communities holds the string representation of the current
+     * communities.
+     */
+    u_int8_t communitiesFormatted;
 
     /**
      * @brief Origin attribute value announced in this BGP message. The origin is stored
@@ -142,12 +267,31 @@ typedef struct mrt_entry_t
      */
     char origin[16];
 
+    /**
+     * @brief Entry whose attributes (origin, next-hop, AS path and communities, along with their
+     * strings) are shared by this one, NULL if the entry holds its own attributes. The shared
+     * attributes are read-only (see MRTentry_share_attributes).
+     */
+    const struct mrt_entry_t* attrs;
+
 
     /**
      * @brief Related File buffer structure.
      */
     struct FileBuffer* dumper;
 
+    /**
+     * @brief Cache in which the attributes of the RIB entries are interned (see
+     * MRTattrCache_get), NULL if they are decoded in each entry.
+     */
+    struct MRTattrCache* attrCache;
+
+    /**
+     * @brief Arena from which the entry and its content are allocated. NULL if the entry
+     * is allocated on the heap.
+     */
+    Arena_t* arena;
+
     struct mrt_entry_t *next;
     struct mrt_entry_t *prev;
 
@@ -163,10 +307,22 @@ typedef struct mrt_entry_t
 MRTentry* MRTentry_new(void);
 
 
+/**
+ * @brief Same as MRTentry_new, but the entry and everything it contains (prefix lists,
+ * attribute strings, copies made for RIB entries) are allocated from an arena. Such an
+ * entry is released when the arena is reset, freeing it has no effect.
+ * 
+ * @param arena     Pointer to the arena from which the entry is allocated.
+ * 
+ * @return MRTentry*    Returns the pointer to the allocated new MRT entry structure.
+ */
+MRTentry* MRTentry_new_from_arena(Arena_t* arena);
+
+
 /**
  * @brief Function that copy an MRT entry. Takes an input MRT entry, creates a new pointer
  * to an allocated empty MRT structure, and copy the content of the input one to the newly
- * created one.
+ * created one. The copy is allocated from the same arena as the input entry (if any).
  * 
  * @param entry     Pointer to the MRT entry structure that we want to copy.
  * 
@@ -176,9 +332,239 @@ MRTentry* MRTentry_new(void);
 MRTentry* MRTentry_copy_for_ribs(MRTentry* entry);
 
 
+/**
+ * @brief Function that empties an MRT entry so that it can be reused for another MRT
+ * record. The prefix lists and attribute strings keep their allocated memory, so that
+ * reusing an entry does not require any new allocation.
+ * 
+ * @param entry     Pointer to the MRT entry structure that we want to reset.
+ */
+void MRTentry_reset(MRTentry* entry);
+
+
+/**
+ * @brief Function that empties the BGP attributes (origin, next-hop, AS path and communities)
+ * of an MRT entry, keeping its MRT header, peer and prefixes. Used to parse the attributes of
+ * another RIB entry of the same prefix into the same MRT entry.
+ * 
+ * @param entry     Pointer to the MRT entry structure whose attributes are emptied.
+ */
+void MRTentry_clear_attributes(MRTentry* entry);
+
+
+/**
+ * @brief Function that makes an MRT entry share the BGP attributes of another one instead of
+ * holding its own: the attribute lists and strings of the entry point to the ones of attrs,
+ * which must outlive the entry and must not be modified anymore. The attributes of the entry
+ * are dropped (not freed), so the entry must be allocated from an arena. Emptying the
+ * attributes of the entry (or resetting it) stops the sharing.
+ * 
+ * @param entry     Pointer to the MRT entry structure that shares the attributes.
+ * @param attrs     Pointer to the MRT entry structure holding the attributes, whose AS path
+ * and communities strings must already be built.
+ */
+void MRTentry_share_attributes(MRTentry* entry, const MRTentry* attrs);
+
+
+/**
+ * @brief Function that returns the slot in which the next announced prefix of the entry
+ * must be written. The pfxNLRI list is grown if it is full. The caller is in charge of
+ * incrementing nbNLRI once the slot is filled.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * 
+ * @return Prefix_t*    Returns a pointer to the free slot, or NULL if no memory can be
+ * allocated.
+ */
+Prefix_t* MRTentry_next_nlri(MRTentry* entry);
+
+
+/**
+ * @brief Same as MRTentry_next_nlri, but for the list of withdrawn prefixes.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * 
+ * @return Prefix_t*    Returns a pointer to the free slot, or NULL if no memory can be
+ * allocated.
+ */
+Prefix_t* MRTentry_next_withdraw(MRTentry* entry);
+
+
+/**
+ * @brief Function that returns the string representation of the standard communities of an
+ * MRT entry (e.g., "65000:1 65000:666"). Large and extended communities are not part of it.
+ * The string is only built on the first call, and kept in the entry.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * 
+ * @return const char*  Returns the communities string (empty if the entry has no community),
+ * or NULL if no memory can be allocated.
+ */
+const char* MRTentry_communities_str(MRTentry* entry);
+
+
+/**
+ * @brief Function that tells whether an MRT entry has a standard community matching a value
+ * on the bits of a mask, i.e., such that (community & mask) == value. For instance, value
+ * 666 and mask 0xffff match any community whose value part is 666.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * @param value     Value of the masked community (ASN << 16 | value).
+ * @param mask      Mask applied to each community (0xffffffff for an exact match).
+ * 
+ * @return int      Returns 1 if a community matches, 0 otherwise.
+ */
+int MRTentry_has_community(MRTentry* entry, u_int32_t value, u_int32_t mask);
+
+
+/**
+ * @brief Same as MRTentry_has_community, but for the large communities. Each of the three
+ * parts of the community is matched against its own value and mask.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * @param value     Value of the masked large community.
+ * @param mask      Mask applied to each large community.
+ * 
+ * @return int      Returns 1 if a large community matches, 0 otherwise.
+ */
+int MRTentry_has_large_community(MRTentry* entry, LargeCommunity_t value, LargeCommunity_t mask);
+
+
+/**
+ * @brief Same as MRTentry_has_community, but for the extended communities.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * @param value     Value of the masked extended community.
+ * @param mask      Mask applied to each extended community.
+ * 
+ * @return int      Returns 1 if an extended community matches, 0 otherwise.
+ */
+int MRTentry_has_ext_community(MRTentry* entry, u_int64_t value, u_int64_t mask);
+
+
+/**
+ * @brief Function that makes sure that a string of an MRT entry (asPath or communities)
+ * can hold at least the given number of bytes. The string is grown (and its content
+ * kept) if needed.
+ * 
+ * @param entry     Pointer to the MRT entry structure owning the string.
+ * @param str       Pointer to the string that must be grown.
+ * @param size      Pointer to the number of bytes currently allocated for the string.
+ * @param needed    Number of bytes that the string must be able to hold.
+ * 
+ * @return int      Returns 0 if no memory can be allocated, 1 otherwise.
+ */
+int MRTentry_reserve_str(MRTentry* entry, char** str, u_int32_t* size, u_int32_t needed);
+
+
+/**
+ * @brief Function that appends a segment to the AS path of an MRT entry. The arrays of the
+ * AS path are grown if needed.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * @param type      Type of the segment (BGP_UPDATE_AS_PATH_SEQ or BGP_UPDATE_AS_PATH_SET).
+ * @param len       Number of ASNs of the segment.
+ * 
+ * @return u_int32_t*   Returns a pointer to the len slots in which the ASNs of the segment
+ * must be written, or NULL if no memory can be allocated.
+ */
+u_int32_t* MRTentry_add_as_path_segment(MRTentry* entry, u_int8_t type, u_int8_t len);
+
+
+/**
+ * @brief Function that makes sure that a list of an MRT entry (AS path or communities) can
+ * hold at least the given number of elements. The list is grown (and its content kept) if
+ * needed.
+ * 
+ * @param entry     Pointer to the MRT entry structure owning the list.
+ * @param list      Pointer to the list that must be grown.
+ * @param size      Pointer to the number of elements currently allocated for the list.
+ * @param needed    Number of elements that the list must be able to hold (at most 65535).
+ * @param elemSize  Size of an element of the list.
+ * 
+ * @return int      Returns 0 if no memory can be allocated, 1 otherwise.
+ */
+int MRTentry_reserve_list(MRTentry* entry, void** list, u_int16_t* size, u_int32_t needed, size_t elemSize);
+
+
+/**
+ * @brief Function that returns the string representation of the AS path of an MRT entry
+ * (e.g., "1 2 {3,4}"). The string is only built on the first call, and kept in the entry.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * 
+ * @return const char*  Returns the AS path string (empty if the entry has no AS path), or
+ * NULL if no memory can be allocated.
+ */
+const char* MRTentry_as_path_str(MRTentry* entry);
+
+
+/**
+ * @brief Function that returns the origin ASN of an MRT entry, i.e., the last ASN of its AS
+ * path. If the path ends with an AS set, the origin is only known if the set has a single
+ * ASN.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * 
+ * @return u_int32_t    Returns the origin ASN, 0 if there is no AS path or if the origin is
+ * not known.
+ */
+u_int32_t MRTentry_origin_asn(MRTentry* entry);
+
+
+/**
+ * @brief Function that returns the length of the AS path of an MRT entry, as used by the
+ * BGP decision process: each ASN of a sequence counts for one, each AS set counts for one.
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * 
+ * @return int      Returns the length of the AS path (0 if there is no AS path).
+ */
+int MRTentry_as_path_len(MRTentry* entry);
+
+
+/**
+ * @brief Function that tells whether an ASN appears in the AS path of an MRT entry (in a
+ * sequence or in a set).
+ * 
+ * @param entry     Pointer to the MRT entry structure.
+ * @param asn       ASN to look for.
+ * 
+ * @return int      Returns 1 if the ASN is in the AS path, 0 otherwise.
+ */
+int MRTentry_as_path_contains(MRTentry* entry, u_int32_t asn);
+
+
+/**
+ * @brief Function that writes the string representation of an IP address. The output is the
+ * same as the one of inet_ntop.
+ * 
+ * @param afi       Address family of the address (BGP_IPV4_AFI or BGP_IPV6_AFI).
+ * @param addr      Bytes of the address (4 for IPv4, 16 for IPv6).
+ * @param string    String in which the address is written, at least ADDR_STR_LEN bytes long.
+ * 
+ * @return int      Returns the length of the output string.
+ */
+int Addr_to_str(u_int8_t afi, const u_int8_t* addr, char* string);
+
+
+/**
+ * @brief Function that writes the string representation of a prefix (e.g., "10.0.0.0/8").
+ * 
+ * @param pfx       Pointer to the prefix that must be written.
+ * @param string    String in which the prefix value will be written.
+ * @param len       Maximum number of bytes that can be written in the string.
+ * 
+ * @return int      Returns -1 if the prefix cannot be written, the length of the output
+ * string otherwise.
+ */
+int Prefix_to_str(const Prefix_t* pfx, char* string, int len);
+
+
 /**
  * @brief Function that frees the current MRT entry. Does not touch anything to the MRT entry
- * structures that are linked to the current one.
+ * structures that are linked to the current one. Has no effect on entries allocated from an
+ * arena.
  * 
  * @param entry     Pointer to the MRT entry structure that we want to free.
  */
@@ -195,6 +581,32 @@ void MRTentry_free_one(MRTentry* entry);
 void MRTentry_free(MRTentry* entry);
 
 
+/**
+ * @brief Function that returns the size of a buffer large enough to hold the line of an MRT
+ * entry (see MRTentry_to_str), given its prefixes, AS path and communities.
+ *
+ * @param entry     Pointer to the MRT entry that we want to print.
+ *
+ * @return int      Returns an upper bound of the length of the line, terminator included.
+ */
+int MRTentry_str_len(MRTentry* entry);
+
+
+/**
+ * @brief Function that writes the line printed for the corresponding full MRT entry (see
+ * MRTentry_print) in a buffer, so that it can be written to any output.
+ *
+ * @param entry     Pointer to the MRT entry that we want to print.
+ * @param buffer    Buffer in which the line (ending with a newline) is written, always
+ * terminated. A buffer of MRTentry_str_len bytes holds the whole line.
+ * @param len       Size of the buffer.
+ *
+ * @return int      Returns the length of the line. A line that does not fit is truncated (without
+ * its newline) at the last field, or prefix, that fits.
+ */
+int MRTentry_to_str(MRTentry* entry, char* buffer, int len);
+
+
 /**
  * @brief Function that print (on standard output) the corresponding full MRT entry.
  * 
@@ -0,0 +1,377 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mrt_filter.h"
+#include "bgp_macros.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+
+/* Appends an element to one of the arrays of the filter. The arrays only hold a few values, they
+ * grow one element at a time */
+static int add_value(void** list, int* nb, const void* value, size_t elemSize)
+{
+    void* tmp;
+
+    if ((tmp = realloc(*list, (*nb + 1) * elemSize)) == NULL)
+    {
+        return 0;
+    }
+
+    memcpy((char*)tmp + *nb * elemSize, value, elemSize);
+    *list = tmp;
+    (*nb)++;
+
+    return 1;
+}
+
+
+static int has_asn(const u_int32_t* asns, int nb, u_int32_t asn)
+{
+    for (int i = 0 ; i < nb ; i++)
+    {
+        if (asns[i] == asn)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Parses an IPv4 or IPv6 address, returns its address family, 0 if the address is invalid */
+static int parse_addr(const char* str, u_int8_t* addr)
+{
+    if (inet_pton(AF_INET, str, addr) == 1)
+    {
+        return BGP_IPV4_AFI;
+    }
+
+    if (inet_pton(AF_INET6, str, addr) == 1)
+    {
+        return BGP_IPV6_AFI;
+    }
+
+    return 0;
+}
+
+
+/* Tells whether pfx is equal to, or more specific than, cover */
+static int prefix_covered(const Prefix_t* pfx, const Prefix_t* cover)
+{
+    int nbBytes = cover->pfxLen / 8;
+    int nbBits = cover->pfxLen % 8;
+
+    if (pfx->afi != cover->afi || pfx->pfxLen < cover->pfxLen)
+    {
+        return 0;
+    }
+
+    if (memcmp(pfx->pfx, cover->pfx, nbBytes) != 0)
+    {
+        return 0;
+    }
+
+    return nbBits == 0 || ((pfx->pfx[nbBytes] ^ cover->pfx[nbBytes]) & (0xff << (8 - nbBits))) == 0;
+}
+
+
+MRTfilter_t* MRTfilter_new(void)
+{
+    MRTfilter_t* filter = calloc(1, sizeof(MRTfilter_t));
+
+    if (filter)
+    {
+        filter->untilTime = 0xffffffff;
+    }
+
+    return filter;
+}
+
+
+void MRTfilter_set_time(MRTfilter_t* filter, u_int32_t fromTime, u_int32_t untilTime)
+{
+    filter->fromTime  = fromTime;
+    filter->untilTime = untilTime;
+}
+
+
+void MRTfilter_set_monotonic(MRTfilter_t* filter, int monotonic)
+{
+    filter->monotonic = monotonic;
+}
+
+
+int MRTfilter_set_types(MRTfilter_t* filter, const char* types)
+{
+    u_int32_t mask = 0;
+
+    for ( ; *types ; types++)
+    {
+        switch (*types)
+        {
+            case 'U':
+                mask |= MRT_FILTER_UPDATE;
+                break;
+            case 'R':
+                mask |= MRT_FILTER_RIB;
+                break;
+            case 'O':
+                mask |= MRT_FILTER_OPEN;
+                break;
+            case 'N':
+                mask |= MRT_FILTER_NOTIFICATION;
+                break;
+            case 'K':
+                mask |= MRT_FILTER_KEEPALIVE;
+                break;
+            case 'S':
+                mask |= MRT_FILTER_STATE_CHANGE;
+                break;
+            default:
+                return 0;
+        }
+    }
+
+    filter->types = mask;
+
+    return 1;
+}
+
+
+int MRTfilter_add_peer_asn(MRTfilter_t* filter, u_int32_t asn)
+{
+    return add_value((void**)&filter->peerAsns, &filter->nbPeerAsns, &asn, sizeof(u_int32_t));
+}
+
+
+int MRTfilter_add_origin_asn(MRTfilter_t* filter, u_int32_t asn)
+{
+    return add_value((void**)&filter->originAsns, &filter->nbOriginAsns, &asn, sizeof(u_int32_t));
+}
+
+
+int MRTfilter_add_path_asn(MRTfilter_t* filter, u_int32_t asn)
+{
+    return add_value((void**)&filter->pathAsns, &filter->nbPathAsns, &asn, sizeof(u_int32_t));
+}
+
+
+int MRTfilter_add_peer_addr(MRTfilter_t* filter, const char* addr)
+{
+    Prefix_t peer;
+
+    /* Stored in the same form as the peer addresses of the entries, so that they can be compared
+     * as binary values */
+    memset(&peer, 0, sizeof(Prefix_t));
+    if ((peer.afi = parse_addr(addr, peer.pfx)) == 0)
+    {
+        return 0;
+    }
+    peer.pfxLen = peer.afi == BGP_IPV6_AFI ? 128 : 32;
+
+    return add_value((void**)&filter->peerAddrs, &filter->nbPeerAddrs, &peer, sizeof(Prefix_t));
+}
+
+
+int MRTfilter_add_prefix(MRTfilter_t* filter, const char* prefix)
+{
+    char addr[ADDR_STR_LEN];
+    const char* slash = strchr(prefix, '/');
+    Prefix_t pfx;
+    char* end;
+    long len;
+
+    if (!slash || slash - prefix >= ADDR_STR_LEN)
+    {
+        return 0;
+    }
+
+    memcpy(addr, prefix, slash - prefix);
+    addr[slash - prefix] = 0;
+
+    memset(&pfx, 0, sizeof(Prefix_t));
+    if ((pfx.afi = parse_addr(addr, pfx.pfx)) == 0)
+    {
+        return 0;
+    }
+
+    len = strtol(slash + 1, &end, 10);
+    if (*end || end == slash + 1 || len < 0 || len > (pfx.afi == BGP_IPV6_AFI ? 128 : 32))
+    {
+        return 0;
+    }
+    pfx.pfxLen = len;
+
+    return add_value((void**)&filter->prefixes, &filter->nbPrefixes, &pfx, sizeof(Prefix_t));
+}
+
+
+int MRTfilter_match_header(const MRTfilter_t* filter, const MRTentry* hdr)
+{
+    if (hdr->entryType == MRT_TYPE_TABLE_DUMP_V2 && hdr->entrySubType == BGP_SUBTYPE_PEER_INDEX_TABLE)
+    {
+        return 1;
+    }
+
+    if (hdr->time < filter->fromTime || hdr->time > filter->untilTime)
+    {
+        return 0;
+    }
+
+    if (filter->types == 0)
+    {
+        return 1;
+    }
+
+    switch (hdr->entryType)
+    {
+        case MRT_TYPE_TABLE_DUMP_V2:
+            return (filter->types & MRT_FILTER_RIB) != 0;
+
+        case MRT_TYPE_BGP4MP:
+        case MRT_TYPE_BGP4MP_ET:
+            if (hdr->entrySubType == MRT_SUBTYPE_BGP4MP_STATE_CHANGE ||
+                hdr->entrySubType == MRT_SUBTYPE_BGP4MP_STATE_CHANGE_AS4)
+            {
+                return (filter->types & MRT_FILTER_STATE_CHANGE) != 0;
+            }
+
+            return (filter->types & (MRT_FILTER_UPDATE | MRT_FILTER_OPEN | MRT_FILTER_NOTIFICATION | MRT_FILTER_KEEPALIVE)) != 0;
+
+        default:
+            return 0;
+    }
+}
+
+
+int MRTfilter_past_end(const MRTfilter_t* filter, const MRTentry* hdr)
+{
+    return filter->monotonic && hdr->time > filter->untilTime;
+}
+
+
+int MRTfilter_match_bgp_type(const MRTfilter_t* filter, const MRTentry* entry)
+{
+    if (filter->types == 0)
+    {
+        return 1;
+    }
+
+    switch (entry->bgpType)
+    {
+        case BGP_TYPE_UPDATE:
+            return (filter->types & MRT_FILTER_UPDATE) != 0;
+        case BGP_TYPE_OPEN:
+            return (filter->types & MRT_FILTER_OPEN) != 0;
+        case BGP_TYPE_NOTIFICATION:
+            return (filter->types & MRT_FILTER_NOTIFICATION) != 0;
+        case BGP_TYPE_KEEPALIVE:
+            return (filter->types & MRT_FILTER_KEEPALIVE) != 0;
+        case BGP_TYPE_STATE_CHANGE:
+            return (filter->types & MRT_FILTER_STATE_CHANGE) != 0;
+        default:
+            return 0;
+    }
+}
+
+
+int MRTfilter_match_peer(const MRTfilter_t* filter, const MRTentry* entry)
+{
+    return MRTfilter_match_peer_addr(filter, entry->peer_asn, entry->afi, entry->peerAddr);
+}
+
+
+int MRTfilter_match_peer_addr(const MRTfilter_t* filter, u_int32_t asn, u_int8_t afi, const u_int8_t* addr)
+{
+    int found = filter->nbPeerAddrs == 0;
+
+    if (filter->nbPeerAsns && !has_asn(filter->peerAsns, filter->nbPeerAsns, asn))
+    {
+        return 0;
+    }
+
+    for (int i = 0 ; i < filter->nbPeerAddrs && !found ; i++)
+    {
+        found = filter->peerAddrs[i].afi == afi && memcmp(filter->peerAddrs[i].pfx, addr, 16) == 0;
+    }
+
+    return found;
+}
+
+
+int MRTfilter_match_prefixes(const MRTfilter_t* filter, const MRTentry* entry)
+{
+    if (filter->nbPrefixes == 0)
+    {
+        return 1;
+    }
+
+    for (int i = 0 ; i < filter->nbPrefixes ; i++)
+    {
+        for (int j = 0 ; j < entry->nbNLRI ; j++)
+        {
+            if (prefix_covered(&entry->pfxNLRI[j], &filter->prefixes[i]))
+            {
+                return 1;
+            }
+        }
+
+        for (int j = 0 ; j < entry->nbWithdraw ; j++)
+        {
+            if (prefix_covered(&entry->pfxWithdraw[j], &filter->prefixes[i]))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+int MRTfilter_match_attributes(const MRTfilter_t* filter, MRTentry* entry)
+{
+    int found = filter->nbPathAsns == 0;
+
+    if (filter->nbOriginAsns && !has_asn(filter->originAsns, filter->nbOriginAsns, MRTentry_origin_asn(entry)))
+    {
+        return 0;
+    }
+
+    for (int i = 0 ; i < filter->nbPathAsns && !found ; i++)
+    {
+        found = MRTentry_as_path_contains(entry, filter->pathAsns[i]);
+    }
+
+    return found;
+}
+
+
+int MRTfilter_match(const MRTfilter_t* filter, MRTentry* entry)
+{
+    return MRTfilter_match_bgp_type(filter, entry) && MRTfilter_match_peer(filter, entry) &&
+           MRTfilter_match_prefixes(filter, entry) && MRTfilter_match_attributes(filter, entry);
+}
+
+
+void MRTfilter_free(MRTfilter_t* filter)
+{
+    if (!filter)
+    {
+        return;
+    }
+
+    free(filter->peerAsns);
+    free(filter->peerAddrs);
+    free(filter->prefixes);
+    free(filter->originAsns);
+    free(filter->pathAsns);
+    free(filter);
+}
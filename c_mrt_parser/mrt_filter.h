@@ -0,0 +1,269 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __MRT_FILTER_H__
+#define __MRT_FILTER_H__
+
+#include "mrt_entry.h"
+
+/* Message types that can be selected, one bit per BGPmessage.msgType letter */
+#define MRT_FILTER_UPDATE           0x01    /* 'U' */
+#define MRT_FILTER_RIB              0x02    /* 'R' */
+#define MRT_FILTER_OPEN             0x04    /* 'O' */
+#define MRT_FILTER_NOTIFICATION     0x08    /* 'N' */
+#define MRT_FILTER_KEEPALIVE        0x10    /* 'K' */
+#define MRT_FILTER_STATE_CHANGE     0x20    /* 'S' */
+
+/* Value returned by the record parsing functions when the record does not match the filter */
+#define MRT_RECORD_FILTERED         2
+
+
+/**
+ * @brief Structure representing a filter on the BGP messages of an MRT file. A message is kept
+ * only if it matches every criterion that is set (an empty set of values does not filter
+ * anything). Within a criterion, matching any of the values is enough.
+ *
+ * The criteria are checked as soon as the parser knows the corresponding fields: time and
+ * MRT type on the MRT header (before the record is even decoded), peer and BGP message type
+ * before the BGP attributes are parsed, and the prefixes, origin and AS path once the message
+ * is decoded (in binary form, without building any string).
+ */
+typedef struct
+{
+    /**
+     * @brief Only the messages whose timestamp is in [fromTime, untilTime] are kept.
+     */
+    u_int32_t   fromTime;
+    u_int32_t   untilTime;
+
+    /**
+     * @brief Set if the records of the file are ordered by time (e.g., update files), so that
+     * the reading stops at the first record after untilTime.
+     */
+    int         monotonic;
+
+    /**
+     * @brief Bitmask of the kept message types (MRT_FILTER_*), 0 to keep all of them.
+     */
+    u_int32_t   types;
+
+    /**
+     * @brief AS numbers of the kept BGP peers.
+     */
+    u_int32_t*  peerAsns;
+    int         nbPeerAsns;
+
+    /**
+     * @brief IP addresses of the kept BGP peers, as full-length prefixes (in the binary form of
+     * MRTentry.peerAddr).
+     */
+    Prefix_t*   peerAddrs;
+    int         nbPeerAddrs;
+
+    /**
+     * @brief A message is kept if one of its prefixes (announced or withdrawn) is equal to, or
+     * more specific than, one of these prefixes.
+     */
+    Prefix_t*   prefixes;
+    int         nbPrefixes;
+
+    /**
+     * @brief A message is kept if its origin ASN (see MRTentry_origin_asn) is one of these.
+     */
+    u_int32_t*  originAsns;
+    int         nbOriginAsns;
+
+    /**
+     * @brief A message is kept if one of these ASNs appears in its AS path.
+     */
+    u_int32_t*  pathAsns;
+    int         nbPathAsns;
+} MRTfilter_t;
+
+
+/**
+ * @brief Creates a filter that keeps every message.
+ *
+ * @return MRTfilter_t*     Returns a pointer to the allocated filter, NULL if no memory can be
+ * allocated.
+ */
+MRTfilter_t* MRTfilter_new(void);
+
+
+/**
+ * @brief Sets the time range of the kept messages.
+ *
+ * @param filter    Pointer to the filter.
+ * @param fromTime  Minimum timestamp of the kept messages.
+ * @param untilTime Maximum timestamp of the kept messages.
+ */
+void MRTfilter_set_time(MRTfilter_t* filter, u_int32_t fromTime, u_int32_t untilTime);
+
+
+/**
+ * @brief Sets the monotonic mode of the filter, in which the records of the file are assumed
+ * to be ordered by time: the reading then stops at the first record after the time range,
+ * instead of skipping all the records up to the end of the file.
+ *
+ * @param filter    Pointer to the filter.
+ * @param monotonic 1 to enable the monotonic mode, 0 to disable it.
+ */
+void MRTfilter_set_monotonic(MRTfilter_t* filter, int monotonic);
+
+
+/**
+ * @brief Sets the types of the kept messages, from the letters used by BGPmessage.msgType
+ * (e.g., "U" for the updates only, "UR" for the updates and the RIB entries).
+ *
+ * @param filter    Pointer to the filter.
+ * @param types     String of message type letters ('U', 'R', 'O', 'N', 'K', 'S').
+ *
+ * @return int      Returns 0 if a letter is unknown (the filter is then left untouched), 1
+ * otherwise.
+ */
+int MRTfilter_set_types(MRTfilter_t* filter, const char* types);
+
+
+/**
+ * @brief Functions adding a value to one of the criteria of the filter.
+ *
+ * @param filter    Pointer to the filter.
+ * @param asn       AS number to add.
+ *
+ * @return int      Returns 0 if no memory can be allocated, 1 otherwise.
+ */
+int MRTfilter_add_peer_asn(MRTfilter_t* filter, u_int32_t asn);
+int MRTfilter_add_origin_asn(MRTfilter_t* filter, u_int32_t asn);
+int MRTfilter_add_path_asn(MRTfilter_t* filter, u_int32_t asn);
+
+
+/**
+ * @brief Adds the IP address of a BGP peer to the filter.
+ *
+ * @param filter    Pointer to the filter.
+ * @param addr      IPv4 or IPv6 address, in string mode.
+ *
+ * @return int      Returns 0 if the address is invalid or if no memory can be allocated, 1
+ * otherwise.
+ */
+int MRTfilter_add_peer_addr(MRTfilter_t* filter, const char* addr);
+
+
+/**
+ * @brief Adds a prefix to the filter.
+ *
+ * @param filter    Pointer to the filter.
+ * @param prefix    IPv4 or IPv6 prefix, in string mode (e.g., "10.0.0.0/8").
+ *
+ * @return int      Returns 0 if the prefix is invalid or if no memory can be allocated, 1
+ * otherwise.
+ */
+int MRTfilter_add_prefix(MRTfilter_t* filter, const char* prefix);
+
+
+/**
+ * @brief Checks the fields of the MRT header (time, type and subtype) of a record. Records
+ * holding a TABLE_DUMP_V2 peer index always match, as they are needed to decode the RIB
+ * entries.
+ *
+ * @param filter    Pointer to the filter.
+ * @param hdr       MRT entry in which the MRT header has been parsed.
+ *
+ * @return int      Returns 1 if the record may hold a kept message, 0 otherwise.
+ */
+int MRTfilter_match_header(const MRTfilter_t* filter, const MRTentry* hdr);
+
+
+/**
+ * @brief Tells whether no record can match the filter anymore, i.e., whether the filter is in
+ * monotonic mode and the MRT header of a record is after the time range.
+ *
+ * @param filter    Pointer to the filter.
+ * @param hdr       MRT entry in which the MRT header has been parsed.
+ *
+ * @return int      Returns 1 if the reading can stop, 0 otherwise.
+ */
+int MRTfilter_past_end(const MRTfilter_t* filter, const MRTentry* hdr);
+
+
+/**
+ * @brief Checks the BGP message type of an entry, once it is known.
+ *
+ * @param filter    Pointer to the filter.
+ * @param entry     MRT entry.
+ *
+ * @return int      Returns 1 if the entry matches, 0 otherwise.
+ */
+int MRTfilter_match_bgp_type(const MRTfilter_t* filter, const MRTentry* entry);
+
+
+/**
+ * @brief Checks the BGP peer (ASN and address) of an entry.
+ *
+ * @param filter    Pointer to the filter.
+ * @param entry     MRT entry.
+ *
+ * @return int      Returns 1 if the entry matches, 0 otherwise.
+ */
+int MRTfilter_match_peer(const MRTfilter_t* filter, const MRTentry* entry);
+
+
+/**
+ * @brief Checks a BGP peer given by its ASN and binary address (in the form of MRTentry.peerAddr),
+ * e.g. once per peer of a RIB peer index.
+ *
+ * @param filter    Pointer to the filter.
+ * @param asn       AS number of the peer.
+ * @param afi       Address family of the peer (BGP_IPV4_AFI or BGP_IPV6_AFI).
+ * @param addr      Binary IP address of the peer (16 bytes).
+ *
+ * @return int      Returns 1 if the peer matches, 0 otherwise.
+ */
+int MRTfilter_match_peer_addr(const MRTfilter_t* filter, u_int32_t asn, u_int8_t afi, const u_int8_t* addr);
+
+
+/**
+ * @brief Checks the prefixes of an entry.
+ *
+ * @param filter    Pointer to the filter.
+ * @param entry     MRT entry.
+ *
+ * @return int      Returns 1 if the entry matches, 0 otherwise.
+ */
+int MRTfilter_match_prefixes(const MRTfilter_t* filter, const MRTentry* entry);
+
+
+/**
+ * @brief Checks the attributes (origin ASN and AS path) of an entry.
+ *
+ * @param filter    Pointer to the filter.
+ * @param entry     MRT entry.
+ *
+ * @return int      Returns 1 if the entry matches, 0 otherwise.
+ */
+int MRTfilter_match_attributes(const MRTfilter_t* filter, MRTentry* entry);
+
+
+/**
+ * @brief Checks all the criteria of the filter on a decoded entry (except the MRT header ones,
+ * see MRTfilter_match_header).
+ *
+ * @param filter    Pointer to the filter.
+ * @param entry     MRT entry.
+ *
+ * @return int      Returns 1 if the entry matches, 0 otherwise.
+ */
+int MRTfilter_match(const MRTfilter_t* filter, MRTentry* entry);
+
+
+/**
+ * @brief Frees the filter.
+ *
+ * @param filter    Pointer to the filter.
+ */
+void MRTfilter_free(MRTfilter_t* filter);
+
+#endif
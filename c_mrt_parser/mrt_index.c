@@ -0,0 +1,381 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mrt_index.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Layout of the index file (all the integers are big-endian):
+ *   magic (8 bytes), file size (8), file mtime (8), number of points (4), peer index flag (4),
+ *   peer index point, then the points.
+ * A point is made of maxTime (4), block (8), blockOffset (8) and offset (8). */
+static const u_char indexMagic[8] = { 'G', 'S', 'I', 'D', 'X', 0, 0, 1 };
+
+#define INDEX_HEADER_LEN    32
+#define INDEX_POINT_LEN     28
+
+
+static void put_int(u_char* buf, u_int32_t val)
+{
+    buf[0] = val >> 24;
+    buf[1] = val >> 16;
+    buf[2] = val >> 8;
+    buf[3] = val;
+}
+
+
+static void put_long(u_char* buf, u_int64_t val)
+{
+    put_int(buf, val >> 32);
+    put_int(buf + 4, val);
+}
+
+
+static u_int64_t get_long(u_char* buf)
+{
+    return ((u_int64_t)get_buf_int(buf) << 32) | get_buf_int(buf + 4);
+}
+
+
+static void put_point(u_char* buf, const MRTindexPoint_t* point)
+{
+    put_int(buf, point->maxTime);
+    put_long(buf + 4, point->block);
+    put_long(buf + 12, point->blockOffset);
+    put_long(buf + 20, point->offset);
+}
+
+
+static void get_point(u_char* buf, MRTindexPoint_t* point)
+{
+    point->maxTime     = get_buf_int(buf);
+    point->block       = get_long(buf + 4);
+    point->blockOffset = get_long(buf + 12);
+    point->offset      = get_long(buf + 20);
+}
+
+
+/* Name of the index file, returns 0 if it does not fit in name */
+static int index_name(const char* filename, const char* indexName, char* name)
+{
+    if (indexName)
+    {
+        return snprintf(name, BGPDUMP_MAX_FILE_LEN, "%s", indexName) < BGPDUMP_MAX_FILE_LEN;
+    }
+
+    return snprintf(name, BGPDUMP_MAX_FILE_LEN, "%s%s", filename, MRT_INDEX_EXT) < BGPDUMP_MAX_FILE_LEN;
+}
+
+
+static int index_write(const char* name, const MRTindex_t* index)
+{
+    u_char buf[INDEX_HEADER_LEN];
+    FILE* f = fopen(name, "wb");
+    int ok;
+
+    if (!f)
+    {
+        printf("Unable to create index file %s\n", name);
+        return 0;
+    }
+
+    memcpy(buf, indexMagic, 8);
+    put_long(buf + 8, index->fileSize);
+    put_long(buf + 16, index->fileMtime);
+    put_int(buf + 24, index->nbPoints);
+    put_int(buf + 28, index->hasPeerIndex);
+    ok = fwrite(buf, INDEX_HEADER_LEN, 1, f) == 1;
+
+    put_point(buf, &index->peerIndex);
+    ok = ok && fwrite(buf, INDEX_POINT_LEN, 1, f) == 1;
+
+    for (u_int32_t i = 0 ; i < index->nbPoints && ok ; i++)
+    {
+        put_point(buf, &index->points[i]);
+        ok = fwrite(buf, INDEX_POINT_LEN, 1, f) == 1;
+    }
+
+    if (fclose(f) != 0 || !ok)
+    {
+        printf("Unable to write index file %s\n", name);
+        remove(name);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+int MRTindex_build(const char* filename, const char* indexName)
+{
+    char name[BGPDUMP_MAX_FILE_LEN];
+    MRTindex_t index;
+    MRTentry hdr;
+    MRTindexPoint_t point;
+    MRTindexPoint_t last;
+    MRTindexPoint_t* tmp;
+    void* next;
+    u_int32_t maxPoints = 0;
+    u_int32_t maxTime = 0;
+    int nbPeerIndex = 0;
+    int ret = -1;
+    struct stat st;
+    File_buf_t* dump;
+
+    if (!index_name(filename, indexName, name))
+    {
+        printf("Index file name too long\n");
+        return -1;
+    }
+
+    if (stat(filename, &st) != 0 || (dump = File_buf_create(filename)) == NULL)
+    {
+        printf("Unable to open file %s\n", filename);
+        return -1;
+    }
+
+    memset(&index, 0, sizeof(MRTindex_t));
+    index.fileSize  = st.st_size;
+    index.fileMtime = st.st_mtime;
+
+    /* The location of the bzip2 blocks is only known with the thread pool */
+    File_buf_set_decompress_threads(dump, 1);
+
+    memset(&hdr, 0, sizeof(MRTentry));
+    memset(&last, 0, sizeof(MRTindexPoint_t));
+    for (;;)
+    {
+        point.offset = cfr_tell(dump->f);
+
+        if (!Read_next_mrt_header(dump, &hdr))
+        {
+            /* Clean end of the file, or malformed record */
+            ret = cfr_peek(dump->f, &next, 1) == 0 ? (int)index.nbPoints : -1;
+            break;
+        }
+
+        if (!cfr_block_at(dump->f, point.offset, &point.block, &point.blockOffset))
+        {
+            printf("Unable to locate MRT record at offset %llu\n", (unsigned long long)point.offset);
+            break;
+        }
+        point.maxTime = maxTime;
+
+        if (point.offset == 0)
+        {
+            last = point;
+        }
+
+        if (hdr.entryType == MRT_TYPE_TABLE_DUMP_V2 && hdr.entrySubType == BGP_SUBTYPE_PEER_INDEX_TABLE)
+        {
+            if (nbPeerIndex++ == 0)
+            {
+                index.hasPeerIndex = 1;
+                index.peerIndex = point;
+            }
+        }
+        /* One point per bzip2 block (a point can only start reading from the beginning of a
+         * block), otherwise every MRT_INDEX_STEP bytes. Nothing is indexed after a second peer
+         * index, as the RIB entries that follow it would be decoded with the first one */
+        else if (nbPeerIndex < 2 && point.offset > 0 &&
+                 (dump->f->format == 2 ? point.block != last.block : point.offset >= last.offset + MRT_INDEX_STEP))
+        {
+            if (index.nbPoints == maxPoints)
+            {
+                maxPoints = maxPoints ? 2 * maxPoints : 256;
+                if ((tmp = realloc(index.points, maxPoints * sizeof(MRTindexPoint_t))) == NULL)
+                {
+                    printf("Out of memory\n");
+                    break;
+                }
+                index.points = tmp;
+            }
+
+            index.points[index.nbPoints++] = point;
+            last = point;
+        }
+
+        if (hdr.time > maxTime)
+        {
+            maxTime = hdr.time;
+        }
+
+        if (!Skip_mrt_record_body(dump, &hdr))
+        {
+            break;
+        }
+    }
+
+    File_buf_close_dump(dump);
+
+    if (ret >= 0 && !index_write(name, &index))
+    {
+        ret = -1;
+    }
+
+    free(index.points);
+    return ret;
+}
+
+
+
+MRTindex_t* MRTindex_load(const char* filename, const char* indexName)
+{
+    char name[BGPDUMP_MAX_FILE_LEN];
+    u_char buf[INDEX_HEADER_LEN];
+    MRTindex_t* index;
+    struct stat st;
+    FILE* f;
+    int ok;
+
+    if (!index_name(filename, indexName, name) || stat(filename, &st) != 0 || (f = fopen(name, "rb")) == NULL)
+    {
+        return NULL;
+    }
+
+    if (fread(buf, INDEX_HEADER_LEN, 1, f) != 1 || memcmp(buf, indexMagic, 8) != 0 ||
+        get_long(buf + 8) != (u_int64_t)st.st_size || get_long(buf + 16) != (u_int64_t)st.st_mtime ||
+        (index = calloc(1, sizeof(MRTindex_t))) == NULL)
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    index->fileSize     = st.st_size;
+    index->fileMtime    = st.st_mtime;
+    index->nbPoints     = get_buf_int(buf + 24);
+    index->hasPeerIndex = get_buf_int(buf + 28);
+
+    ok = fread(buf, INDEX_POINT_LEN, 1, f) == 1;
+    get_point(buf, &index->peerIndex);
+
+    if (ok && index->nbPoints)
+    {
+        ok = (index->points = malloc(index->nbPoints * sizeof(MRTindexPoint_t))) != NULL;
+    }
+
+    for (u_int32_t i = 0 ; i < index->nbPoints && ok ; i++)
+    {
+        ok = fread(buf, INDEX_POINT_LEN, 1, f) == 1;
+        get_point(buf, &index->points[i]);
+
+        /* The points must be sorted, for the binary search */
+        ok = ok && (i == 0 || (index->points[i].offset > index->points[i-1].offset &&
+                               index->points[i].maxTime >= index->points[i-1].maxTime));
+    }
+
+    fclose(f);
+
+    if (!ok)
+    {
+        MRTindex_free(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+
+
+int MRTindex_lookup(const MRTindex_t* index, u_int32_t fromTime)
+{
+    int low = 0;
+    int high = index->nbPoints;
+
+    /* First point whose previous records are not all older than fromTime */
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+
+        if (index->points[mid].maxTime < fromTime)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low - 1;
+}
+
+
+
+int MRTindex_seek(File_buf_t* dump, u_int32_t fromTime)
+{
+    MRTindex_t* index;
+    MRTindexPoint_t* point;
+    MRTentry* entry;
+    u_char* buffer;
+    int i;
+
+    if (dump == NULL || dump->parsed != 0 || dump->pipeline != NULL)
+    {
+        return -1;
+    }
+
+    if (dump->streamed || (index = MRTindex_load(dump->filename, NULL)) == NULL)
+    {
+        return 0;
+    }
+
+    if ((i = MRTindex_lookup(index, fromTime)) < 0)
+    {
+        MRTindex_free(index);
+        return 0;
+    }
+    point = &index->points[i];
+
+    /* The peer index is needed to decode the RIB entries that follow it */
+    if (index->hasPeerIndex && index->peerIndex.offset < point->offset)
+    {
+        if (!cfr_seek(dump->f, index->peerIndex.block, index->peerIndex.blockOffset, index->peerIndex.offset) ||
+            (entry = MRTentry_new_from_arena(dump->arena)) == NULL)
+        {
+            MRTindex_free(index);
+            return -1;
+        }
+
+        entry->dumper = dump;
+        if (!Read_next_mrt_record(dump, entry, &buffer) || !process_mrt_record(buffer, entry))
+        {
+            printf("Unable to read the peer index of %s\n", dump->filename);
+            MRTindex_free(index);
+            return -1;
+        }
+
+        Arena_reset(dump->arena);
+    }
+
+    if (!cfr_seek(dump->f, point->block, point->blockOffset, point->offset))
+    {
+        printf("Unable to seek in %s\n", dump->filename);
+        MRTindex_free(index);
+        return -1;
+    }
+
+    /* The records read to reach the point are not part of the reading */
+    dump->parsed = 0;
+
+    MRTindex_free(index);
+    return 1;
+}
+
+
+
+void MRTindex_free(MRTindex_t* index)
+{
+    if (!index)
+    {
+        return;
+    }
+
+    free(index->points);
+    free(index);
+}
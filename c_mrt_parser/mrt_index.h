@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __MRT_INDEX_H__
+#define __MRT_INDEX_H__
+
+#include "file_buffer.h"
+
+/* Extension appended to the name of an MRT file to get the name of its sidecar index */
+#define MRT_INDEX_EXT           ".idx"
+
+/* Minimum number of (decompressed) bytes between two points of the index, for the files that
+ * are not compressed with bzip2 (bzip2 files get one point per bzip2 block) */
+#define MRT_INDEX_STEP          (1024 * 1024)
+
+
+/**
+ * @brief Location of an MRT record in a file, from which the reading can restart (see
+ * cfr_block_at and cfr_seek).
+ */
+typedef struct
+{
+    /**
+     * @brief Highest timestamp of all the records located before this one in the file.
+     */
+    u_int32_t   maxTime;
+
+    /**
+     * @brief Location of the compressed data from which the record can be reached (in bits for
+     * bzip2 files, in bytes otherwise), and offset of its decompressed data.
+     */
+    u_int64_t   block;
+    u_int64_t   blockOffset;
+
+    /**
+     * @brief Offset of the record in the decompressed data.
+     */
+    u_int64_t   offset;
+} MRTindexPoint_t;
+
+
+/**
+ * @brief Structure representing the sidecar index of an MRT file, i.e., a sorted list of
+ * locations in the file from which the reading can restart, with the timestamps of the records
+ * located before them.
+ */
+typedef struct
+{
+    /**
+     * @brief Size and modification time of the MRT file when the index was built, to detect
+     * outdated indexes.
+     */
+    u_int64_t   fileSize;
+    u_int64_t   fileMtime;
+
+    /**
+     * @brief Location of the TABLE_DUMP_V2 peer index of the file (if hasPeerIndex is set),
+     * that must be read before any RIB entry.
+     */
+    int         hasPeerIndex;
+    MRTindexPoint_t peerIndex;
+
+    /**
+     * @brief Points of the index, sorted by offset (hence by maxTime).
+     */
+    MRTindexPoint_t* points;
+    u_int32_t   nbPoints;
+} MRTindex_t;
+
+
+/**
+ * @brief Builds the sidecar index of an MRT file, by framing all its records (their bodies are
+ * skipped without being decoded).
+ *
+ * @param filename  Name of the MRT file.
+ * @param indexName Name of the index file to write, NULL for filename followed by
+ * MRT_INDEX_EXT.
+ *
+ * @return int      Returns the number of points of the index, -1 in case of error.
+ */
+int MRTindex_build(const char* filename, const char* indexName);
+
+
+/**
+ * @brief Loads the sidecar index of an MRT file.
+ *
+ * @param filename  Name of the MRT file.
+ * @param indexName Name of the index file, NULL for filename followed by MRT_INDEX_EXT.
+ *
+ * @return MRTindex_t*  Returns a pointer to the index, NULL if there is no index, or if it is
+ * malformed or outdated (the MRT file changed since it was built).
+ */
+MRTindex_t* MRTindex_load(const char* filename, const char* indexName);
+
+
+/**
+ * @brief Finds the last point of the index before which all the records are older than a
+ * given timestamp, in O(log n).
+ *
+ * @param index     Pointer to the index.
+ * @param fromTime  Timestamp of the first records of interest.
+ *
+ * @return int      Returns the index of the point, -1 if the reading must start from the
+ * beginning of the file.
+ */
+int MRTindex_lookup(const MRTindex_t* index, u_int32_t fromTime);
+
+
+/**
+ * @brief Moves the reading of a File buffer structure to the first point of the sidecar index
+ * of its file before which all the records are older than fromTime. The peer index of a RIB
+ * file is read first. Must be called before anything is read from the File buffer structure
+ * (except for File_buf_set_filter and File_buf_set_decompress_threads, that must be called
+ * before), and before File_buf_set_parse_threads.
+ *
+ * @param dump      Pointer to the File buffer structure.
+ * @param fromTime  Timestamp of the first records of interest.
+ *
+ * @return int      Returns 1 if the reading was moved, 0 if it starts from the beginning of the
+ * file (no usable index, or the data is read from a stream), -1 in case of error (the File
+ * buffer structure must then be closed).
+ */
+int MRTindex_seek(File_buf_t* dump, u_int32_t fromTime);
+
+
+/**
+ * @brief Frees an index.
+ *
+ * @param index     Pointer to the index.
+ */
+void MRTindex_free(MRTindex_t* index);
+
+#endif
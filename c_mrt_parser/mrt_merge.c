@@ -0,0 +1,293 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mrt_merge.h"
+
+
+/* Orders the current entries by timestamp, then by File buffer structure */
+static int merge_before(MRTmerge_t* merge, int a, int b)
+{
+    MRTentry* ea = merge->heads[a];
+    MRTentry* eb = merge->heads[b];
+
+    if (ea->time != eb->time)
+    {
+        return ea->time < eb->time;
+    }
+
+    if (ea->time_ms != eb->time_ms)
+    {
+        return ea->time_ms < eb->time_ms;
+    }
+
+    if (merge->ranks[a] != merge->ranks[b])
+    {
+        return merge->ranks[a] < merge->ranks[b];
+    }
+
+    return a < b;
+}
+
+
+static void merge_sift_down(MRTmerge_t* merge, int pos)
+{
+    int* heap = merge->heap;
+    int child;
+    int tmp;
+
+    while ((child = 2 * pos + 1) < merge->heapSize)
+    {
+        if (child + 1 < merge->heapSize && merge_before(merge, heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+
+        if (!merge_before(merge, heap[child], heap[pos]))
+        {
+            break;
+        }
+
+        tmp = heap[pos];
+        heap[pos] = heap[child];
+        heap[child] = tmp;
+        pos = child;
+    }
+}
+
+
+static void merge_sift_up(MRTmerge_t* merge, int pos)
+{
+    int* heap = merge->heap;
+    int parent;
+    int tmp;
+
+    while (pos > 0)
+    {
+        parent = (pos - 1) / 2;
+
+        if (!merge_before(merge, heap[pos], heap[parent]))
+        {
+            break;
+        }
+
+        tmp = heap[pos];
+        heap[pos] = heap[parent];
+        heap[parent] = tmp;
+        pos = parent;
+    }
+}
+
+
+/* Reads the next entry of a File buffer structure, skipping the records that cannot be decoded.
+ * Returns 0 once the structure is entirely read, the structure being then closed */
+static int merge_read_head(MRTmerge_t* merge, int i)
+{
+    File_buf_t* dump = merge->dumps[i];
+
+    while (dump->eof == 0)
+    {
+        if ((merge->heads[i] = Read_next_mrt_entry_cursor(dump)) != NULL)
+        {
+            return 1;
+        }
+    }
+
+    merge->heads[i] = NULL;
+    merge->dumps[i] = NULL;
+    File_buf_close_dump(dump);
+
+    return 0;
+}
+
+
+/* Replaces the entry returned last by the next one of its file, or reads every file up to its
+ * first entry and builds the heap on the first call */
+static void merge_advance(MRTmerge_t* merge)
+{
+    if (!merge->started)
+    {
+        merge->started = 1;
+
+        for (int i = 0 ; i < merge->nbDumps ; i++)
+        {
+            if (merge_read_head(merge, i))
+            {
+                merge->heap[merge->heapSize++] = i;
+            }
+        }
+
+        for (int i = merge->heapSize / 2 - 1 ; i >= 0 ; i--)
+        {
+            merge_sift_down(merge, i);
+        }
+    }
+    else if (merge->last >= 0)
+    {
+        if (!merge_read_head(merge, merge->last))
+        {
+            merge->heap[0] = merge->heap[--merge->heapSize];
+        }
+
+        merge_sift_down(merge, 0);
+        merge->last = -1;
+    }
+}
+
+
+/* Makes room for one more File buffer structure */
+static int merge_grow(MRTmerge_t* merge)
+{
+    int size;
+
+    if (merge->nbDumps < merge->sizeDumps)
+    {
+        return 1;
+    }
+
+    size = merge->sizeDumps ? merge->sizeDumps * 2 : 16;
+
+    File_buf_t** dumps = realloc(merge->dumps, size * sizeof(File_buf_t*));
+    if (!dumps)
+    {
+        return 0;
+    }
+    merge->dumps = dumps;
+
+    MRTentry** heads = realloc(merge->heads, size * sizeof(MRTentry*));
+    if (!heads)
+    {
+        return 0;
+    }
+    merge->heads = heads;
+
+    int* heap = realloc(merge->heap, size * sizeof(int));
+    if (!heap)
+    {
+        return 0;
+    }
+    merge->heap = heap;
+
+    int* ranks = realloc(merge->ranks, size * sizeof(int));
+    if (!ranks)
+    {
+        return 0;
+    }
+    merge->ranks = ranks;
+
+    merge->sizeDumps = size;
+
+    return 1;
+}
+
+
+MRTmerge_t* MRTmerge_new(void)
+{
+    MRTmerge_t* merge = calloc(1, sizeof(MRTmerge_t));
+
+    if (merge)
+    {
+        merge->last = -1;
+    }
+
+    return merge;
+}
+
+
+int MRTmerge_add(MRTmerge_t* merge, File_buf_t* dump)
+{
+    return MRTmerge_add_ranked(merge, dump, merge ? merge->nbDumps : 0);
+}
+
+
+int MRTmerge_add_ranked(MRTmerge_t* merge, File_buf_t* dump, int rank)
+{
+    int i;
+
+    if (!merge || !dump || !merge_grow(merge))
+    {
+        return 0;
+    }
+
+    i = merge->nbDumps++;
+    merge->dumps[i] = dump;
+    merge->heads[i] = NULL;
+    merge->ranks[i] = rank;
+
+    /* Once the merger is being read, the heap must not hold the entry returned last anymore
+     * before the first entry of the new file is pushed on it */
+    if (merge->started)
+    {
+        merge_advance(merge);
+
+        if (merge_read_head(merge, i))
+        {
+            merge->heap[merge->heapSize++] = i;
+            merge_sift_up(merge, merge->heapSize - 1);
+            merge->eof = 0;
+        }
+    }
+
+    return 1;
+}
+
+
+void MRTmerge_set_horizon(MRTmerge_t* merge, u_int32_t time)
+{
+    if (merge)
+    {
+        merge->horizon = time;
+    }
+}
+
+
+MRTentry* MRTmerge_next(MRTmerge_t* merge)
+{
+    if (!merge)
+    {
+        return NULL;
+    }
+
+    merge_advance(merge);
+
+    if (merge->heapSize == 0)
+    {
+        merge->eof = 1;
+        return NULL;
+    }
+
+    /* Held back until the files starting at the horizon are added */
+    if (merge->horizon && merge->heads[merge->heap[0]]->time >= merge->horizon)
+    {
+        return NULL;
+    }
+
+    merge->last = merge->heap[0];
+
+    return merge->heads[merge->last];
+}
+
+
+void MRTmerge_free(MRTmerge_t* merge)
+{
+    if (!merge)
+    {
+        return;
+    }
+
+    for (int i = 0 ; i < merge->nbDumps ; i++)
+    {
+        if (merge->dumps[i])
+        {
+            File_buf_close_dump(merge->dumps[i]);
+        }
+    }
+
+    free(merge->dumps);
+    free(merge->heads);
+    free(merge->heap);
+    free(merge->ranks);
+    free(merge);
+}
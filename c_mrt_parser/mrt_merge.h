@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __MRT_MERGE_H__
+#define __MRT_MERGE_H__
+
+#include "file_buffer.h"
+
+
+/**
+ * @brief Structure merging the MRT entries of several File buffer structures (e.g., the files
+ * of several vantage points over the same period) into a single sequence ordered by timestamp.
+ *
+ * Each file must be ordered by time (as the update files are). Only the current entry of each
+ * file is kept, in a min-heap keyed on (time, time_ms), so that the memory used only depends on
+ * the number of files. Entries with the same timestamp are returned in the order in which their
+ * files were added (or by rank, see MRTmerge_add_ranked).
+ */
+typedef struct
+{
+    /**
+     * @brief File buffer structures read by the merger, owned by it.
+     */
+    File_buf_t** dumps;
+    int nbDumps;
+    int sizeDumps;
+
+    /**
+     * @brief Current entry of each File buffer structure (NULL once it is entirely read, the
+     * structure being then closed and its slot of dumps set to NULL).
+     */
+    MRTentry** heads;
+
+    /**
+     * @brief Min-heap of the indexes of the File buffer structures that have a current entry.
+     */
+    int* heap;
+    int heapSize;
+
+    /**
+     * @brief Index of the File buffer structure of the entry returned last, which is only read
+     * further on the next call (so that the returned entry remains valid until then), -1 if none.
+     */
+    int last;
+
+    /**
+     * @brief Set once the first entry of every File buffer structure has been read.
+     */
+    int started;
+
+    /**
+     * @brief Set once all the entries of all the File buffer structures have been returned
+     * (reset if a File buffer structure with entries left is added afterwards).
+     */
+    int eof;
+
+    /**
+     * @brief Time from which the entries are held back, 0 if none (see MRTmerge_set_horizon).
+     */
+    u_int32_t horizon;
+
+    /**
+     * @brief Rank of each File buffer structure, which orders the entries with the same timestamp
+     * (see MRTmerge_add_ranked).
+     */
+    int* ranks;
+} MRTmerge_t;
+
+
+/**
+ * @brief Creates an empty merger.
+ *
+ * @return MRTmerge_t*  Returns a pointer to the merger, NULL if no memory can be allocated.
+ */
+MRTmerge_t* MRTmerge_new(void);
+
+
+/**
+ * @brief Adds a File buffer structure to a merger, which takes it over (it is closed once
+ * entirely read, or with the merger). The structure must be fully set up (filter, threads,
+ * sidecar index). If the merger is already being read, the entry it returned last is no longer
+ * valid, and the first entry of the structure is read right away.
+ *
+ * @param merge     Pointer to the merger.
+ * @param dump      Pointer to the File buffer structure.
+ *
+ * @return int      Returns 1 on success, 0 otherwise (the File buffer structure is then left to
+ * the caller).
+ */
+int MRTmerge_add(MRTmerge_t* merge, File_buf_t* dump);
+
+
+/**
+ * @brief Same as MRTmerge_add, but the entries with the same timestamp are returned by rank of
+ * their File buffer structures instead of the order in which the structures were added, e.g., to
+ * keep the order of a list of files added once the merge reaches their start.
+ *
+ * @param merge     Pointer to the merger.
+ * @param dump      Pointer to the File buffer structure.
+ * @param rank      Rank of the File buffer structure (by default, the number of structures
+ * added before it).
+ *
+ * @return int      Returns 1 on success, 0 otherwise (the File buffer structure is then left to
+ * the caller).
+ */
+int MRTmerge_add_ranked(MRTmerge_t* merge, File_buf_t* dump, int rank);
+
+
+/**
+ * @brief Holds back the entries of a merger from a given time on: MRTmerge_next returns NULL
+ * (without setting merge->eof) instead of such an entry, until the horizon is moved. Used to
+ * add the files starting at the horizon before any entry after their start is returned.
+ *
+ * @param merge     Pointer to the merger.
+ * @param time      UNIX timestamp from which the entries are held back, 0 to hold none.
+ */
+void MRTmerge_set_horizon(MRTmerge_t* merge, u_int32_t time);
+
+
+/**
+ * @brief Returns the MRT entry with the lowest timestamp among the current entries of all the
+ * File buffer structures of a merger. The RIB entries are read one at a time (see
+ * Read_next_mrt_entry_cursor).
+ *
+ * @param merge     Pointer to the merger.
+ *
+ * @return MRTentry*    Returns the next entry, valid until the next call (or the next
+ * MRTmerge_add), NULL once all the entries are read (merge->eof is then set), or if the next
+ * entry is held back by the horizon.
+ */
+MRTentry* MRTmerge_next(MRTmerge_t* merge);
+
+
+/**
+ * @brief Frees a merger, and closes all its File buffer structures.
+ *
+ * @param merge     Pointer to the merger.
+ */
+void MRTmerge_free(MRTmerge_t* merge);
+
+#endif
@@ -0,0 +1,551 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#include "mrt_pipeline.h"
+#include "file_buffer.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define BATCH_FREE      0
+#define BATCH_FILLED    1
+#define BATCH_BUSY      2
+#define BATCH_DONE      3
+
+
+/**
+ * @brief Raw MRT record framed in a batch.
+ */
+typedef struct
+{
+    u_int32_t time;
+    u_int32_t time_ms;
+    u_int16_t entryType;
+    u_int16_t entrySubType;
+    u_int32_t entryLength;
+
+    /**
+     * @brief Offset of the record body in the data of the batch.
+     */
+    size_t offset;
+
+    /**
+     * @brief Decoded entry, NULL if the record could not be decoded.
+     */
+    MRTentry* entry;
+
+    /**
+     * @brief Set when the decoded record does not match the filter of the dumper.
+     */
+    int filtered;
+} pipeline_record_t;
+
+
+/**
+ * @brief Batch of consecutive MRT records.
+ */
+typedef struct
+{
+    size_t seq;
+    int    state;
+
+    /**
+     * @brief Set when the batch holds a PEER_INDEX_TABLE record.
+     */
+    int    barrier;
+
+    /**
+     * @brief Number of records skipped on their MRT header while filling the batch.
+     */
+    int    nbFiltered;
+
+    pipeline_record_t* records;
+    size_t nbRecords;
+    size_t recordsSize;
+
+    u_char* data;
+    size_t  dataLen;
+    size_t  dataSize;
+
+    Arena_t* arena;
+} pipeline_batch_t;
+
+
+/**
+ * @brief Decoding thread, with the cache in which it interns the RIB attributes of all the
+ * batches it decodes (a thread decodes a single batch at a time).
+ */
+typedef struct
+{
+    struct MRTpipeline* pipe;
+    pthread_t thread;
+    MRTattrCache_t* attrCache;
+} pipeline_worker_t;
+
+
+struct MRTpipeline
+{
+    struct FileBuffer* dump;
+
+    /* Ring of batches */
+    pipeline_batch_t* batches;
+    size_t nbBatches;
+    size_t nextFill;
+    size_t nextTask;
+    size_t nextRead;
+    size_t readPos;
+
+    int    nbBusy;
+    int    barrierBusy;
+    int    framingDone;
+    int    stop;
+
+    int        framerStarted;
+    pthread_t  framer;
+    pipeline_worker_t* workers;
+    int        nbThreads;
+    int        nbWorkers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+};
+
+
+static int batch_add_record(pipeline_batch_t* batch, MRTentry* hdr, u_char* body)
+{
+    pipeline_record_t* rec;
+
+    if (batch->nbRecords == batch->recordsSize)
+    {
+        size_t newSize = batch->recordsSize ? batch->recordsSize * 2 : 64;
+        pipeline_record_t* tmp = realloc(batch->records, newSize * sizeof(pipeline_record_t));
+
+        if (!tmp)
+        {
+            return 0;
+        }
+
+        batch->records = tmp;
+        batch->recordsSize = newSize;
+    }
+
+    if (batch->dataLen + hdr->entryLength > batch->dataSize)
+    {
+        size_t newSize = batch->dataSize ? batch->dataSize : PIPELINE_BATCH_BYTES;
+        u_char* tmp;
+
+        while (newSize < batch->dataLen + hdr->entryLength)
+        {
+            newSize *= 2;
+        }
+
+        if ((tmp = realloc(batch->data, newSize)) == NULL)
+        {
+            return 0;
+        }
+
+        batch->data = tmp;
+        batch->dataSize = newSize;
+    }
+
+    rec = &batch->records[batch->nbRecords++];
+    rec->time         = hdr->time;
+    rec->time_ms      = hdr->time_ms;
+    rec->entryType    = hdr->entryType;
+    rec->entrySubType = hdr->entrySubType;
+    rec->entryLength  = hdr->entryLength;
+    rec->offset       = batch->dataLen;
+    rec->entry        = NULL;
+    rec->filtered     = 0;
+
+    memcpy(batch->data + batch->dataLen, body, hdr->entryLength);
+    batch->dataLen += hdr->entryLength;
+
+    return 1;
+}
+
+
+static void* pipeline_framer(void* arg)
+{
+    MRTpipeline_t* pipe = arg;
+    pipeline_batch_t* batch;
+    MRTentry hdr;
+    u_char* body;
+    int end = 0;
+
+    while (!end)
+    {
+        pthread_mutex_lock(&pipe->lock);
+
+        batch = &pipe->batches[pipe->nextFill % pipe->nbBatches];
+        while (!pipe->stop && batch->state != BATCH_FREE)
+        {
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+
+        if (pipe->stop)
+        {
+            pthread_mutex_unlock(&pipe->lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&pipe->lock);
+
+        batch->nbRecords = 0;
+        batch->dataLen = 0;
+        batch->barrier = 0;
+        batch->nbFiltered = 0;
+
+        while (batch->nbRecords < PIPELINE_BATCH_RECORDS && batch->dataLen < PIPELINE_BATCH_BYTES)
+        {
+            memset(&hdr, 0, sizeof(MRTentry));
+
+            if (!Read_next_mrt_header(pipe->dump, &hdr))
+            {
+                end = 1;
+                break;
+            }
+
+            /* Records that cannot match the filter are skipped without being copied */
+            if (pipe->dump->filter && !MRTfilter_match_header(pipe->dump->filter, &hdr))
+            {
+                if (MRTfilter_past_end(pipe->dump->filter, &hdr) || !Skip_mrt_record_body(pipe->dump, &hdr))
+                {
+                    end = 1;
+                    break;
+                }
+
+                batch->nbFiltered++;
+                continue;
+            }
+
+            if (!Read_mrt_record_body(pipe->dump, &hdr, &body))
+            {
+                end = 1;
+                break;
+            }
+
+            if (!batch_add_record(batch, &hdr, body))
+            {
+                printf("Unable to allocate any memory\n");
+                end = 1;
+                break;
+            }
+
+            /* Close the batch right after a peer index, to keep its serialized decoding short */
+            if (hdr.entryType == MRT_TYPE_TABLE_DUMP_V2 && hdr.entrySubType == BGP_SUBTYPE_PEER_INDEX_TABLE)
+            {
+                batch->barrier = 1;
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&pipe->lock);
+
+        if (batch->nbRecords || batch->nbFiltered)
+        {
+            batch->seq = pipe->nextFill++;
+            batch->state = BATCH_FILLED;
+        }
+
+        pipe->framingDone = end;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->framingDone = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+
+    return NULL;
+}
+
+
+static void pipeline_decode_batch(MRTpipeline_t* pipe, pipeline_batch_t* batch, MRTattrCache_t* attrCache)
+{
+    pipeline_record_t* rec;
+    MRTentry* entry;
+    int ret;
+
+    for (size_t i = 0 ; i < batch->nbRecords ; i++)
+    {
+        rec = &batch->records[i];
+
+        if ((entry = MRTentry_new_from_arena(batch->arena)) == NULL)
+        {
+            printf("Unable to allocate any memory\n");
+            continue;
+        }
+
+        entry->time         = rec->time;
+        entry->time_ms      = rec->time_ms;
+        entry->entryType    = rec->entryType;
+        entry->entrySubType = rec->entrySubType;
+        entry->entryLength  = rec->entryLength;
+        entry->dumper       = pipe->dump;
+        entry->attrCache    = attrCache;
+
+        if ((ret = process_mrt_record(batch->data + rec->offset, entry)) == MRT_RECORD_FILTERED)
+        {
+            rec->filtered = 1;
+        }
+        else if (ret)
+        {
+            rec->entry = entry;
+        }
+    }
+}
+
+
+static void* pipeline_worker(void* arg)
+{
+    pipeline_worker_t* worker = arg;
+    MRTpipeline_t* pipe = worker->pipe;
+    pipeline_batch_t* batch;
+
+    pthread_mutex_lock(&pipe->lock);
+
+    while (!pipe->stop)
+    {
+        batch = &pipe->batches[pipe->nextTask % pipe->nbBatches];
+
+        /* Batches are claimed in order. A peer index waits for the previous batches to be decoded,
+         * and the next batches wait for the peer index to be decoded */
+        if (pipe->nextTask < pipe->nextFill && batch->state == BATCH_FILLED && !pipe->barrierBusy &&
+            (!batch->barrier || pipe->nbBusy == 0))
+        {
+            pipe->nextTask++;
+            pipe->nbBusy++;
+            pipe->barrierBusy = batch->barrier;
+            batch->state = BATCH_BUSY;
+            pthread_mutex_unlock(&pipe->lock);
+
+            pipeline_decode_batch(pipe, batch, worker->attrCache);
+
+            pthread_mutex_lock(&pipe->lock);
+            pipe->nbBusy--;
+            if (batch->barrier)
+            {
+                pipe->barrierBusy = 0;
+            }
+            batch->state = BATCH_DONE;
+            pthread_cond_broadcast(&pipe->cond);
+            continue;
+        }
+
+        /* Nothing left to decode */
+        if (pipe->framingDone && pipe->nextTask == pipe->nextFill)
+        {
+            break;
+        }
+
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+
+    pthread_mutex_unlock(&pipe->lock);
+
+    return NULL;
+}
+
+
+MRTpipeline_t* MRTpipeline_new(struct FileBuffer* dump, int threads)
+{
+    MRTpipeline_t* pipe;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus > 0 && threads > cpus)
+    {
+        threads = cpus;
+    }
+
+    if (!dump || threads < 1 || (pipe = calloc(1, sizeof(MRTpipeline_t))) == NULL)
+    {
+        return NULL;
+    }
+
+    pipe->dump = dump;
+    pipe->nbBatches = threads * PIPELINE_BATCHES_PER_THREAD + 2;
+    pipe->batches = calloc(pipe->nbBatches, sizeof(pipeline_batch_t));
+    pipe->workers = calloc(threads, sizeof(pipeline_worker_t));
+    pipe->nbThreads = threads;
+
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->cond, NULL);
+
+    if (!pipe->batches || !pipe->workers)
+    {
+        MRTpipeline_free(pipe);
+        return NULL;
+    }
+
+    for (size_t i = 0 ; i < pipe->nbBatches ; i++)
+    {
+        if ((pipe->batches[i].arena = Arena_new()) == NULL)
+        {
+            MRTpipeline_free(pipe);
+            return NULL;
+        }
+    }
+
+    /* The interned attributes of all the threads fit in the budget of a single cache */
+    for (int i = 0 ; i < threads ; i++)
+    {
+        pipe->workers[i].pipe = pipe;
+        if ((pipe->workers[i].attrCache = MRTattrCache_new()) == NULL)
+        {
+            MRTpipeline_free(pipe);
+            return NULL;
+        }
+        pipe->workers[i].attrCache->maxBytes = MRT_ATTR_CACHE_MAX_BYTES / threads;
+    }
+
+    if (pthread_create(&pipe->framer, NULL, pipeline_framer, pipe) != 0)
+    {
+        MRTpipeline_free(pipe);
+        return NULL;
+    }
+    pipe->framerStarted = 1;
+
+    for (int i = 0 ; i < threads ; i++)
+    {
+        if (pthread_create(&pipe->workers[i].thread, NULL, pipeline_worker, &pipe->workers[i]) != 0)
+        {
+            break;
+        }
+        pipe->nbWorkers++;
+    }
+
+    if (pipe->nbWorkers == 0)
+    {
+        MRTpipeline_free(pipe);
+        return NULL;
+    }
+
+    return pipe;
+}
+
+
+MRTentry* MRTpipeline_next_entry(MRTpipeline_t* pipe, int* end)
+{
+    pipeline_batch_t* batch;
+
+    *end = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pipe->lock);
+
+        for (;;)
+        {
+            batch = &pipe->batches[pipe->nextRead % pipe->nbBatches];
+
+            if (pipe->nextRead < pipe->nextFill && batch->state == BATCH_DONE)
+            {
+                break;
+            }
+
+            /* All the records have been read */
+            if (pipe->framingDone && pipe->nextRead == pipe->nextFill)
+            {
+                pthread_mutex_unlock(&pipe->lock);
+                *end = 1;
+                return NULL;
+            }
+
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        }
+
+        pthread_mutex_unlock(&pipe->lock);
+
+        while (pipe->readPos < batch->nbRecords)
+        {
+            pipeline_record_t* rec = &batch->records[pipe->readPos++];
+
+            if (!rec->filtered)
+            {
+                return rec->entry;
+            }
+
+            pipe->dump->filtered++;
+        }
+
+        /* Batch entirely read, give it back to the framing thread */
+        pipe->dump->filtered += batch->nbFiltered;
+        Arena_reset(batch->arena);
+
+        pthread_mutex_lock(&pipe->lock);
+        batch->state = BATCH_FREE;
+        pipe->nextRead++;
+        pipe->readPos = 0;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+}
+
+
+int MRTpipeline_batch_end(MRTpipeline_t* pipe)
+{
+    pipeline_batch_t* batch;
+    int ret;
+
+    pthread_mutex_lock(&pipe->lock);
+    batch = &pipe->batches[pipe->nextRead % pipe->nbBatches];
+    ret = pipe->readPos > 0;
+
+    /* The records left in the batch may all be skipped by the filter */
+    for (size_t i = pipe->readPos ; i < batch->nbRecords && ret ; i++)
+    {
+        ret = batch->records[i].filtered;
+    }
+    pthread_mutex_unlock(&pipe->lock);
+
+    return ret;
+}
+
+
+void MRTpipeline_free(MRTpipeline_t* pipe)
+{
+    if (!pipe)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pipe->lock);
+    pipe->stop = 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+
+    if (pipe->framerStarted)
+    {
+        pthread_join(pipe->framer, NULL);
+    }
+
+    for (int i = 0 ; i < pipe->nbWorkers ; i++)
+    {
+        pthread_join(pipe->workers[i].thread, NULL);
+    }
+
+    /* The decoded entries may share the attributes of any cache, they are freed first */
+    for (size_t i = 0 ; pipe->batches && i < pipe->nbBatches ; i++)
+    {
+        Arena_free(pipe->batches[i].arena);
+        free(pipe->batches[i].records);
+        free(pipe->batches[i].data);
+    }
+
+    for (int i = 0 ; pipe->workers && i < pipe->nbThreads ; i++)
+    {
+        MRTattrCache_free(pipe->workers[i].attrCache);
+    }
+
+    pthread_mutex_destroy(&pipe->lock);
+    pthread_cond_destroy(&pipe->cond);
+
+    free(pipe->batches);
+    free(pipe->workers);
+    free(pipe);
+}
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+#ifndef __MRT_PIPELINE_H__
+#define __MRT_PIPELINE_H__
+
+#include "mrt_entry.h"
+
+/* Maximum number of MRT records, and of bytes of MRT records, framed in a single batch */
+#define PIPELINE_BATCH_RECORDS  1024
+#define PIPELINE_BATCH_BYTES    (1024 * 1024)
+
+/* Number of batches that can be in flight (framed, decoded or read), per decoding thread */
+#define PIPELINE_BATCHES_PER_THREAD 2
+
+struct FileBuffer;
+
+
+/**
+ * @brief Structure representing a pipeline of threads parsing the MRT records of a file. A
+ * framing thread reads the raw MRT records and groups them into batches, a pool of worker
+ * threads decodes the batches (each batch has its own arena for the decoded entries, and each
+ * thread its own cache of the RIB attributes), and the consumer reads the decoded entries back
+ * in the order of the file.
+ *
+ * MRT records are independent once framed, except for the TABLE_DUMP_V2 peer index, which is
+ * used to decode the RIB entries following it. A batch holding a PEER_INDEX_TABLE record is
+ * only decoded once all the previous batches are decoded, and no other batch is decoded at
+ * the same time.
+ */
+typedef struct MRTpipeline MRTpipeline_t;
+
+
+/**
+ * @brief Creates a pipeline parsing the records of a File buffer structure, and starts its
+ * threads. Nothing must have been read from the File buffer structure yet, and the file must
+ * not be read by anything else than the pipeline afterwards.
+ *
+ * @param dump      Pointer to the File buffer structure from which the records are read.
+ * @param threads   Number of decoding threads (at most the number of online CPUs).
+ *
+ * @return MRTpipeline_t*   Returns a pointer to the pipeline, NULL if it cannot be started.
+ */
+MRTpipeline_t* MRTpipeline_new(struct FileBuffer* dump, int threads);
+
+
+/**
+ * @brief Returns the next decoded MRT entry of the pipeline, in the order of the file. Only the
+ * first entry of each MRT record is returned (the other RIB entries of the record are linked to
+ * it with the next pointer). The entry remains valid until all the entries of its batch are
+ * read.
+ *
+ * @param pipe      Pointer to the pipeline.
+ * @param end       Set to 1 if there is no more MRT record to read.
+ *
+ * @return MRTentry*    Returns the decoded MRT entry, NULL if the MRT record could not be
+ * decoded or if there is no more MRT record to read.
+ */
+MRTentry* MRTpipeline_next_entry(MRTpipeline_t* pipe, int* end);
+
+
+/**
+ * @brief Tells whether all the entries of the batch currently read have been returned, i.e.,
+ * whether the next call to MRTpipeline_next_entry releases them.
+ *
+ * @param pipe      Pointer to the pipeline.
+ *
+ * @return int      Returns 1 if the current batch has been read entirely, 0 otherwise.
+ */
+int MRTpipeline_batch_end(MRTpipeline_t* pipe);
+
+
+/**
+ * @brief Stops the threads of the pipeline and frees it, along with all the decoded entries.
+ *
+ * @param pipe      Pointer to the pipeline.
+ */
+void MRTpipeline_free(MRTpipeline_t* pipe);
+
+#endif
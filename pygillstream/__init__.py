@@ -2,6 +2,6 @@
 #
 # SPDX-License-Identifier: GPL-2.0-only
 
-from .broker import GillStream, BGPmessage, parse_one_file
+from .broker import GillStream, BGPmessage, parse_one_file, build_index
 
-__all__ = ['BGPmessage', 'GillStream', 'parse_one_file']
+__all__ = ['BGPmessage', 'GillStream', 'parse_one_file', 'build_index']
@@ -0,0 +1,939 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Thomas Alfroy
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ */
+
+/*
+ * Native bridge between libbgpgill and Python. A Reader wraps a File buffer structure, reads
+ * its MRT entries by batches, and builds the BGPmessage objects directly in C, so that no
+ * ctypes field access nor per-prefix Python call is needed. A Reader can also wrap a merger of
+ * several files, whose entries are then read one at a time in timestamp order.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "file_buffer.h"
+#include "mrt_index.h"
+#include "mrt_merge.h"
+
+/* Number of MRT entries read per call to Read_next_mrt_batch */
+#define READER_BATCH_ENTRIES    4096
+#define READER_BATCH_BYTES      (4 * 1024 * 1024)
+
+
+typedef struct
+{
+    PyObject_HEAD
+
+    /**
+     * @brief File buffer structure from which the MRT entries are read, NULL once closed.
+     */
+    File_buf_t* dump;
+
+    /**
+     * @brief Merger from which the MRT entries are read instead, if several files are read.
+     */
+    MRTmerge_t* merge;
+
+    /**
+     * @brief Class of the objects built for each BGP message (BGPmessage).
+     */
+    PyTypeObject* msgClass;
+
+    /**
+     * @brief Current batch of MRT entries.
+     */
+    MRTentry* entries[READER_BATCH_ENTRIES];
+    int nbEntries;
+    int actEntry;
+
+    /**
+     * @brief Options with which the files are opened, kept for the files added to the merger
+     * once it is being read (see Reader_add).
+     */
+    unsigned long fromTime;
+    unsigned long untilTime;
+    int threads;
+    int parseThreads;
+    PyObject* filters;
+    int monotonic;
+
+    /**
+     * @brief Set while entries are read without the GIL, during which the reader must not be
+     * closed, reopened nor read by another thread.
+     */
+    int busy;
+} Reader;
+
+
+/* Interned attribute names of BGPmessage */
+static PyObject* str_ts;
+static PyObject* str_type;
+static PyObject* str_nlri;
+static PyObject* str_withdraws;
+static PyObject* str_origin;
+static PyObject* str_nexthop;
+static PyObject* str_as_path;
+static PyObject* str_origin_asn;
+static PyObject* str_as_path_len;
+static PyObject* str_communities;
+static PyObject* str_large_communities;
+static PyObject* str_ext_communities;
+static PyObject* str_peer_asn;
+static PyObject* str_peer_addr;
+static PyObject* str_msgType;
+static PyObject* str_bgpType;
+
+static PyObject* emptyTuple;
+
+
+static int is_bgp_message(MRTentry* entry)
+{
+    if (entry->entryType == MRT_TYPE_BGP4MP || entry->entryType == MRT_TYPE_BGP4MP_ET)
+    {
+        return 1;
+    }
+
+    return entry->entryType == MRT_TYPE_TABLE_DUMP_V2 &&
+        (entry->entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST || entry->entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST);
+}
+
+
+static const char* msg_type_str(MRTentry* entry)
+{
+    if (entry->entryType == MRT_TYPE_TABLE_DUMP_V2)
+    {
+        return "R";
+    }
+
+    switch (entry->bgpType)
+    {
+        case BGP_TYPE_OPEN:
+            return "O";
+        case BGP_TYPE_UPDATE:
+            return "U";
+        case BGP_TYPE_NOTIFICATION:
+            return "N";
+        case BGP_TYPE_KEEPALIVE:
+            return "K";
+        case BGP_TYPE_STATE_CHANGE:
+            return "S";
+        default:
+            return "Unknown";
+    }
+}
+
+
+static PyObject* prefix_list(Prefix_t* pfx, int nb)
+{
+    char buf[64];
+    PyObject* list = PyList_New(nb);
+    PyObject* str;
+    int len;
+
+    if (!list)
+    {
+        return NULL;
+    }
+
+    for (int i = 0 ; i < nb ; i++)
+    {
+        if ((len = Prefix_to_str(&pfx[i], buf, sizeof(buf))) < 0 ||
+            (str = PyUnicode_DecodeUTF8(buf, len, NULL)) == NULL)
+        {
+            if (!PyErr_Occurred())
+            {
+                PyErr_SetString(PyExc_ValueError, "invalid prefix");
+            }
+            Py_DECREF(list);
+            return NULL;
+        }
+
+        PyList_SET_ITEM(list, i, str);
+    }
+
+    return list;
+}
+
+
+static PyObject* large_community_tuple(MRTentry* entry)
+{
+    PyObject* tuple = PyTuple_New(entry->nbLargeCommunities);
+    LargeCommunity_t* com;
+    PyObject* item;
+
+    if (!tuple)
+    {
+        return NULL;
+    }
+
+    for (int i = 0 ; i < entry->nbLargeCommunities ; i++)
+    {
+        com = &entry->largeCommunities[i];
+
+        if ((item = Py_BuildValue("(kkk)", (unsigned long)com->global, (unsigned long)com->local1,
+                                  (unsigned long)com->local2)) == NULL)
+        {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+
+        PyTuple_SET_ITEM(tuple, i, item);
+    }
+
+    return tuple;
+}
+
+
+static PyObject* ext_community_tuple(MRTentry* entry)
+{
+    PyObject* tuple = PyTuple_New(entry->nbExtCommunities);
+    PyObject* item;
+
+    if (!tuple)
+    {
+        return NULL;
+    }
+
+    for (int i = 0 ; i < entry->nbExtCommunities ; i++)
+    {
+        if ((item = PyLong_FromUnsignedLongLong(entry->extCommunities[i])) == NULL)
+        {
+            Py_DECREF(tuple);
+            return NULL;
+        }
+
+        PyTuple_SET_ITEM(tuple, i, item);
+    }
+
+    return tuple;
+}
+
+
+/* Sets an attribute of the message, and steals the reference to its value */
+static int set_attr(PyObject* msg, PyObject* name, PyObject* value)
+{
+    int ret;
+
+    if (!value)
+    {
+        return -1;
+    }
+
+    ret = PyObject_SetAttr(msg, name, value);
+    Py_DECREF(value);
+
+    return ret;
+}
+
+
+static PyObject* build_message(Reader* self, MRTentry* entry)
+{
+    PyObject* msg = self->msgClass->tp_new(self->msgClass, emptyTuple, NULL);
+    const char* asPath;
+    const char* communities;
+    char peerAddr[ADDR_STR_LEN];
+
+    if (!msg)
+    {
+        return NULL;
+    }
+
+    if ((asPath = MRTentry_as_path_str(entry)) == NULL || (communities = MRTentry_communities_str(entry)) == NULL)
+    {
+        Py_DECREF(msg);
+        return PyErr_NoMemory();
+    }
+
+    Addr_to_str(entry->afi, entry->peerAddr, peerAddr);
+
+    if (set_attr(msg, str_ts, PyFloat_FromDouble((double)entry->time + entry->time_ms / 1000000.0)) ||
+        set_attr(msg, str_type, PyLong_FromLong(entry->entryType)) ||
+        set_attr(msg, str_nlri, prefix_list(entry->pfxNLRI, entry->nbNLRI)) ||
+        set_attr(msg, str_withdraws, prefix_list(entry->pfxWithdraw, entry->nbWithdraw)) ||
+        set_attr(msg, str_origin, PyUnicode_FromString(entry->origin)) ||
+        set_attr(msg, str_nexthop, PyUnicode_FromString(entry->nextHop)) ||
+        set_attr(msg, str_as_path, PyUnicode_FromString(asPath)) ||
+        set_attr(msg, str_origin_asn, PyLong_FromUnsignedLong(MRTentry_origin_asn(entry))) ||
+        set_attr(msg, str_as_path_len, PyLong_FromLong(MRTentry_as_path_len(entry))) ||
+        set_attr(msg, str_communities, PyUnicode_FromString(communities)) ||
+        set_attr(msg, str_large_communities, large_community_tuple(entry)) ||
+        set_attr(msg, str_ext_communities, ext_community_tuple(entry)) ||
+        set_attr(msg, str_peer_asn, PyLong_FromUnsignedLong(entry->peer_asn)) ||
+        set_attr(msg, str_peer_addr, PyUnicode_FromString(peerAddr)) ||
+        set_attr(msg, str_msgType, PyUnicode_FromString(msg_type_str(entry))) ||
+        set_attr(msg, str_bgpType, PyLong_FromLong(entry->bgpType)))
+    {
+        Py_DECREF(msg);
+        return NULL;
+    }
+
+    return msg;
+}
+
+
+/* Sets a RuntimeError and returns 1 if the reader is being read by another thread */
+static int Reader_busy(Reader* self)
+{
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Reader is being read by another thread");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+static void Reader_close_dump(Reader* self)
+{
+    if (self->dump)
+    {
+        File_buf_close_dump(self->dump);
+        self->dump = NULL;
+    }
+
+    MRTmerge_free(self->merge);
+    self->merge = NULL;
+
+    self->nbEntries = 0;
+    self->actEntry = 0;
+}
+
+
+/* Criteria of the filter that take a list of values, with the function adding one value */
+static const struct
+{
+    const char* name;
+    int (*addAsn)(MRTfilter_t*, u_int32_t);
+    int (*addStr)(MRTfilter_t*, const char*);
+} filterLists[] = {
+    {"peer_asns",   MRTfilter_add_peer_asn,   NULL},
+    {"origin_asns", MRTfilter_add_origin_asn, NULL},
+    {"path_asns",   MRTfilter_add_path_asn,   NULL},
+    {"peer_addrs",  NULL, MRTfilter_add_peer_addr},
+    {"prefixes",    NULL, MRTfilter_add_prefix},
+};
+
+
+/* Adds every value of a Python iterable to one of the criteria of a filter */
+static int add_filter_values(MRTfilter_t* filter, PyObject* values, int list)
+{
+    PyObject* iter;
+    PyObject* item;
+    int ok = 1;
+
+    if ((iter = PyObject_GetIter(values)) == NULL)
+    {
+        return 0;
+    }
+
+    while (ok && (item = PyIter_Next(iter)) != NULL)
+    {
+        if (filterLists[list].addStr)
+        {
+            const char* str = PyUnicode_AsUTF8(item);
+
+            if (!str)
+            {
+                ok = 0;
+            }
+            else if (!filterLists[list].addStr(filter, str))
+            {
+                PyErr_Format(PyExc_ValueError, "Invalid value '%s' in filter '%s'", str, filterLists[list].name);
+                ok = 0;
+            }
+        }
+        else
+        {
+            unsigned long asn = PyLong_AsUnsignedLong(item);
+
+            if (PyErr_Occurred())
+            {
+                ok = 0;
+            }
+            else if (asn > 0xffffffffUL)
+            {
+                PyErr_Format(PyExc_ValueError, "Invalid ASN %lu in filter '%s'", asn, filterLists[list].name);
+                ok = 0;
+            }
+            else if (!filterLists[list].addAsn(filter, asn))
+            {
+                PyErr_NoMemory();
+                ok = 0;
+            }
+        }
+
+        Py_DECREF(item);
+    }
+
+    Py_DECREF(iter);
+
+    return ok && !PyErr_Occurred();
+}
+
+
+/* Builds the filter evaluated by the parser from the time range and the dict of filters (see
+ * broker.open_dumper). Returns 0 with an exception set on error. *filter is set to NULL if
+ * nothing needs to be filtered */
+static int build_filter(MRTfilter_t** filter, unsigned long fromTime, unsigned long untilTime, int monotonic, PyObject* filters)
+{
+    PyObject* key;
+    PyObject* value;
+    Py_ssize_t pos = 0;
+
+    *filter = NULL;
+
+    if (fromTime == 0 && untilTime >= 0xffffffffUL && (filters == NULL || filters == Py_None))
+    {
+        return 1;
+    }
+
+    if ((*filter = MRTfilter_new()) == NULL)
+    {
+        PyErr_NoMemory();
+        return 0;
+    }
+
+    MRTfilter_set_time(*filter, fromTime, untilTime > 0xffffffffUL ? 0xffffffffUL : untilTime);
+    MRTfilter_set_monotonic(*filter, monotonic);
+
+    if (filters == NULL || filters == Py_None)
+    {
+        return 1;
+    }
+
+    if (!PyDict_Check(filters))
+    {
+        PyErr_SetString(PyExc_TypeError, "filters must be a dict");
+        goto error;
+    }
+
+    while (PyDict_Next(filters, &pos, &key, &value))
+    {
+        const char* name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+
+        if (!name)
+        {
+            PyErr_SetString(PyExc_TypeError, "filter names must be strings");
+            goto error;
+        }
+
+        if (!strcmp(name, "msg_types"))
+        {
+            const char* types = PyUnicode_AsUTF8(value);
+
+            if (!types)
+            {
+                goto error;
+            }
+
+            if (!MRTfilter_set_types(*filter, types))
+            {
+                PyErr_Format(PyExc_ValueError, "Invalid message types '%s'", types);
+                goto error;
+            }
+        }
+        else
+        {
+            size_t list = 0;
+
+            while (list < sizeof(filterLists) / sizeof(filterLists[0]) && strcmp(name, filterLists[list].name))
+            {
+                list++;
+            }
+
+            if (list == sizeof(filterLists) / sizeof(filterLists[0]))
+            {
+                PyErr_Format(PyExc_ValueError, "Unknown filter '%s'", name);
+                goto error;
+            }
+
+            if (!add_filter_values(*filter, value, list))
+            {
+                goto error;
+            }
+        }
+    }
+
+    return 1;
+
+error:
+    MRTfilter_free(*filter);
+    *filter = NULL;
+    return 0;
+}
+
+
+/* Opens a file (or the stream read from fd, if set) with its filter, decompression and parsing
+ * threads. Returns NULL with an exception set on error */
+static File_buf_t* open_dump(const char* filename, int fd, unsigned long fromTime, unsigned long untilTime,
+                             int threads, int parseThreads, PyObject* filters, int monotonic)
+{
+    File_buf_t* dump;
+    MRTfilter_t* filter;
+
+    if (!build_filter(&filter, fromTime, untilTime, monotonic, filters))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    /* With a file descriptor, the file is read as a stream named after filename. Not all the
+     * failures set errno */
+    errno = 0;
+    if ((dump = (fd < 0) ? File_buf_create(filename) : File_buf_create_fd(fd, filename)) == NULL)
+    {
+        MRTfilter_free(filter);
+        if (errno)
+        {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
+        }
+        else
+        {
+            PyErr_Format(PyExc_OSError, "Unable to open file %s", filename);
+        }
+        return NULL;
+    }
+
+    /* The filter is evaluated by the parser, before the entries reach Python */
+    if (filter)
+    {
+        File_buf_set_filter(dump, filter);
+    }
+
+    if (threads > 0)
+    {
+        File_buf_set_decompress_threads(dump, threads);
+    }
+
+    /* Start from the sidecar index of the file (if any), before the parsing threads read it */
+    if (fromTime > 0 && MRTindex_seek(dump, fromTime) < 0)
+    {
+        File_buf_close_dump(dump);
+        PyErr_Format(PyExc_OSError, "Unable to seek in file %s", filename);
+        return NULL;
+    }
+
+    if (parseThreads > 0)
+    {
+        File_buf_set_parse_threads(dump, parseThreads);
+    }
+
+    return dump;
+}
+
+
+/* Closes the file descriptors of the (name, fd) items of a list of files from a given item, that
+ * will not be opened */
+static void close_fds(PyObject* seq, Py_ssize_t from)
+{
+    for (Py_ssize_t i = from ; i < PySequence_Fast_GET_SIZE(seq) ; i++)
+    {
+        PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+        PyObject* fd;
+
+        if (PyTuple_Check(item) && PyTuple_GET_SIZE(item) == 2 && PyLong_Check(fd = PyTuple_GET_ITEM(item, 1)))
+        {
+            close(PyLong_AsLong(fd));
+        }
+    }
+}
+
+
+static int Reader_init(Reader* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = {"filename", "msg_class", "from_time", "until_time", "threads", "parse_threads", "filters", "monotonic", "fd", NULL};
+    PyObject* files;
+    PyObject* msgClass;
+    PyObject* filters = NULL;
+    PyObject* seq;
+    File_buf_t* dump;
+    unsigned long fromTime = 0;
+    unsigned long untilTime = 0xffffffffUL;
+    int threads = 0;
+    int parseThreads = 0;
+    int monotonic = 0;
+    int fd = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO!|kkiiOpi", kwlist, &files, &PyType_Type, &msgClass,
+                                     &fromTime, &untilTime, &threads, &parseThreads, &filters, &monotonic, &fd))
+    {
+        return -1;
+    }
+
+    if (Reader_busy(self))
+    {
+        /* The given file descriptors are owned by the reader even if it can not open them */
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if ((PyList_Check(files) || PyTuple_Check(files)) && (seq = PySequence_Fast(files, "")) != NULL)
+        {
+            close_fds(seq, 0);
+            Py_DECREF(seq);
+        }
+        return -1;
+    }
+
+    Reader_close_dump(self);
+    Py_XDECREF(self->msgClass);
+    Py_INCREF(msgClass);
+    self->msgClass = (PyTypeObject*)msgClass;
+
+    Py_XINCREF(filters);
+    Py_XSETREF(self->filters, filters);
+    self->fromTime = fromTime;
+    self->untilTime = untilTime;
+    self->threads = threads;
+    self->parseThreads = parseThreads;
+    self->monotonic = monotonic;
+
+    if (PyUnicode_Check(files))
+    {
+        const char* filename = PyUnicode_AsUTF8(files);
+
+        if (!filename || (self->dump = open_dump(filename, fd, fromTime, untilTime, threads, parseThreads, filters, monotonic)) == NULL)
+        {
+            return -1;
+        }
+
+        return 0;
+    }
+
+    /* A list of files (names, or (name, fd) for streams) is merged by timestamp */
+    if ((seq = PySequence_Fast(files, "filename must be a str or a list of files")) == NULL)
+    {
+        return -1;
+    }
+
+    if ((self->merge = MRTmerge_new()) == NULL)
+    {
+        close_fds(seq, 0);
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0 ; i < PySequence_Fast_GET_SIZE(seq) ; i++)
+    {
+        PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+        const char* filename;
+        int itemFd = -1;
+
+        if (PyUnicode_Check(item))
+        {
+            filename = PyUnicode_AsUTF8(item);
+        }
+        else if (!PyArg_ParseTuple(item, "si;files must be names or (name, fd) tuples", &filename, &itemFd))
+        {
+            filename = NULL;
+        }
+
+        if (!filename || (dump = open_dump(filename, itemFd, fromTime, untilTime, threads, parseThreads, filters, monotonic)) == NULL)
+        {
+            close_fds(seq, filename ? i + 1 : i);
+            Py_DECREF(seq);
+            Reader_close_dump(self);
+            return -1;
+        }
+
+        if (!MRTmerge_add(self->merge, dump))
+        {
+            File_buf_close_dump(dump);
+            close_fds(seq, i + 1);
+            Py_DECREF(seq);
+            Reader_close_dump(self);
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    Py_DECREF(seq);
+
+    return 0;
+}
+
+
+static void Reader_dealloc(Reader* self)
+{
+    Reader_close_dump(self);
+    Py_XDECREF(self->msgClass);
+    Py_XDECREF(self->filters);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+
+static PyObject* Reader_iternext(Reader* self)
+{
+    MRTentry* entry;
+
+    if (Reader_busy(self))
+    {
+        return NULL;
+    }
+
+    /* The entries of a merger are only valid until the next one is read */
+    while (self->merge)
+    {
+        self->busy = 1;
+        Py_BEGIN_ALLOW_THREADS
+        entry = MRTmerge_next(self->merge);
+        Py_END_ALLOW_THREADS
+        self->busy = 0;
+
+        if (!entry)
+        {
+            return NULL;
+        }
+
+        if (is_bgp_message(entry))
+        {
+            return build_message(self, entry);
+        }
+    }
+
+    if (!self->dump)
+    {
+        return NULL;
+    }
+
+    for (;;)
+    {
+        if (self->actEntry == self->nbEntries)
+        {
+            if (self->dump->eof)
+            {
+                return NULL;
+            }
+
+            self->busy = 1;
+            Py_BEGIN_ALLOW_THREADS
+            self->nbEntries = Read_next_mrt_batch(self->dump, self->entries, READER_BATCH_ENTRIES, READER_BATCH_BYTES);
+            Py_END_ALLOW_THREADS
+            self->busy = 0;
+
+            self->actEntry = 0;
+            continue;
+        }
+
+        entry = self->entries[self->actEntry++];
+
+        if (is_bgp_message(entry))
+        {
+            return build_message(self, entry);
+        }
+    }
+}
+
+
+static PyObject* Reader_close(Reader* self, PyObject* Py_UNUSED(ignored))
+{
+    if (Reader_busy(self))
+    {
+        return NULL;
+    }
+
+    Reader_close_dump(self);
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* Reader_add(Reader* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = {"filename", "fd", NULL};
+    const char* filename;
+    File_buf_t* dump;
+    int fd = -1;
+    int added;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|i", kwlist, &filename, &fd))
+    {
+        return NULL;
+    }
+
+    if (Reader_busy(self) || !self->merge)
+    {
+        if (!PyErr_Occurred())
+        {
+            PyErr_SetString(PyExc_ValueError, "Files can only be added to a reader of a list of files");
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    if ((dump = open_dump(filename, fd, self->fromTime, self->untilTime, self->threads, self->parseThreads,
+                          self->filters, self->monotonic)) == NULL)
+    {
+        return NULL;
+    }
+
+    /* The first entry of the file is read right away if the merger is being read */
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    added = MRTmerge_add(self->merge, dump);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    if (!added)
+    {
+        File_buf_close_dump(dump);
+        return PyErr_NoMemory();
+    }
+
+    Py_RETURN_NONE;
+}
+
+
+static PyObject* Reader_get_horizon(Reader* self, void* closure)
+{
+    return PyLong_FromUnsignedLong(self->merge ? self->merge->horizon : 0);
+}
+
+
+static int Reader_set_horizon(Reader* self, PyObject* value, void* closure)
+{
+    unsigned long horizon;
+
+    if (!value || !self->merge)
+    {
+        PyErr_SetString(PyExc_ValueError, "The horizon can only be set on a reader of a list of files");
+        return -1;
+    }
+
+    horizon = PyLong_AsUnsignedLong(value);
+    if (PyErr_Occurred())
+    {
+        return -1;
+    }
+
+    if (horizon > 0xffffffffUL)
+    {
+        PyErr_SetString(PyExc_OverflowError, "The horizon must be a 32-bit timestamp");
+        return -1;
+    }
+
+    if (Reader_busy(self))
+    {
+        return -1;
+    }
+
+    MRTmerge_set_horizon(self->merge, horizon);
+
+    return 0;
+}
+
+
+static PyObject* Reader_get_eof(Reader* self, void* closure)
+{
+    if (self->merge)
+    {
+        return PyBool_FromLong(self->merge->eof);
+    }
+
+    return PyBool_FromLong(!self->dump || (self->dump->eof && self->actEntry == self->nbEntries));
+}
+
+
+static PyMethodDef Reader_methods[] = {
+    {"close", (PyCFunction)Reader_close, METH_NOARGS, "Close the MRT file."},
+    {"add", (PyCFunction)(void(*)(void))Reader_add, METH_VARARGS | METH_KEYWORDS,
+     "add(filename, fd=-1)\n\nAdd a file (or a stream) to a reader of a list of files, with its options, even while it is read."},
+    {NULL}
+};
+
+
+static PyGetSetDef Reader_getset[] = {
+    {"eof", (getter)Reader_get_eof, NULL, "True once all the messages have been read.", NULL},
+    {"horizon", (getter)Reader_get_horizon, (setter)Reader_set_horizon,
+     "Timestamp from which the messages of a reader of a list of files are held back (the iteration stops\n"
+     "there without eof being set), until the files starting there are added. 0 to hold none.", NULL},
+    {NULL}
+};
+
+
+static PyTypeObject ReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "pygillstream._gillstream.Reader",
+    .tp_doc = "Reader(filename, msg_class, from_time=0, until_time=2**32-1, threads=0, parse_threads=0, filters=None, monotonic=False, fd=-1)\n\n"
+              "Iterator over the BGP messages (instances of msg_class) of an MRT file, or of the MRT stream read\n"
+              "from fd (closed with the reader), whose compression is given by the ending of filename. If filename\n"
+              "is a list of files (names, or (name, fd) tuples for streams), their messages are merged by timestamp,\n"
+              "and more files can be added while they are read (see add and horizon).",
+    .tp_basicsize = sizeof(Reader),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Reader_init,
+    .tp_dealloc = (destructor)Reader_dealloc,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc)Reader_iternext,
+    .tp_methods = Reader_methods,
+    .tp_getset = Reader_getset,
+};
+
+
+static struct PyModuleDef gillstream_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_gillstream",
+    .m_doc = "Native MRT reader for pygillstream, built on libbgpgill.",
+    .m_size = -1,
+};
+
+
+#define INTERN(var, name)                                   \
+    if ((var = PyUnicode_InternFromString(name)) == NULL)   \
+    {                                                       \
+        return NULL;                                        \
+    }
+
+PyMODINIT_FUNC PyInit__gillstream(void)
+{
+    PyObject* module;
+
+    INTERN(str_ts, "ts")
+    INTERN(str_type, "type")
+    INTERN(str_nlri, "nlri")
+    INTERN(str_withdraws, "withdraws")
+    INTERN(str_origin, "origin")
+    INTERN(str_nexthop, "nexthop")
+    INTERN(str_as_path, "as_path")
+    INTERN(str_origin_asn, "origin_asn")
+    INTERN(str_as_path_len, "as_path_len")
+    INTERN(str_communities, "communities")
+    INTERN(str_large_communities, "large_communities")
+    INTERN(str_ext_communities, "ext_communities")
+    INTERN(str_peer_asn, "peer_asn")
+    INTERN(str_peer_addr, "peer_addr")
+    INTERN(str_msgType, "msgType")
+    INTERN(str_bgpType, "bgpType")
+
+    if ((emptyTuple = PyTuple_New(0)) == NULL || PyType_Ready(&ReaderType) < 0)
+    {
+        return NULL;
+    }
+
+    if ((module = PyModule_Create(&gillstream_module)) == NULL)
+    {
+        return NULL;
+    }
+
+    Py_INCREF(&ReaderType);
+    if (PyModule_AddObject(module, "Reader", (PyObject*)&ReaderType) < 0)
+    {
+        Py_DECREF(&ReaderType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
@@ -7,236 +7,1670 @@ import time
 import datetime
 import json
 import os
+import bz2
+import fcntl
+import hashlib
+import tempfile
 from requests.exceptions import HTTPError, ConnectionError, Timeout
+import socket
+import collections
+import heapq
+import marshal
+import pickle
+import operator
+import threading
+import multiprocessing
+import signal
+from concurrent.futures import ThreadPoolExecutor
 import ctypes
-from ctypes import c_int, c_uint32, c_uint16, c_char, c_void_p, POINTER, Structure
+from ctypes import c_int, c_uint32, c_uint16, c_uint8, c_char, c_char_p, c_void_p, POINTER, Structure
+
+# Native reader, built along with libbgpgill (see setup.py). Fall back on ctypes if missing.
+try:
+    from . import _gillstream
+except ImportError:
+    _gillstream = None
 
 
 BGPDUMP_MAX_FILE_LEN	= 1024
 BGPDUMP_MAX_AS_PATH_LEN	= 2000
-MAX_NB_PREFIXES         = 2048
-MAX_ATTR                = 4096
 
-BGP_TYPE_ZEBRA_BGP			= 16
-BGP_TYPE_ZEBRA_BGP_ET       = 17
-BGP_TYPE_TABLE_DUMP_V2      = 13
+BGP_TYPE_ZEBRA_BGP			= 16
+BGP_TYPE_ZEBRA_BGP_ET       = 17
+BGP_TYPE_TABLE_DUMP_V2      = 13
+
+BGP_SUBTYPE_RIB_IPV4_UNICAST = 2
+BGP_SUBTYPE_RIB_IPV6_UNICAST = 4
+
+BGP_IPV4_AFI = 1
+BGP_IPV6_AFI = 2
+
+# Maximum number of MRT entries, and of bytes of MRT records, read per call to the C library
+MRT_BATCH_ENTRIES = 4096
+MRT_BATCH_BYTES   = 4 * 1024 * 1024
+
+
+BGP_TYPE_OPEN               = 1
+BGP_TYPE_KEEPALIVE          = 4
+BGP_TYPE_UPDATE             = 2
+BGP_TYPE_NOTIFICATION       = 3
+BGP_TYPE_STATE_CHANGE       = 5
+
+
+GILLSTREAM_LIBRARY_PATH='/usr/local/lib/'
+
+# Endpoint of the GILL file broker
+GILL_BROKER_URL = "http://bgproutes.io:7000/broker/broker"
+
+# Number of files downloaded ahead of the file being parsed by a GillStream
+GILL_PREFETCH_FILES = 2
+
+# Size of the chunks of the HTTP responses written to the pipe of a streamed file, or to the cache
+GILL_STREAM_CHUNK_BYTES = 64 * 1024
+
+# Default maximum size of the local cache of the downloaded files (see FileCache)
+GILL_CACHE_BYTES = 8 * 1024 * 1024 * 1024
+
+# Age (in seconds) after which a partial download found in the cache is deemed abandoned
+GILL_CACHE_PART_TIMEOUT = 3600
+
+# Number of messages per batch sent by the worker processes of a parallel GillStream, and number
+# of batches that can wait to be read per worker
+GILL_PARALLEL_BATCH = 4096
+GILL_PARALLEL_QUEUE_BATCHES = 4
+
+# Attributes of a BGPmessage, in the order of the tuples of the batches sent by the workers
+BGP_MESSAGE_FIELDS = ("ts", "type", "nlri", "withdraws", "origin", "nexthop", "as_path", "origin_asn", "as_path_len",
+                      "communities", "large_communities", "ext_communities", "peer_asn", "peer_addr", "msgType", "bgpType")
+
+
+# Import CFRFILE structure from C library
+class CFRFILE(Structure):
+    _fields_ = [
+        ("format", c_int),       # 0 = not open, 1 = uncompressed, 2 = bzip2, 3 = gzip
+        ("eof", c_int),          # 0 = not EOF
+        ("closed", c_int),       # indicates whether fclose has been called, 0 = not yet
+        ("error1", c_int),       # errors from the system, 0 = no error
+        ("error2", c_int),       # for error messages from the compressor
+        ("data1", c_void_p), # system file handle (FILE *)
+        ("data2", c_void_p),     # additional handle(s) for the compressor
+        ("bz2_stream_end", c_int), # True when a bz2 stream has ended
+        ("bz2_mt", c_void_p),    # multi-threaded bzip2 decoder (if any)
+        ("buf", c_void_p),       # read buffer
+        ("buf_size", ctypes.c_size_t), # size of the read buffer
+        ("buf_pos", ctypes.c_size_t),  # position of the first byte not consumed yet
+        ("buf_len", ctypes.c_size_t),  # number of valid bytes in the read buffer
+        ("raw_eof", c_int),      # True when the underlying file/compressor is exhausted
+        ("mapped", c_int),       # True when the (uncompressed) file is memory-mapped
+        ("buf_offset", ctypes.c_uint64), # offset of buf[0] in the (decompressed) data
+        ("threads", c_int)       # number of bzip2 decompression threads
+    ]
+
+
+# Import MRTribCursor_t structure from C library
+class MRT_RIB_CURSOR_T(Structure):
+    _fields_ = [
+        ("buffer", c_void_p),
+        ("len", c_int),
+        ("off", c_int),
+        ("nbEntries", c_uint16),
+        ("actEntry", c_uint16)
+    ]
+
+
+# Import RIB_PEER_INDEX structure from C library
+class RIB_PEER_INDEX_T(Structure):
+    _fields_ = [
+        ("asn", c_uint32),
+        ("afi", c_uint8),
+        ("addr", c_uint8 * 16),
+        ("kept", c_uint8)
+    ]
+
+
+class FILE_BUF_T(Structure):
+    _fields_ = [
+        ("f", POINTER(CFRFILE)),  # Pointer to CFRFILE
+        ("f_type", c_int),        # Integer representing the file type
+        ("eof", c_int),           # End of file flag
+        ("filename", c_char * BGPDUMP_MAX_FILE_LEN),  # Filename array of length BGPDUMP_MAX_FILE_LEN
+        ("parsed", c_int),        # Indicates if the file is parsed
+        ("parsed_ok", c_int),     # Indicates if the parsing was successful
+        ("index", POINTER(RIB_PEER_INDEX_T)),  # Peer table of the RIB peer index
+        ("actPeerIdx", c_int),
+        ("sizePeerIdx", c_int),
+        ("actEntry", ctypes.c_void_p),
+        ("arena", ctypes.c_void_p),
+        ("recBuf", ctypes.c_void_p),
+        ("recBufSize", ctypes.c_size_t),
+        ("recBufHighWater", c_uint32),
+        ("pipeline", c_void_p),     # Pipeline of parsing threads (if any)
+        ("filter", c_void_p),       # Filter applied by the parser (if any)
+        ("filtered", c_int),        # Number of records skipped by the filter
+        ("attrCache", c_void_p),    # Cache of the interned RIB attributes
+        ("ribCursor", MRT_RIB_CURSOR_T),  # Cursor over the RIB entries of the current record
+        ("streamed", c_int)         # Set if the data is read from a stream
+    ]
+
+
+# Import Prefix_t structure from C library
+class PREFIX_T(Structure):
+    _fields_ = [
+        ("afi", c_uint8),
+        ("pfxLen", c_uint8),
+        ("pfx", c_uint8 * 16)
+    ]
+
+    def __str__(self):
+        if self.afi == BGP_IPV6_AFI:
+            addr = socket.inet_ntop(socket.AF_INET6, bytes(self.pfx))
+        else:
+            addr = socket.inet_ntop(socket.AF_INET, bytes(self.pfx[:4]))
+
+        return "{}/{}".format(addr, self.pfxLen)
+
+
+class LARGE_COMMUNITY_T(Structure):
+    _fields_ = [
+        ("global_", c_uint32),
+        ("local1", c_uint32),
+        ("local2", c_uint32)
+    ]
+
+
+class MRT_PEER_T(Structure):
+    _fields_ = [
+        ("asn", c_uint32),
+        ("afi", c_uint8),
+        ("bin", c_uint8 * 16),
+        ("addr", c_char * 64)
+    ]
+
+
+class MRT_COLUMNS_T(Structure):
+    _fields_ = [
+        ("nbRows", ctypes.c_size_t),
+        ("time", POINTER(c_uint32)),
+        ("timeMs", POINTER(c_uint32)),
+        ("peerId", POINTER(c_uint32)),
+        ("msgType", POINTER(c_uint8)),
+        ("origin", POINTER(c_uint8)),
+        ("nlriOffsets", POINTER(ctypes.c_uint64)),
+        ("nlri", POINTER(PREFIX_T)),
+        ("nbNLRI", ctypes.c_size_t),
+        ("withdrawOffsets", POINTER(ctypes.c_uint64)),
+        ("withdraws", POINTER(PREFIX_T)),
+        ("nbWithdraws", ctypes.c_size_t),
+        ("asPathOffsets", POINTER(ctypes.c_uint64)),
+        ("asPath", POINTER(c_uint32)),
+        ("nbAsPath", ctypes.c_size_t),
+        ("communityOffsets", POINTER(ctypes.c_uint64)),
+        ("communities", POINTER(c_uint32)),
+        ("nbCommunities", ctypes.c_size_t),
+        ("largeCommunityOffsets", POINTER(ctypes.c_uint64)),
+        ("largeCommunities", POINTER(LARGE_COMMUNITY_T)),
+        ("nbLargeCommunities", ctypes.c_size_t),
+        ("extCommunityOffsets", POINTER(ctypes.c_uint64)),
+        ("extCommunities", POINTER(ctypes.c_uint64)),
+        ("nbExtCommunities", ctypes.c_size_t),
+        ("peers", POINTER(MRT_PEER_T)),
+        ("nbPeers", c_uint32),
+        ("sizeRows", ctypes.c_size_t),
+        ("sizeNLRI", ctypes.c_size_t),
+        ("sizeWithdraws", ctypes.c_size_t),
+        ("sizeAsPath", ctypes.c_size_t),
+        ("sizeCommunities", ctypes.c_size_t),
+        ("sizeLargeCommunities", ctypes.c_size_t),
+        ("sizeExtCommunities", ctypes.c_size_t),
+        ("sizePeers", c_uint32),
+        ("peerHash", POINTER(c_uint32)),
+        ("peerHashSize", c_uint32)
+    ]
+
+
+class MRT_ENTRY(Structure):
+    _fields_ = [
+        ("entryType", c_uint16),
+        ("entrySubType", c_uint16),
+        ("entryLength", c_uint32),
+        ("bgpType", c_uint16),
+        ("peer_asn", c_uint32),
+        ("afi", c_uint16),
+        ("peerIndex", c_uint16),
+        ("peerAddr", c_uint8 * 16),
+        ("time", c_uint32),
+        ("time_ms", c_uint32),
+        ("nbWithdraw", c_uint16),
+        ("nbNLRI", c_uint16),
+        ("sizeWithdraw", c_uint16),
+        ("sizeNLRI", c_uint16),
+        ("pfxNLRI", POINTER(PREFIX_T)),
+        ("pfxWithdraw", POINTER(PREFIX_T)),
+        ("nextHop", c_char * 64),
+        ("asPathSegs", ctypes.c_void_p),
+        ("asPathAsn", POINTER(c_uint32)),
+        ("nbAsPathSegs", c_uint16),
+        ("nbAsPathAsn", c_uint16),
+        ("sizeAsPathSegs", c_uint16),
+        ("sizeAsPathAsn", c_uint16),
+        ("asPath", c_char_p),
+        ("asPathSize", c_uint32),
+        ("asPathFormatted", c_uint8),
+        ("stdCommunities", POINTER(c_uint32)),
+        ("largeCommunities", POINTER(LARGE_COMMUNITY_T)),
+        ("extCommunities", POINTER(ctypes.c_uint64)),
+        ("nbStdCommunities", c_uint16),
+        ("nbLargeCommunities", c_uint16),
+        ("nbExtCommunities", c_uint16),
+        ("sizeStdCommunities", c_uint16),
+        ("sizeLargeCommunities", c_uint16),
+        ("sizeExtCommunities", c_uint16),
+        ("communities", c_char_p),
+        ("communitiesSize", c_uint32),
+        ("communitiesFormatted", c_uint8),
+        ("origin", c_char * 16),
+        ("attrs", ctypes.c_void_p),
+        ("dumper", ctypes.POINTER(FILE_BUF_T)),
+        ("attrCache", ctypes.c_void_p),
+        ("arena", ctypes.c_void_p),
+        ("next", ctypes.c_void_p),
+        ("prev", ctypes.c_void_p)
+    ]
+
+
+# Import MRTmerge_t structure from C library
+class MRT_MERGE_T(Structure):
+    _fields_ = [
+        ("dumps", ctypes.POINTER(ctypes.POINTER(FILE_BUF_T))),  # File dumpers merged
+        ("nbDumps", c_int),
+        ("sizeDumps", c_int),
+        ("heads", ctypes.POINTER(ctypes.POINTER(MRT_ENTRY))),   # Current entry of each dumper
+        ("heap", ctypes.POINTER(c_int)),                        # Min-heap of the dumpers by timestamp
+        ("heapSize", c_int),
+        ("last", c_int),
+        ("started", c_int),
+        ("eof", c_int),
+        ("horizon", c_uint32),                                  # Time from which the entries are held back
+        ("ranks", ctypes.POINTER(c_int))                        # Rank of each dumper, for equal timestamps
+    ]
+
+
+
+
+
+class BGPmessage:
+    """
+    Structre that represents a BGP message
+
+    Attributes:
+        ts (float): UNIX timestamp at which the BGP message has been collected by the VP.
+        type (int): Type of MRT entry (e.g., BGP4MP, BGP4MP_ET, ..)
+        nlri (list): List of all prefixes (in string mode) that have been announced in the
+        current BGP message.
+        withdraws (list): List of all prefixes (in string mode) that have been withdrawn in
+        the current BGP message.
+        origin (str): String representation of the origin BGP attribute.
+        nexthop (str): String representation of the nethop BGP attribute.
+        as_path (str): String representation of the AS path BGP attribute.
+        origin_asn (int): Last ASN of the AS path (0 if unknown, e.g., if the path ends with
+        an AS set of several ASNs).
+        as_path_len (int): Length of the AS path, an AS set counting for one.
+        communities (str): String representation of the Community values BGP attribute.
+        large_communities (tuple): Large communities (RFC 8092), as (global, local1, local2)
+        tuples.
+        ext_communities (tuple): Extended communities (RFC 4360), as 64-bit integers.
+        peer_asn (str): AS number of the VP from which we received the message.
+        peer_addr (str): String represntation of the IP address of the BGP peer from which
+        we received the message.
+        msgType (str): String representation of the type of BGP message (e.g., UPDATE, OPEN,...).
+        bgpType (int): Integer value of the type of BGP message.
+    """
+    def __init__(self, mrtentry):
+        self.ts          = 0.0
+        self.type        = 0
+        self.nlri        = list()
+        self.withdraws   = list()
+        self.origin      = ""
+        self.nexthop     = ""
+        self.as_path     = ""
+        self.origin_asn  = 0
+        self.as_path_len = 0
+        self.communities = ""
+        self.large_communities = ()
+        self.ext_communities = ()
+        self.peer_asn    = 0
+        self.peer_addr   = ""
+        self.msgType     = "Unknown"
+        self.bgpType     = 0
+
+        self.type = mrtentry.contents.entryType
+        self.origin = mrtentry.contents.origin.decode()
+        self.as_path = (mylib.MRTentry_as_path_str(mrtentry) or b"").decode()
+        self.origin_asn = mylib.MRTentry_origin_asn(mrtentry)
+        self.as_path_len = mylib.MRTentry_as_path_len(mrtentry)
+        self.communities = (mylib.MRTentry_communities_str(mrtentry) or b"").decode()
+        if mrtentry.contents.nbLargeCommunities:
+            self.large_communities = tuple((c.global_, c.local1, c.local2) for c in mrtentry.contents.largeCommunities[:mrtentry.contents.nbLargeCommunities])
+        if mrtentry.contents.nbExtCommunities:
+            self.ext_communities = tuple(mrtentry.contents.extCommunities[:mrtentry.contents.nbExtCommunities])
+        self.nexthop = mrtentry.contents.nextHop.decode()
+        self.ts = mrtentry.contents.time + mrtentry.contents.time_ms / 1000000
+        self.peer_asn = mrtentry.contents.peer_asn
+        if mrtentry.contents.afi == BGP_IPV6_AFI:
+            self.peer_addr = socket.inet_ntop(socket.AF_INET6, bytes(mrtentry.contents.peerAddr))
+        else:
+            self.peer_addr = socket.inet_ntop(socket.AF_INET, bytes(mrtentry.contents.peerAddr[:4]))
+        self.bgpType = mrtentry.contents.bgpType
+
+        # Setup MSG Type
+        if self.type == BGP_TYPE_ZEBRA_BGP or self.type == BGP_TYPE_ZEBRA_BGP_ET:
+            if self.bgpType == BGP_TYPE_OPEN:
+                self.msgType = "O"
+            elif self.bgpType == BGP_TYPE_UPDATE:
+                self.msgType = "U"
+            elif self.bgpType == BGP_TYPE_NOTIFICATION:
+                self.msgType = "N"
+            elif self.bgpType == BGP_TYPE_KEEPALIVE:
+                self.msgType = "K"
+            elif self.bgpType == BGP_TYPE_STATE_CHANGE:
+                self.msgType = "S"
+
+        elif self.type == BGP_TYPE_TABLE_DUMP_V2:
+            self.msgType = "R"
+
+
+        for i in range(0, mrtentry.contents.nbWithdraw):
+            self.withdraws.append(str(mrtentry.contents.pfxWithdraw[i]))
+
+        for i in range(0, mrtentry.contents.nbNLRI):
+            self.nlri.append(str(mrtentry.contents.pfxNLRI[i]))
+
+
+    
+    def __str__(self):
+        res = "{}|{}|{}|{}|{}|{}|{}|{}|{}|{}".format(self.msgType, self.ts, ",".join(self.nlri), ",".join(self.withdraws), self.origin, self.nexthop, self.as_path, self.communities, self.peer_asn, self.peer_addr)
+
+        return res
+
+mylib = ctypes.CDLL("{}/libbgpgill.so".format(GILLSTREAM_LIBRARY_PATH), use_errno=True)
+
+mylib.File_buf_create.argtypes = (ctypes.c_char_p,)
+mylib.File_buf_create.restype  = ctypes.POINTER(FILE_BUF_T)
+
+mylib.File_buf_create_fd.argtypes = (c_int, ctypes.c_char_p)
+mylib.File_buf_create_fd.restype  = ctypes.POINTER(FILE_BUF_T)
+
+mylib.File_buf_close_dump.argtypes = (ctypes.POINTER(FILE_BUF_T),)
+mylib.File_buf_close_dump.restype  = None
+
+mylib.File_buf_set_decompress_threads.argtypes = (ctypes.POINTER(FILE_BUF_T), ctypes.c_int)
+mylib.File_buf_set_decompress_threads.restype  = ctypes.c_int
+
+mylib.File_buf_set_parse_threads.argtypes = (ctypes.POINTER(FILE_BUF_T), ctypes.c_int)
+mylib.File_buf_set_parse_threads.restype  = ctypes.c_int
+
+mylib.File_buf_set_filter.argtypes = (ctypes.POINTER(FILE_BUF_T), c_void_p)
+mylib.File_buf_set_filter.restype  = ctypes.c_int
+
+mylib.MRTindex_build.argtypes = (ctypes.c_char_p, ctypes.c_char_p)
+mylib.MRTindex_build.restype  = c_int
+
+mylib.MRTindex_seek.argtypes = (ctypes.POINTER(FILE_BUF_T), c_uint32)
+mylib.MRTindex_seek.restype  = c_int
+
+mylib.MRTfilter_new.argtypes = ()
+mylib.MRTfilter_new.restype  = c_void_p
+
+mylib.MRTfilter_set_time.argtypes = (c_void_p, c_uint32, c_uint32)
+mylib.MRTfilter_set_time.restype  = None
+
+mylib.MRTfilter_set_monotonic.argtypes = (c_void_p, c_int)
+mylib.MRTfilter_set_monotonic.restype  = None
+
+mylib.MRTfilter_set_types.argtypes = (c_void_p, ctypes.c_char_p)
+mylib.MRTfilter_set_types.restype  = c_int
+
+for fct in (mylib.MRTfilter_add_peer_asn, mylib.MRTfilter_add_origin_asn, mylib.MRTfilter_add_path_asn):
+    fct.argtypes = (c_void_p, c_uint32)
+    fct.restype  = c_int
+
+for fct in (mylib.MRTfilter_add_peer_addr, mylib.MRTfilter_add_prefix):
+    fct.argtypes = (c_void_p, ctypes.c_char_p)
+    fct.restype  = c_int
+
+mylib.MRTfilter_free.argtypes = (c_void_p,)
+mylib.MRTfilter_free.restype  = None
+
+mylib.Read_next_mrt_entry.argtypes = (ctypes.POINTER(FILE_BUF_T),)
+mylib.Read_next_mrt_entry.restype  = ctypes.POINTER(MRT_ENTRY)
+
+mylib.Read_next_mrt_batch.argtypes = (ctypes.POINTER(FILE_BUF_T), ctypes.POINTER(ctypes.POINTER(MRT_ENTRY)), ctypes.c_int, ctypes.c_size_t)
+mylib.Read_next_mrt_batch.restype  = ctypes.c_int
+
+mylib.MRTentry_free.argtypes = (ctypes.POINTER(MRT_ENTRY),)
+mylib.MRTentry_free.restype  = None
+
+mylib.MRTentry_as_path_str.argtypes = (ctypes.POINTER(MRT_ENTRY),)
+mylib.MRTentry_as_path_str.restype  = ctypes.c_char_p
+
+mylib.MRTentry_origin_asn.argtypes = (ctypes.POINTER(MRT_ENTRY),)
+mylib.MRTentry_origin_asn.restype  = c_uint32
+
+mylib.MRTentry_as_path_len.argtypes = (ctypes.POINTER(MRT_ENTRY),)
+mylib.MRTentry_as_path_len.restype  = c_int
+
+mylib.MRTentry_as_path_contains.argtypes = (ctypes.POINTER(MRT_ENTRY), c_uint32)
+mylib.MRTentry_as_path_contains.restype  = c_int
+
+mylib.MRTentry_communities_str.argtypes = (ctypes.POINTER(MRT_ENTRY),)
+mylib.MRTentry_communities_str.restype  = ctypes.c_char_p
+
+mylib.MRTentry_has_community.argtypes = (ctypes.POINTER(MRT_ENTRY), c_uint32, c_uint32)
+mylib.MRTentry_has_community.restype  = c_int
+
+mylib.MRTentry_has_large_community.argtypes = (ctypes.POINTER(MRT_ENTRY), LARGE_COMMUNITY_T, LARGE_COMMUNITY_T)
+mylib.MRTentry_has_large_community.restype  = c_int
+
+mylib.MRTentry_has_ext_community.argtypes = (ctypes.POINTER(MRT_ENTRY), ctypes.c_uint64, ctypes.c_uint64)
+mylib.MRTentry_has_ext_community.restype  = c_int
+
+mylib.MRTmerge_new.argtypes = ()
+mylib.MRTmerge_new.restype  = ctypes.POINTER(MRT_MERGE_T)
+
+mylib.MRTmerge_add.argtypes = (ctypes.POINTER(MRT_MERGE_T), ctypes.POINTER(FILE_BUF_T))
+mylib.MRTmerge_add.restype  = c_int
+
+mylib.MRTmerge_set_horizon.argtypes = (ctypes.POINTER(MRT_MERGE_T), c_uint32)
+mylib.MRTmerge_set_horizon.restype  = None
+
+mylib.MRTmerge_next.argtypes = (ctypes.POINTER(MRT_MERGE_T),)
+mylib.MRTmerge_next.restype  = ctypes.POINTER(MRT_ENTRY)
+
+mylib.MRTmerge_free.argtypes = (ctypes.POINTER(MRT_MERGE_T),)
+mylib.MRTmerge_free.restype  = None
+
+mylib.MRTcolumns_read_file.argtypes = (ctypes.c_char_p, c_uint32, c_uint32, c_int, c_int)
+mylib.MRTcolumns_read_file.restype  = ctypes.POINTER(MRT_COLUMNS_T)
+
+mylib.MRTcolumns_free.argtypes = (ctypes.POINTER(MRT_COLUMNS_T),)
+mylib.MRTcolumns_free.restype  = None
+
+
+
+def read_mrt_entries(dumper, max_entries :int = MRT_BATCH_ENTRIES, max_bytes :int = MRT_BATCH_BYTES):
+    """
+    Read all the MRT entries of a file dumper, by batches of entries read in a single call to
+    the C library.
+
+    Args:
+        dumper (FILE_BUF_T): Structure of the file dumper.
+        max_entries (int): Maximum number of MRT entries per batch.
+        max_bytes (int): Maximum number of bytes of MRT records per batch.
+
+    Yields:
+        MRT_ENTRY: Yields every MRT entry that could be parsed. An entry is only valid until
+        the next batch is read, i.e., it must be processed before asking for the next one.
+    """
+
+    entries = (ctypes.POINTER(MRT_ENTRY) * max_entries)()
+
+    while dumper.contents.eof == 0:
+        nb = mylib.Read_next_mrt_batch(dumper, entries, max_entries, max_bytes)
+
+        yield from entries[:nb]
+
+
+
+def is_bgp_message(entry):
+    """
+    Tells whether an MRT entry corresponds to a BGP message (BGP4MP message or RIB entry).
+
+    Args:
+        entry (MRT_ENTRY): MRT entry.
+
+    Returns:
+        bool: True if the MRT entry must be transformed into a BGP message.
+    """
+
+    if entry.contents.entryType == BGP_TYPE_ZEBRA_BGP or entry.contents.entryType == BGP_TYPE_ZEBRA_BGP_ET:
+        return True
+
+    return entry.contents.entryType == BGP_TYPE_TABLE_DUMP_V2 and \
+        (entry.contents.entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST or entry.contents.entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST)
+
+
+
+FILTER_LISTS = {
+    "peer_asns":   (mylib.MRTfilter_add_peer_asn, int),
+    "origin_asns": (mylib.MRTfilter_add_origin_asn, int),
+    "path_asns":   (mylib.MRTfilter_add_path_asn, int),
+    "peer_addrs":  (mylib.MRTfilter_add_peer_addr, str.encode),
+    "prefixes":    (mylib.MRTfilter_add_prefix, str.encode),
+}
+
+
+def make_filter(from_time :int = 0, until_time :int = 2**32 - 1, filters :dict = None, monotonic :bool = False):
+    """
+    Build the filter evaluated by the C parser (see open_dumper for the supported filters).
+
+    Returns:
+        The pointer to the filter (to be given to File_buf_set_filter), None if nothing needs
+        to be filtered.
+    """
+
+    if from_time == 0 and until_time >= 2**32 - 1 and not filters:
+        return None
+
+    flt = mylib.MRTfilter_new()
+    if not flt:
+        raise MemoryError()
+
+    try:
+        mylib.MRTfilter_set_time(flt, from_time, min(until_time, 2**32 - 1))
+        mylib.MRTfilter_set_monotonic(flt, int(monotonic))
+
+        for name, values in (filters or {}).items():
+            if name == "msg_types":
+                if not mylib.MRTfilter_set_types(flt, values.encode()):
+                    raise ValueError("Invalid message types '{}'".format(values))
+            elif name in FILTER_LISTS:
+                (add, conv) = FILTER_LISTS[name]
+                for value in values:
+                    if not add(flt, conv(value)):
+                        raise ValueError("Invalid value '{}' in filter '{}'".format(value, name))
+            else:
+                raise ValueError("Unknown filter '{}'".format(name))
+    except:
+        mylib.MRTfilter_free(flt)
+        raise
+
+    return flt
+
+
+
+def open_dumper(fn :str, from_time :int = 0, until_time :int = 2**32 - 1, threads :int = 0, parse_threads :int = 0, filters :dict = None, monotonic :bool = False, fd :int = -1):
+    """
+    Open an MRT file dumper, with the native reader if available, with ctypes otherwise.
+
+    Args:
+        fn (str, list): Name of the MRT file (compressed or not). If a list of files is given
+        (names, or (name, fd) tuples for streams), their messages are merged by timestamp (the
+        messages of each file must be ordered by time), with only the current message of each
+        file in memory.
+        More files can be added to such a merger while it is read (see merger_add).
+        from_time (int): Only the messages collected from this UNIX timestamp are read.
+        until_time (int): Only the messages collected until this UNIX timestamp are read.
+        threads (int): Number of threads used to decompress the file (bzip2 files only).
+        parse_threads (int): Number of threads used to decode the MRT records.
+        filters (dict): Filters evaluated by the C parser, so that the messages that do not
+        match are skipped before being built (and as soon as possible while being decoded). A
+        message is kept if it matches every given filter, and a filter taking a list matches if
+        any of its values matches. Supported filters:
+            'msg_types' (str): Kept message types, as BGPmessage.msgType letters (e.g., 'U').
+            'peer_asns' (list of int): ASNs of the kept peers.
+            'peer_addrs' (list of str): IP addresses of the kept peers.
+            'prefixes' (list of str): A message is kept if one of its prefixes is equal to, or
+            more specific than, one of these prefixes (e.g., '10.0.0.0/8').
+            'origin_asns' (list of int): Kept origin ASNs.
+            'path_asns' (list of int): A message is kept if one of these ASNs is in its AS path.
+        monotonic (bool): Set if the records of the file are ordered by time (e.g., update
+        files), so that the file is not read after until_time.
+        fd (int): If set, the file is read as a stream from this file descriptor (e.g., the read
+        end of a pipe fed by a download, see stream_file), fn only giving its compression by its
+        ending. The descriptor is closed with the dumper, or if it cannot be opened.
+
+    If from_time is set and the file has a sidecar index (see build_index), the reading starts
+    from the index instead of the beginning of the file (not for streams).
+
+    Returns:
+        The file dumper, to be used with read_messages, dumper_eof and close_dumper.
+    """
+
+    if _gillstream:
+        return _gillstream.Reader(fn, BGPmessage, from_time, until_time, threads, parse_threads, filters, monotonic, fd)
+
+    if not isinstance(fn, str):
+        return _open_merger(fn, from_time, until_time, threads, parse_threads, filters, monotonic)
+
+    try:
+        flt = make_filter(from_time, until_time, filters, monotonic)
+    except:
+        if fd >= 0:
+            os.close(fd)
+        raise
+
+    # Not all the failures set errno
+    ctypes.set_errno(0)
+    if fd >= 0:
+        dumper = mylib.File_buf_create_fd(fd, fn.encode())
+    else:
+        dumper = mylib.File_buf_create(fn.encode())
+
+    if not dumper:
+        err = ctypes.get_errno()
+        if flt:
+            mylib.MRTfilter_free(flt)
+        if err:
+            raise OSError(err, os.strerror(err), fn)
+        raise OSError("Unable to open file {}".format(fn))
+
+    # The filter must be set before the parsing threads are started
+    if flt:
+        mylib.File_buf_set_filter(dumper, flt)
+
+    if threads > 0:
+        mylib.File_buf_set_decompress_threads(dumper, threads)
+
+    # The reading must be moved before the parsing threads are started
+    if from_time > 0 and mylib.MRTindex_seek(dumper, from_time) < 0:
+        mylib.File_buf_close_dump(dumper)
+        raise OSError("Unable to seek in file {}".format(fn))
+
+    if parse_threads > 0:
+        mylib.File_buf_set_parse_threads(dumper, parse_threads)
+
+    return dumper
+
+
+
+def _open_merger(files :list, *args):
+    """
+    Open the ctypes merger of several MRT files (see open_dumper).
+    """
+
+    merge = mylib.MRTmerge_new()
+    if not merge:
+        raise MemoryError()
+
+    files = list(files)
+
+    try:
+        while files:
+            f = files.pop(0)
+            if isinstance(f, str):
+                merger_add(merge, f, *args)
+            else:
+                merger_add(merge, f[0], *args, fd=f[1])
+    except:
+        mylib.MRTmerge_free(merge)
+        for f in files:
+            if not isinstance(f, str):
+                os.close(f[1])
+        raise
+
+    return merge
+
+
+
+def merger_add(dumper, fn :str, from_time :int = 0, until_time :int = 2**32 - 1, threads :int = 0, parse_threads :int = 0, filters :dict = None, monotonic :bool = False, fd :int = -1):
+    """
+    Add a file to the merger of several MRT files opened by open_dumper, even while it is read
+    (the messages read from it are then merged with the ones of the file from their next one).
+    The options must be the ones the merger was opened with (the native reader reuses them).
+
+    Args:
+        dumper: File dumper returned by open_dumper for a list of files.
+        fn (str): Name of the MRT file (see open_dumper for the other arguments).
+    """
+
+    if _gillstream:
+        dumper.add(fn, fd)
+        return
+
+    file_dumper = open_dumper(fn, from_time, until_time, threads, parse_threads, filters, monotonic, fd)
+
+    if not mylib.MRTmerge_add(dumper, file_dumper):
+        mylib.File_buf_close_dump(file_dumper)
+        raise MemoryError()
+
+
+
+def merger_set_horizon(dumper, horizon :int):
+    """
+    Hold back the messages of a merger of several MRT files from a UNIX timestamp on: read_messages
+    stops before them (without dumper_eof being set) until the horizon is moved, so that the files
+    starting at the horizon can be added first (see merger_add). 0 to hold none.
+    """
+
+    if _gillstream:
+        dumper.horizon = horizon
+    else:
+        mylib.MRTmerge_set_horizon(dumper, horizon)
+
+
+
+def read_messages(dumper):
+    """
+    Read all the BGP messages of an MRT file dumper opened with open_dumper (only up to its
+    horizon for a merger, see merger_set_horizon).
+
+    Args:
+        dumper: File dumper returned by open_dumper.
+
+    Yields:
+        BGPmessage: Yields every BGP message of the file that matches the filters of the dumper.
+    """
+
+    if _gillstream:
+        yield from dumper
+        return
+
+    # The entries of a merger are only valid until the next one is read
+    if isinstance(dumper, ctypes.POINTER(MRT_MERGE_T)):
+        entry = mylib.MRTmerge_next(dumper)
+        while entry:
+            if is_bgp_message(entry):
+                yield BGPmessage(entry)
+            entry = mylib.MRTmerge_next(dumper)
+        return
+
+    for entry in read_mrt_entries(dumper):
+        if is_bgp_message(entry):
+            yield BGPmessage(entry)
+
+
+
+def dumper_eof(dumper):
+    """
+    Tells whether all the BGP messages of a file dumper have been read.
+    """
+
+    if _gillstream:
+        return dumper.eof
+
+    return dumper.contents.eof != 0
+
+
+
+def close_dumper(dumper):
+    """
+    Close a file dumper opened with open_dumper.
+    """
+
+    if _gillstream:
+        dumper.close()
+    elif isinstance(dumper, ctypes.POINTER(MRT_MERGE_T)):
+        mylib.MRTmerge_free(dumper)
+    else:
+        mylib.File_buf_close_dump(dumper)
+
+
+
+def _numpy_column(np, ptr, ctype, nb, dtype):
+    """
+    Copy a C array of the columns into a NumPy array. The arrays of columns without any row are
+    not allocated: their offsets are then a single 0.
+    """
+
+    if nb == 0 or not ptr:
+        return np.zeros(nb, dtype=dtype)
+
+    buf = (ctype * nb).from_address(ctypes.addressof(ptr.contents))
+
+    return np.frombuffer(buf, dtype=dtype).copy()
+
+
+
+def parse_file_columns(fn :str, from_time :int = 0, until_time :int = 2**32 - 1, threads :int = 0, parse_threads :int = 0, arrow :bool = False):
+    """
+    Parse a whole MRT file in columnar form, i.e., one array per field instead of one object
+    per BGP message. Requires NumPy (and pyarrow if arrow is set).
+
+    Args:
+        fn (str): Name of the MRT file (compressed or not).
+        from_time (int): Only the messages collected from this UNIX timestamp are kept.
+        until_time (int): Only the messages collected until this UNIX timestamp are kept.
+        threads (int): Number of threads used to decompress the file (bzip2 files only).
+        parse_threads (int): Number of threads used to decode the MRT records.
+        arrow (bool): Return a pyarrow RecordBatch instead of a dict of NumPy arrays.
+
+    Returns:
+        dict: One row per BGP message. Per-row arrays: 'ts' (float64), 'time' and 'time_ms'
+        (uint32), 'peer_id' (uint32, index in 'peer_asn' and 'peer_addr'), 'msg_type' (uint8,
+        ASCII letter of BGPmessage.msgType), 'origin' (uint8, 0 = IGP, 1 = EGP, 2 = INCOMPLETE,
+        255 = none). Variable-length fields are stored as flat values plus nb_rows+1 offsets:
+        'nlri'/'nlri_offsets' and 'withdraws'/'withdraw_offsets' (structured arrays with 'afi',
+        'len' and 'addr' fields), 'as_path'/'as_path_offsets' (uint32 ASNs),
+        'communities'/'community_offsets' (uint32, ASN << 16 | value),
+        'large_communities'/'large_community_offsets' (structured array with 'global', 'local1'
+        and 'local2' uint32 fields), 'ext_communities'/'ext_community_offsets' (uint64, the 8
+        bytes of the community with its type in the most significant byte).
+        pyarrow.RecordBatch: Same columns, with list columns for the variable-length fields, and
+        peer_asn/peer_addr columns instead of the peer table (if arrow is set).
+    """
+
+    import numpy as np
+
+    cols = mylib.MRTcolumns_read_file(fn.encode(), from_time, until_time, threads, parse_threads)
+
+    if not cols:
+        raise OSError("Unable to parse file {}".format(fn))
+
+    try:
+        c = cols.contents
+        rows = c.nbRows
+        prefix_dtype = np.dtype([("afi", np.uint8), ("len", np.uint8), ("addr", np.uint8, (16,))])
+        large_dtype = np.dtype([("global", np.uint32), ("local1", np.uint32), ("local2", np.uint32)])
+
+        res = dict()
+        res["time"] = _numpy_column(np, c.time, c_uint32, rows, np.uint32)
+        res["time_ms"] = _numpy_column(np, c.timeMs, c_uint32, rows, np.uint32)
+        res["ts"] = res["time"] + res["time_ms"] / 1000000
+        res["peer_id"] = _numpy_column(np, c.peerId, c_uint32, rows, np.uint32)
+        res["msg_type"] = _numpy_column(np, c.msgType, c_uint8, rows, np.uint8)
+        res["origin"] = _numpy_column(np, c.origin, c_uint8, rows, np.uint8)
+        res["nlri_offsets"] = _numpy_column(np, c.nlriOffsets, ctypes.c_uint64, rows + 1, np.uint64)
+        res["nlri"] = _numpy_column(np, c.nlri, PREFIX_T, c.nbNLRI, prefix_dtype)
+        res["withdraw_offsets"] = _numpy_column(np, c.withdrawOffsets, ctypes.c_uint64, rows + 1, np.uint64)
+        res["withdraws"] = _numpy_column(np, c.withdraws, PREFIX_T, c.nbWithdraws, prefix_dtype)
+        res["as_path_offsets"] = _numpy_column(np, c.asPathOffsets, ctypes.c_uint64, rows + 1, np.uint64)
+        res["as_path"] = _numpy_column(np, c.asPath, c_uint32, c.nbAsPath, np.uint32)
+        res["community_offsets"] = _numpy_column(np, c.communityOffsets, ctypes.c_uint64, rows + 1, np.uint64)
+        res["communities"] = _numpy_column(np, c.communities, c_uint32, c.nbCommunities, np.uint32)
+        res["large_community_offsets"] = _numpy_column(np, c.largeCommunityOffsets, ctypes.c_uint64, rows + 1, np.uint64)
+        res["large_communities"] = _numpy_column(np, c.largeCommunities, LARGE_COMMUNITY_T, c.nbLargeCommunities, large_dtype)
+        res["ext_community_offsets"] = _numpy_column(np, c.extCommunityOffsets, ctypes.c_uint64, rows + 1, np.uint64)
+        res["ext_communities"] = _numpy_column(np, c.extCommunities, ctypes.c_uint64, c.nbExtCommunities, np.uint64)
+        res["peer_asn"] = np.array([c.peers[i].asn for i in range(c.nbPeers)], dtype=np.uint32)
+        res["peer_addr"] = [c.peers[i].addr.decode() for i in range(c.nbPeers)]
+    finally:
+        mylib.MRTcolumns_free(cols)
+
+    if not arrow:
+        return res
+
+    return columns_to_arrow(res)
+
+
+
+def columns_to_arrow(res :dict):
+    """
+    Convert the columns returned by parse_file_columns into a pyarrow RecordBatch.
+    """
+
+    import numpy as np
+    import pyarrow as pa
+
+    def list_column(offsets, values):
+        return pa.LargeListArray.from_arrays(pa.array(offsets.astype(np.int64)), values)
+
+    def prefix_values(pfx):
+        addr = pa.FixedSizeBinaryArray.from_buffers(pa.binary(16), len(pfx), [None, pa.py_buffer(np.ascontiguousarray(pfx["addr"]).tobytes())])
+        return pa.StructArray.from_arrays([pa.array(pfx["afi"]), pa.array(pfx["len"]), addr], names=["afi", "len", "addr"])
+
+    def large_values(com):
+        return pa.StructArray.from_arrays([pa.array(com[name]) for name in ("global", "local1", "local2")], names=["global", "local1", "local2"])
+
+    peer_id = res["peer_id"].astype(np.int32)
+
+    return pa.RecordBatch.from_arrays([
+            pa.array(res["ts"]),
+            pa.array(res["msg_type"]),
+            pa.array(res["peer_asn"][peer_id] if len(res["peer_asn"]) else np.empty(0, dtype=np.uint32)),
+            pa.DictionaryArray.from_arrays(pa.array(peer_id), pa.array(res["peer_addr"], type=pa.string())),
+            pa.array(res["origin"]),
+            list_column(res["nlri_offsets"], prefix_values(res["nlri"])),
+            list_column(res["withdraw_offsets"], prefix_values(res["withdraws"])),
+            list_column(res["as_path_offsets"], pa.array(res["as_path"])),
+            list_column(res["community_offsets"], pa.array(res["communities"])),
+            list_column(res["large_community_offsets"], large_values(res["large_communities"])),
+            list_column(res["ext_community_offsets"], pa.array(res["ext_communities"]))
+        ],
+        names=["ts", "msg_type", "peer_asn", "peer_addr", "origin", "nlri", "withdraws", "as_path", "communities",
+               "large_communities", "ext_communities"])
+
+
+
+def download_file(url :str, peer :str, timeout, cache = None):
+    """
+    Download a BGP dump file from remote GILL's database and store it on local disk.
+
+    Args:
+        url (str): URL of the file that need to be donwloaded.
+        peer (str): BGP peer from which the downloaded data has been collected
+        timeout (int): Number of seconds after which the URL request will be timed out.
+        cache (FileCache): If set, the file is stored in this cache instead of a temporary file.
+
+    Returns:
+        str: The name of the file on which the collected data has been stored on the local
+        disk. Returns 'None' in case Exception occured during the downloading.
+    """
+
+    ts = url.split("/")[-1].replace(".mrt.bz2", "")
+    try:
+        response = requests.get(url, stream=True, timeout=timeout)
+
+        if response.status_code != 200:
+            return None
+
+        if cache:
+            return cache.store(url, response)
+
+        if not os.path.exists("/tmp/gillstream"):
+            os.mkdir("/tmp/gillstream")
+
+        fn = "/tmp/gillstream/{}_{}.mrt.bz2".format(peer, ts)
+
+        with open(fn, "wb") as f:
+            for chunk in response.iter_content(chunk_size=4096):  # 1KB chunks
+                if chunk:
+                    f.write(chunk)
+        
+        return fn
+
+    except HTTPError as http_err:
+        print(f"HTTP error occurred: {http_err}")
+        return None
+    except ConnectionError as conn_err:
+        print(f"Connection error occurred: {conn_err}")
+        return None
+    except Timeout as timeout_err:
+        print(f"Timeout error occurred: {timeout_err}")
+        return None
+    except Exception as err:
+        print(f"An error occurred: {err}")
+        return None
+
+
+
+def download_file_retry(url :str, peer :str, cache = None):
+    """
+    Download a BGP dump file (see download_file), retrying with a doubling timeout.
+
+    Args:
+        url (str): URL of the file that need to be donwloaded.
+        peer (str): BGP peer from which the downloaded data has been collected
+        cache (FileCache): If set, the file is looked up in this cache first, and stored in it
+        if it must be downloaded.
+
+    Returns:
+        str: The name of the file on the local disk, 'None' if it could not be downloaded.
+    """
+
+    fn = cache.get(url) if cache else None
+    if fn:
+        return fn
+
+    timeout = 1
+    fn = download_file(url, peer, timeout, cache)
+
+    while not fn and timeout < 64:
+        timeout *= 2
+        fn = download_file(url, peer, timeout, cache)
+
+    return fn
+
+
+
+class FileCache:
+    """
+    Persistent cache of the files downloaded from GILL's database, shared by the streams (and
+    the processes) using the same directory. The files are named after a hash of their URL, and
+    the least recently used ones are removed once the cache exceeds its maximum size.
+
+    A file is written to a temporary name, and renamed once complete, so that a file found in
+    the cache is always whole. The removals are serialized by a lock on the directory, and a
+    file removed while being read stays readable until it is closed. The files returned by get
+    and store are pinned until they are released: a shared lock is held on each of them, and the
+    files that cannot be locked exclusively are not removed, so that a file is not removed by
+    another process sharing the directory before it is opened.
+
+    Attributes:
+        path (str): Directory of the cache.
+        max_bytes (int): Size of the cache above which the least recently used files are removed.
+        decompress (bool): Set if the files are stored decompressed, so that reading them from
+        the cache skips the bzip2 decompression (at the cost of about five times the space).
+        pinned (Counter): Number of uses of the files returned and not released yet.
+        locks (dict): Descriptor holding the shared lock of each pinned file.
+    """
+
+    def __init__(self, path :str, max_bytes :int = GILL_CACHE_BYTES, decompress :bool = False):
+        self.path = os.path.abspath(os.path.expanduser(path))
+        self.max_bytes = max_bytes
+        self.decompress = decompress
+        self.pinned = collections.Counter()
+        self.locks = dict()
+        self.lock = threading.Lock()
+
+        os.makedirs(self.path, exist_ok=True)
+
+
+    def file_name(self, url :str):
+        """
+        Name of the file of a URL in the cache, whether it is cached or not.
+        """
+
+        key = hashlib.sha256(url.encode()).hexdigest()
+
+        return os.path.join(self.path, key + (".mrt" if self.decompress else ".mrt.bz2"))
+
+
+    def contains(self, fn :str):
+        """
+        Tells whether a file name is the one of a file of the cache.
+        """
+
+        return os.path.dirname(os.path.abspath(fn)) == self.path
+
+
+    def get(self, url :str):
+        """
+        Look up the file of a URL in the cache, and mark it as the most recently used. The file
+        must be released once read.
+
+        Returns:
+            str: The name of the cached file, 'None' if the URL is not in the cache.
+        """
+
+        fn = self.file_name(url)
+        if not self.pin(fn):
+            return None
+
+        # The last use is kept in the access time, the modification time tells the sidecar
+        # index (if any) that the file is unchanged
+        try:
+            st = os.stat(fn)
+            os.utime(fn, (time.time(), st.st_mtime))
+        except FileNotFoundError:
+            self.release(fn)
+            return None
+
+        return fn
+
+
+    def pin(self, fn :str, fd :int = -1):
+        """
+        Prevent a file of the cache from being removed (by any process sharing the cache) until
+        it is released, with a shared lock on it.
+
+        Args:
+            fn (str): Name of the file in the cache.
+            fd (int): If set, descriptor of the file, taken over and used to lock it.
+
+        Returns:
+            bool: False if the file is not in the cache (anymore).
+        """
+
+        with self.lock:
+            if fd < 0:
+                try:
+                    fd = os.open(fn, os.O_RDONLY)
+                except FileNotFoundError:
+                    return False
+
+            # Waits for an eviction of the file in progress, which leaves it without any link
+            fcntl.flock(fd, fcntl.LOCK_SH)
+            if os.fstat(fd).st_nlink == 0:
+                os.close(fd)
+                return False
+
+            # One descriptor per file holds its lock: the former one locks the same file, or the
+            # one it replaced since (a file replaced by a new download keeps its readers)
+            if fn in self.locks:
+                os.close(self.locks[fn])
+            self.locks[fn] = fd
+            self.pinned[fn] += 1
+
+        return True
+
+
+    def release(self, fn :str):
+        """
+        Release a file returned by get or store, once read.
+        """
+
+        with self.lock:
+            self.pinned[fn] -= 1
+            if self.pinned[fn] <= 0:
+                del self.pinned[fn]
+                os.close(self.locks.pop(fn))
+
+
+    def store(self, url :str, response):
+        """
+        Store the body of the HTTP response of a URL in the cache, then remove the least recently
+        used files if the cache is too large. The file must be released once read.
+
+        Returns:
+            str: The name of the cached file.
+        """
+
+        fn = self.file_name(url)
+        (fd, tmp) = tempfile.mkstemp(dir=self.path, suffix=".part")
+        pinned = False
+
+        try:
+            with os.fdopen(fd, "wb") as f:
+                dec = bz2.BZ2Decompressor() if self.decompress else None
+                started = False
+
+                for chunk in response.iter_content(chunk_size=GILL_STREAM_CHUNK_BYTES):
+                    if not dec:
+                        f.write(chunk)
+                        continue
+
+                    # bzip2 files may be made of several concatenated streams
+                    while chunk:
+                        f.write(dec.decompress(chunk))
+                        started = True
+                        chunk = b""
+                        if dec.eof:
+                            chunk = dec.unused_data
+                            dec = bz2.BZ2Decompressor()
+                            started = False
+
+                if dec and started:
+                    raise EOFError("Truncated bzip2 file {}".format(url))
+
+            # Pinned before being renamed, so that it cannot be evicted before being read
+            pinned = self.pin(fn, os.open(tmp, os.O_RDONLY))
+            os.replace(tmp, fn)
+        except:
+            if pinned:
+                self.release(fn)
+            os.remove(tmp)
+            raise
+
+        self.evict()
+
+        return fn
+
+
+    def evict(self):
+        """
+        Remove the least recently used files that are not pinned (by any process), until the
+        cache is not larger than max_bytes, as well as the abandoned partial downloads.
+        """
+
+        with open(os.path.join(self.path, ".lock"), "w") as lock:
+            fcntl.flock(lock, fcntl.LOCK_EX)
+
+            files = list()
+            total = 0
+            now = time.time()
+
+            for entry in os.scandir(self.path):
+                try:
+                    st = entry.stat()
+                except FileNotFoundError:
+                    continue
+
+                if entry.name.endswith(".part"):
+                    if now - st.st_mtime > GILL_CACHE_PART_TIMEOUT:
+                        os.remove(entry.path)
+                elif entry.name.endswith(".mrt") or entry.name.endswith(".mrt.bz2"):
+                    files.append((st.st_atime, st.st_size, entry.path))
+                    total += st.st_size
+                elif entry.name.endswith(".idx"):
+                    total += st.st_size
+
+            with self.lock:
+                pinned = set(self.pinned)
+
+            for (_, size, fn) in sorted(files):
+                if total <= self.max_bytes:
+                    break
+                if fn in pinned:
+                    continue
+
+                # The files pinned by other processes hold a shared lock
+                try:
+                    fd = os.open(fn, os.O_RDONLY)
+                except FileNotFoundError:
+                    total -= size
+                    continue
+
+                try:
+                    fcntl.flock(fd, fcntl.LOCK_EX | fcntl.LOCK_NB)
+                except BlockingIOError:
+                    os.close(fd)
+                    continue
+
+                # A sidecar index is removed with its file
+                try:
+                    for name in (fn, fn + ".idx"):
+                        try:
+                            total -= os.stat(name).st_size
+                            os.remove(name)
+                        except FileNotFoundError:
+                            pass
+                finally:
+                    os.close(fd)
+
+
+
+def _pump_response(url :str, response, fd :int):
+    """
+    Write the body of an HTTP response to a file descriptor (the write end of the pipe of a
+    streamed file), then close both. Stops early if the reader closes the pipe.
+    """
+
+    try:
+        for chunk in response.iter_content(chunk_size=GILL_STREAM_CHUNK_BYTES):
+            view = memoryview(chunk)
+            while view:
+                view = view[os.write(fd, view):]
+    except BrokenPipeError:
+        pass
+    except Exception as err:
+        print(f"An error occurred while streaming {url}: {err}")
+    finally:
+        os.close(fd)
+        response.close()
+
+
+
+def stream_file(url :str, timeout):
+    """
+    Open a BGP dump file from remote GILL's database as a stream: the body of the response is
+    written to a pipe by a background thread while it is received, so that the file can be
+    decompressed and parsed from the read end of the pipe (see open_dumper) before its download
+    ends, without being stored on disk.
+
+    Args:
+        url (str): URL of the file that need to be streamed.
+        timeout (int): Number of seconds after which the URL request will be timed out.
+
+    Returns:
+        int: The read end of the pipe, 'None' in case Exception occured during the request. If
+        the download fails later on, the stream ends early.
+    """
+
+    try:
+        response = requests.get(url, stream=True, timeout=timeout)
+
+        if response.status_code != 200:
+            response.close()
+            return None
+
+    except HTTPError as http_err:
+        print(f"HTTP error occurred: {http_err}")
+        return None
+    except ConnectionError as conn_err:
+        print(f"Connection error occurred: {conn_err}")
+        return None
+    except Timeout as timeout_err:
+        print(f"Timeout error occurred: {timeout_err}")
+        return None
+    except Exception as err:
+        print(f"An error occurred: {err}")
+        return None
+
+    (rfd, wfd) = os.pipe()
+    threading.Thread(target=_pump_response, args=(url, response, wfd), daemon=True).start()
+
+    return rfd
+
+
+
+def stream_file_retry(url :str):
+    """
+    Open a BGP dump file as a stream (see stream_file), retrying with a doubling timeout.
+
+    Args:
+        url (str): URL of the file that need to be streamed.
+
+    Returns:
+        int: The read end of the pipe of the stream, 'None' if the file could not be requested.
+    """
+
+    timeout = 1
+    fd = stream_file(url, timeout)
+
+    while fd is None and timeout < 64:
+        timeout *= 2
+        fd = stream_file(url, timeout)
+
+    return fd
+
+
+
+class FilePrefetcher:
+    """
+    Downloads the files of a stream ahead of their parsing, on a pool of threads, so that the
+    download of the next files overlaps with the parsing of the current one. The files are
+    returned in order, and at most 'lookahead' files are being downloaded or waiting to be
+    parsed at the same time, which bounds the disk space used.
+
+    Attributes:
+        files (deque): (url, peer) of the files that are not downloaded yet.
+        cache (FileCache): Cache in which the files are looked up and stored (if any).
+        lookahead (int): Maximum number of files downloaded ahead.
+        pending (deque): (url, future) of the files being downloaded or waiting to be parsed,
+        in order. Each future results in the local name of the file (None if the download failed).
+    """
+
+    def __init__(self, files :list, lookahead :int, cache :FileCache = None):
+        self.files = collections.deque(files)
+        self.cache = cache
+        self.lookahead = max(1, lookahead)
+        self.pending = collections.deque()
+        self.pool = ThreadPoolExecutor(max_workers=self.lookahead)
+
+        self._fill()
+
+
+    def _fill(self):
+        while self.files and len(self.pending) < self.lookahead:
+            (url, peer) = self.files.popleft()
+            self.pending.append((url, self.pool.submit(download_file_retry, url, peer, self.cache)))
+
+
+    def next_file(self):
+        """
+        Wait for the download of the next file, and start the download of the following ones.
+
+        Returns:
+            tuple: (url, fn) of the next file, fn being None if it could not be downloaded.
+            Returns None if there is no file left.
+        """
+
+        if not self.pending:
+            return None
+
+        (url, future) = self.pending.popleft()
+        fn = future.result()
+
+        self._fill()
+
+        return (url, fn)
+
+
+    def close(self):
+        """
+        Cancel the downloads in progress and remove the files downloaded but not returned.
+        """
+
+        self.files.clear()
+
+        for (_, future) in self.pending:
+            future.cancel()
+
+        self.pool.shutdown(wait=True)
+
+        for (_, future) in self.pending:
+            fn = None if future.cancelled() else future.result()
+            if fn and self.cache and self.cache.contains(fn):
+                self.cache.release(fn)
+            elif fn:
+                os.remove(fn)
+
+        self.pending.clear()
+
+
+
+def release_file(fn :str, cache :FileCache = None):
+    """
+    Remove a downloaded file once read, unless it is kept in the cache for the next streams.
+    """
+
+    if cache and cache.contains(fn):
+        cache.release(fn)
+    else:
+        os.remove(fn)
+
+
+
+def open_downloaded(url :str, peer :str, fn :str, cache :FileCache, opener):
+    """
+    Open a downloaded (or cached) file with opener(fn). A cached file removed by another process
+    before being opened is downloaded again. The file is released if it cannot be opened.
 
-BGP_SUBTYPE_RIB_IPV4_UNICAST = 2
-BGP_SUBTYPE_RIB_IPV6_UNICAST = 4
+    Args:
+        url (str): URL of the file.
+        peer (str): BGP peer from which the data of the file has been collected.
+        fn (str): Name of the file, returned by download_file_retry (or FileCache.get).
+        cache (FileCache): Cache the file may come from (if any).
+        opener: Function opening the file from its name (e.g., with open_dumper).
 
+    Returns:
+        tuple: (fn, result of opener), fn being the name of the file finally opened, to be
+        released once read. Returns (None, None) if the file could not be downloaded again.
+    """
 
-BGP_TYPE_OPEN               = 1
-BGP_TYPE_KEEPALIVE          = 4
-BGP_TYPE_UPDATE             = 2
-BGP_TYPE_NOTIFICATION       = 3
-BGP_TYPE_STATE_CHANGE       = 5
+    try:
+        return (fn, opener(fn))
+    except FileNotFoundError:
+        if not (cache and cache.contains(fn)):
+            raise
+    except:
+        release_file(fn, cache)
+        raise
 
+    cache.release(fn)
+    fn = download_file_retry(url, peer, cache)
 
-GILLSTREAM_LIBRARY_PATH='/usr/local/lib/'
+    if not fn:
+        print("Skip file {}, unable to download".format(url))
+        return (None, None)
 
+    try:
+        return (fn, opener(fn))
+    except:
+        release_file(fn, cache)
+        raise
 
-# Import CFRFILE structure from C library
-class CFRFILE(Structure):
-    _fields_ = [
-        ("format", c_int),       # 0 = not open, 1 = uncompressed, 2 = bzip2, 3 = gzip
-        ("eof", c_int),          # 0 = not EOF
-        ("closed", c_int),       # indicates whether fclose has been called, 0 = not yet
-        ("error1", c_int),       # errors from the system, 0 = no error
-        ("error2", c_int),       # for error messages from the compressor
-        ("data1", c_void_p), # system file handle (FILE *)
-        ("data2", c_void_p),     # additional handle(s) for the compressor
-        ("bz2_stream_end", c_int) # True when a bz2 stream has ended
-    ]
 
 
-# Import RIB_PEER_INDEX structure from C library
-class RIB_PEER_INDEX_T(Structure):
-    _fields_ = [
-        ("afi", c_int),
-        ("idx", c_int),
-        ("addr", c_char * 64),
-        ("asn", c_uint32)
-    ]
+def _fetch_file(url :str, peer :str, cache :FileCache, stream :bool):
+    """
+    Get a file ready to be read (see _read_source), from the cache or by downloading it.
 
+    Returns:
+        The name of the downloaded (or cached) file, (url, fd) for a file streamed from the read
+        end of a pipe (see stream_file), None if the file cannot be downloaded.
+    """
 
-class FILE_BUF_T(Structure):
-    _fields_ = [
-        ("f", POINTER(CFRFILE)),  # Pointer to CFRFILE
-        ("f_type", c_int),        # Integer representing the file type
-        ("eof", c_int),           # End of file flag
-        ("filename", c_char * BGPDUMP_MAX_FILE_LEN),  # Filename array of length BGPDUMP_MAX_FILE_LEN
-        ("parsed", c_int),        # Indicates if the file is parsed
-        ("parsed_ok", c_int),     # Indicates if the parsing was successful
-        ("index", RIB_PEER_INDEX_T * 256),
-        ("actPeerIdx", c_int),
-        ("actEntry", ctypes.c_void_p)
-    ]
+    fn = cache.get(url) if cache and stream else None
 
+    if stream and not fn:
+        fd = stream_file_retry(url)
+        if fd is not None:
+            return (url, fd)
+    elif not fn:
+        fn = download_file_retry(url, peer, cache)
 
-class MRT_ENTRY(Structure):
-    _fields_ = [
-        ("entryType", c_uint16),
-        ("entrySubType", c_uint16),
-        ("entryLength", c_uint32),
-        ("bgpType", c_uint16),
-        ("peer_asn", c_uint32),
-        ("afi", c_uint16),
-        ("peerAddr", c_char * 64),
-        ("time", c_uint32),
-        ("time_ms", c_uint32),
-        ("nbWithdraw", c_uint16),
-        ("nbNLRI", c_uint16),
-        ("pfxNLRI", c_char * 64 * MAX_NB_PREFIXES),
-        ("pfxWithdraw", c_char * 64 * MAX_NB_PREFIXES),
-        ("nextHop", c_char * 64),
-        ("asPath", c_char * MAX_ATTR),
-        ("communities", c_char * MAX_ATTR),
-        ("origin", c_char * 16),
-        ("dumper", ctypes.POINTER(FILE_BUF_T)),
-        ("next", ctypes.c_void_p),
-        ("prev", ctypes.c_void_p)
-    ]
+    if not fn:
+        print("Skip file {}, unable to download".format(url))
+
+    return fn
 
 
 
+def _read_source(url :str, peer :str, src, cache :FileCache, options :dict):
+    """
+    Messages of a file got by _fetch_file, which is released once read.
+    """
 
+    args = (options["from_time"], options["until_time"])
+    kwargs = dict(filters=options["filters"], monotonic=options["monotonic"])
 
-class BGPmessage:
+    # A stream is closed by open_dumper, even if it fails
+    if isinstance(src, str):
+        (src, dumper) = open_downloaded(url, peer, src, cache, lambda fn: open_dumper(fn, *args, **kwargs))
+        if not src:
+            return
+    else:
+        dumper = open_dumper(src[0], *args, fd=src[1], **kwargs)
+
+    try:
+        yield from read_messages(dumper)
+    finally:
+        close_dumper(dumper)
+        if isinstance(src, str):
+            release_file(src, cache)
+
+
+
+def _file_start(url :str):
+    """
+    Start time of a file of GILL's database, given by its name (e.g., '.../1740787200.mrt.bz2'),
+    0 if unknown.
     """
-    Structre that represents a BGP message
 
-    Attributes:
-        ts (float): UNIX timestamp at which the BGP message has been collected by the VP.
-        type (int): Type of MRT entry (e.g., BGP4MP, BGP4MP_ET, ..)
-        nlri (list): List of all prefixes (in string mode) that have been announced in the
-        current BGP message.
-        withdraws (list): List of all prefixes (in string mode) that have been withdrawn in
-        the current BGP message.
-        origin (str): String representation of the origin BGP attribute.
-        nexthop (str): String representation of the nethop BGP attribute.
-        as_path (str): String representation of the AS path BGP attribute.
-        communities (str): String representation of the Community values BGP attribute.
-        peer_asn (str): AS number of the VP from which we received the message.
-        peer_addr (str): String represntation of the IP address of the BGP peer from which
-        we received the message.
-        msgType (str): String representation of the type of BGP message (e.g., UPDATE, OPEN,...).
-        bgpType (int): Integer value of the type of BGP message.
+    name = url.split("/")[-1].split(".")[0]
+
+    return int(name) if name.isdigit() else 0
+
+
+
+def _read_merged(files :list, cache :FileCache, options :dict):
+    """
+    Messages of files merged by timestamp by the C library. The files are sorted by start time
+    (see _file_start), and each of them is only added to the merger once the merge reaches its
+    start time (see merger_set_horizon), so that only the files overlapping the current time are
+    open, each file being closed as soon as it is read. At most options["prefetch"] files are
+    downloaded ahead of the merge (none if they are streamed).
     """
-    def __init__(self, mrtentry):
-        self.ts          = 0.0
-        self.type        = 0
-        self.nlri        = list()
-        self.withdraws   = list()
-        self.origin      = ""
-        self.nexthop     = ""
-        self.as_path     = ""
-        self.communities = ""
-        self.peer_asn    = 0
-        self.peer_addr   = ""
-        self.msgType     = "Unknown"
-        self.bgpType     = 0
 
-        self.type = mrtentry.contents.entryType
-        self.origin = mrtentry.contents.origin.decode()
-        self.as_path = mrtentry.contents.asPath.decode()
-        self.communities = mrtentry.contents.communities.decode()
-        self.nexthop = mrtentry.contents.nextHop.decode()
-        self.ts = mrtentry.contents.time + mrtentry.contents.time_ms / 1000000
-        self.peer_asn = mrtentry.contents.peer_asn
-        self.peer_addr = mrtentry.contents.peerAddr.decode()
-        self.bgpType = mrtentry.contents.bgpType
+    args = (options["from_time"], options["until_time"])
+    kwargs = dict(filters=options["filters"], monotonic=options["monotonic"])
 
-        # Setup MSG Type
-        if self.type == BGP_TYPE_ZEBRA_BGP or self.type == BGP_TYPE_ZEBRA_BGP_ET:
-            if self.bgpType == BGP_TYPE_OPEN:
-                self.msgType = "O"
-            elif self.bgpType == BGP_TYPE_UPDATE:
-                self.msgType = "U"
-            elif self.bgpType == BGP_TYPE_NOTIFICATION:
-                self.msgType = "N"
-            elif self.bgpType == BGP_TYPE_KEEPALIVE:
-                self.msgType = "K"
-            elif self.bgpType == BGP_TYPE_STATE_CHANGE:
-                self.msgType = "S"
+    pending = collections.deque(sorted(files, key=lambda f: _file_start(f[0])))
+    prefetcher = None
+    if not options["stream"] and options["prefetch"] > 0:
+        prefetcher = FilePrefetcher(pending, options["prefetch"], cache)
 
-        elif self.type == BGP_TYPE_TABLE_DUMP_V2:
-            self.msgType = "R"
+    merger = open_dumper([], *args, **kwargs)
 
+    try:
+        while True:
+            merger_set_horizon(merger, _file_start(pending[0][0]) if pending else 0)
+            yield from read_messages(merger)
+
+            if not pending:
+                return
+
+            # The merge reached the start of the next files (or read all the files added)
+            start = _file_start(pending[0][0])
+
+            while pending and _file_start(pending[0][0]) == start:
+                (url, peer) = pending.popleft()
+                src = prefetcher.next_file()[1] if prefetcher else _fetch_file(url, peer, cache, options["stream"])
+
+                if not src:
+                    if prefetcher:
+                        print("Skip file {}, unable to download".format(url))
+                    continue
+
+                # An open file stays readable once removed (or evicted from the cache)
+                try:
+                    if isinstance(src, str):
+                        (src, _) = open_downloaded(url, peer, src, cache, lambda fn: merger_add(merger, fn, *args, **kwargs))
+                        if src:
+                            release_file(src, cache)
+                    else:
+                        merger_add(merger, src[0], *args, fd=src[1], **kwargs)
+                except OSError as err:
+                    print("Skip file {}, unable to read: {}".format(url, err))
+    finally:
+        if prefetcher:
+            prefetcher.close()
+        close_dumper(merger)
+
+
+
+def _read_files(files :list, tasks, cache :FileCache, options :dict):
+    """
+    Messages of the files of a GillStream, read by a worker process or by the stream itself.
+    Files taken from the tasks queue (if set) are read one after the other, a file that cannot
+    be read being skipped. Otherwise, the messages of the given files are merged by timestamp
+    (see _read_merged).
+    """
 
-        for i in range(0, mrtentry.contents.nbWithdraw):
-            self.withdraws.append(mrtentry.contents.pfxWithdraw[i].value.decode())
+    if tasks is not None:
+        for (url, peer) in iter(tasks.get, None):
+            src = _fetch_file(url, peer, cache, options["stream"])
+            if not src:
+                continue
 
-        for i in range(0, mrtentry.contents.nbNLRI):
-            self.nlri.append(mrtentry.contents.pfxNLRI[i].value.decode())
+            try:
+                yield from _read_source(url, peer, src, cache, options)
+            except OSError as err:
+                print("Skip file {}, unable to read: {}".format(url, err))
+        return
 
+    yield from _read_merged(files, cache, options)
 
-    
-    def __str__(self):
-        res = "{}|{}|{}|{}|{}|{}|{}|{}|{}|{}".format(self.msgType, self.ts, ",".join(self.nlri), ",".join(self.withdraws), self.origin, self.nexthop, self.as_path, self.communities, self.peer_asn, self.peer_addr)
 
-        return res
 
-mylib = ctypes.CDLL("{}/libbgpgill.so".format(GILLSTREAM_LIBRARY_PATH))
+def _parallel_worker(worker :int, files :list, tasks, results, options :dict):
+    """
+    Body of a worker process of a parallel GillStream (see GillStream.get_all_data). The
+    messages read by the worker (see _read_files) are sent in batches of GILL_PARALLEL_BATCH
+    messages as (worker, batch) on the results queue, followed by (worker, None) once done, or
+    by (worker, exception) if the worker fails (the files that cannot be read are skipped), to
+    be raised by the stream. A batch is a list of tuples of the attributes of the messages (see
+    BGP_MESSAGE_FIELDS), serialized with marshal, which is much cheaper to load than pickled
+    objects.
+    """
 
-mylib.File_buf_create.argtypes = (ctypes.c_char_p,)
-mylib.File_buf_create.restype  = ctypes.POINTER(FILE_BUF_T)
+    # Terminated when the reading is stopped early: the files are closed and released, and the
+    # batches not read are dropped
+    def stop(signum, frame):
+        results.cancel_join_thread()
+        raise SystemExit(0)
 
-mylib.File_buf_close_dump.argtypes = (ctypes.POINTER(FILE_BUF_T),)
-mylib.File_buf_close_dump.restype  = None
+    signal.signal(signal.SIGTERM, stop)
 
-mylib.Read_next_mrt_entry.argtypes = (ctypes.POINTER(FILE_BUF_T),)
-mylib.Read_next_mrt_entry.restype  = ctypes.POINTER(MRT_ENTRY)
+    cache = FileCache(*options["cache"]) if options["cache"] else None
+    messages = _read_files(files, tasks, cache, options)
+    fields = operator.attrgetter(*BGP_MESSAGE_FIELDS)
+    batch = list()
+    end = None
 
-mylib.MRTentry_free.argtypes = (ctypes.POINTER(MRT_ENTRY),)
-mylib.MRTentry_free.restype  = None
+    try:
+        for msg in messages:
+            batch.append(fields(msg))
+            if len(batch) >= GILL_PARALLEL_BATCH:
+                results.put((worker, marshal.dumps(batch)))
+                batch = list()
+
+        if batch:
+            results.put((worker, marshal.dumps(batch)))
+    except Exception as err:
+        end = err
+    finally:
+        messages.close()
 
+    # The exception is pickled by the queue in the background, where a failure would be lost
+    if end is not None:
+        try:
+            pickle.dumps(end)
+        except Exception:
+            end = RuntimeError("{}: {}".format(type(end).__name__, end))
 
+    results.put((worker, end))
 
-def download_file(url :str, peer :str, timeout):
-    """
-    Download a BGP dump file from remote GILL's database and store it on local disk.
 
-    Args:
-        url (str): URL of the file that need to be donwloaded.
-        peer (str): BGP peer from which the downloaded data has been collected
-        timeout (int): Number of seconds after which the URL request will be timed out.
 
-    Returns:
-        str: The name of the file on which the collected data has been stored on the local
-        disk. Returns 'None' in case Exception occured during the downloading.
+def _batch_messages(batch :bytes):
+    """
+    Messages of a batch sent by a worker process of a parallel GillStream.
     """
 
-    ts = url.split("/")[-1].replace(".mrt.bz2", "")
-    try:
-        response = requests.get(url, stream=True, timeout=timeout)
+    new = object.__new__
 
-        if response.status_code != 200:
-            return None
+    for values in marshal.loads(batch):
+        msg = new(BGPmessage)
+        msg.__dict__.update(zip(BGP_MESSAGE_FIELDS, values))
+        yield msg
 
-        if not os.path.exists("/tmp/gillstream"):
-            os.mkdir("/tmp/gillstream")
 
-        fn = "/tmp/gillstream/{}_{}.mrt.bz2".format(peer, ts)
 
-        with open(fn, "wb") as f:
-            for chunk in response.iter_content(chunk_size=4096):  # 1KB chunks
-                if chunk:
-                    f.write(chunk)
-        
-        return fn
+def _queue_messages(queue):
+    """
+    Messages sent by a worker process of a parallel GillStream on its own results queue. Raises
+    the exception the worker failed with (if any).
+    """
 
-    except HTTPError as http_err:
-        print(f"HTTP error occurred: {http_err}")
-        return None
-    except ConnectionError as conn_err:
-        print(f"Connection error occurred: {conn_err}")
-        return None
-    except Timeout as timeout_err:
-        print(f"Timeout error occurred: {timeout_err}")
-        return None
-    except Exception as err:
-        print(f"An error occurred: {err}")
-        return None
+    while True:
+        (_, batch) = queue.get()
+        if batch is None:
+            return
+        if isinstance(batch, BaseException):
+            raise batch
+        yield from _batch_messages(batch)
 
 
 
@@ -278,13 +1712,39 @@ def query_broker(url, timeout):
 
 
 
-def parse_one_file(fn :str):
+def build_index(fn :str):
+    """
+    Build the sidecar index of an MRT file (written next to it, with the '.idx' extension), so
+    that reading the file from a given time (see open_dumper) skips the records before it. The
+    index is ignored once the file is modified.
+
+    Args:
+        fn (str): Name of the MRT file (compressed or not).
+
+    Returns:
+        int: Number of points of the index.
+    """
+
+    res = mylib.MRTindex_build(fn.encode(), None)
+
+    if res < 0:
+        raise OSError("Unable to build the index of file {}".format(fn))
+
+    return res
+
+
+def parse_one_file(fn :str, threads :int = 0, parse_threads :int = 0, filters :dict = None):
     """
     Parse a single MRT file and yields every single MRT entry.
 
     Args:
         fn (str): Name of the file that must be processed. The file can be either compressed 
         or uncompressed.
+        threads (int): Number of threads used to decompress the file (bzip2 files only). With
+        the default value (0), the file is decompressed by the parsing thread.
+        parse_threads (int): Number of threads used to decode the MRT records. With the default
+        value (0), the records are decoded by the calling thread.
+        filters (dict): Filters evaluated by the C parser (see open_dumper).
 
     Yields:
         BGPmessage: Yields every single MRT entry by transforming them into a BGP message.
@@ -293,23 +1753,11 @@ def parse_one_file(fn :str):
         int: return 0 if evrything went well, -1 otherwise.
     """
 
-    dumper = mylib.File_buf_create(fn.encode())
+    dumper = open_dumper(fn, threads=threads, parse_threads=parse_threads, filters=filters)
 
-    while dumper.contents.eof == 0:
-        entry = mylib.Read_next_mrt_entry(dumper)
-
-        if entry:
-            if entry.contents.entryType == BGP_TYPE_ZEBRA_BGP or entry.contents.entryType == BGP_TYPE_ZEBRA_BGP_ET:
-                msg = BGPmessage(entry)
-                yield msg
-            elif entry.contents.entryType == BGP_TYPE_TABLE_DUMP_V2 and \
-                (entry.contents.entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST or entry.contents.entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST):
-                msg = BGPmessage(entry)
-                yield msg
-
-            #mylib.MRTentry_free(entry)
-        
-    mylib.File_buf_close_dump(dumper)
+    yield from read_messages(dumper)
+
+    close_dumper(dumper)
 
     return 0
 
@@ -330,12 +1778,27 @@ class GillStream:
         vps (list): Represent the list of Vantage Points from which we want to collect the data.
         Each VP must be of the form 'ASN_IP'. In case this parameter is not set, collect data from
         all VPs.
+        filters (dict): Filters evaluated by the C parser on every file (see open_dumper).
+        monotonic (bool): Set to stop reading each file at its first record after until_time
+        (see open_dumper).
+        prefetch (int): Number of files downloaded ahead of the file being parsed.
+        broker_url (str): URL of the GILL file broker.
+        stream (bool): Set to parse the files while they are downloaded, without storing them.
+        cache (FileCache): Local cache of the downloaded files (if any).
+        processes (int): Number of worker processes reading the files (0 to read them in this
+        process).
+        ordered (bool): Set to merge the messages of all the files by timestamp.
+        workers (list): Worker processes started by get_all_data.
         all_files (list): List of all files that need to be downloaded to process all required data.
         remaining_files (list): List of files that e still need to process.
-        dumper (FILE_BUF_T): Structure of the file dumper.
+        dumper: File dumper of the file currently processed (see open_dumper).
+        prefetcher (FilePrefetcher): Downloader of the next files (if prefetch is set).
     """
 
-    def __init__(self, from_time, until_time, record_type :str, vps=None):
+    def __init__(self, from_time, until_time, record_type :str, vps=None, filters :dict = None, monotonic :bool = False,
+                 prefetch :int = GILL_PREFETCH_FILES, broker_url :str = GILL_BROKER_URL, stream :bool = False,
+                 cache_dir :str = None, cache_bytes :int = GILL_CACHE_BYTES, cache_decompressed :bool = False,
+                 processes :int = 0, ordered :bool = False):
         """
         Initialize the Stream of GILL data. Query the broker to know precisely which files
         need to be downloaded and processed.
@@ -352,6 +1815,33 @@ class GillStream:
             vps (list): Represent the list of Vantage Points from which we want to collect the data.
             Each VP must be of the form 'ASN_IP'. In case this parameter is not set, collect data from
             all VPs.
+            filters (dict): Filters evaluated by the C parser on every file (see open_dumper).
+            monotonic (bool): Set to stop reading each file at its first record after until_time
+            (see open_dumper).
+            prefetch (int): Number of files downloaded in the background, ahead of the file being
+            parsed (at most this number of files are stored on disk at the same time). With 0, each
+            file is only downloaded once the previous one is parsed.
+            broker_url (str): URL of the GILL file broker (e.g., of a local stand-in for testing).
+            stream (bool): If set, each file is decompressed and parsed while it is downloaded (see
+            stream_file), instead of being stored on disk first. The first messages come out sooner,
+            but the files are not prefetched (prefetch is ignored).
+            cache_dir (str): If set, the downloaded files are kept in this directory (see FileCache),
+            and looked up there before being downloaded again, by this stream or another one.
+            Streamed files are read from the cache, but not stored in it.
+            cache_bytes (int): Size of the cache above which its least recently used files are removed.
+            cache_decompressed (bool): Set to store the files decompressed in the cache, so that
+            they are parsed without being decompressed again.
+            processes (int): If set, the files are downloaded and parsed by this number of worker
+            processes, which send the messages to this one in batches (prefetch is then ignored,
+            unless ordered is set).
+            ordered (bool): Set to yield the messages of all the files merged by timestamp (the
+            messages of each file must be ordered by time), instead of file after file. The files
+            are merged by the C library with only the current message of each file in memory, and
+            each file is only downloaded (at most prefetch files ahead) and opened once the merge
+            reaches its start time, given by its name (see _read_merged). With worker processes,
+            the files are split between the workers, each of which merges its files, and the
+            messages of the workers are merged in turn. Otherwise, the workers take the files one
+            after the other and the messages are yielded as soon as they are received.
         """
         
         self.from_time = 0
@@ -359,10 +1849,21 @@ class GillStream:
 
         self.vps = vps
         self.record_type = record_type
+        self.filters = filters
+        self.monotonic = monotonic
+        self.prefetch = prefetch
+        self.broker_url = broker_url
+        self.stream = stream
+        self.cache = FileCache(cache_dir, cache_bytes, cache_decompressed) if cache_dir else None
+        self.cache_args = (cache_dir, cache_bytes, cache_decompressed) if cache_dir else None
+        self.processes = processes
+        self.ordered = ordered
+        self.workers = list()
 
         self.all_files = list()
         self.remaining_files = list()
         self.dumper = None
+        self.prefetcher = None
 
         self.actFile = None
 
@@ -389,9 +1890,9 @@ class GillStream:
                 exit(1)
 
         if self.vps:
-            http_request = "http://bgproutes.io:7000/broker/broker?peers={}&from_time={}&until_time={}&data_type={}".format(",".join(self.vps), self.from_time, self.until_time, self.record_type)
+            http_request = "{}?peers={}&from_time={}&until_time={}&data_type={}".format(self.broker_url, ",".join(self.vps), self.from_time, self.until_time, self.record_type)
         else:
-            http_request = "http://bgproutes.io:7000/broker/broker?from_time={}&until_time={}&data_type={}".format(self.from_time, self.until_time, self.record_type)
+            http_request = "{}?from_time={}&until_time={}&data_type={}".format(self.broker_url, self.from_time, self.until_time, self.record_type)
 
         timeout = 1
         data = None
@@ -425,32 +1926,76 @@ class GillStream:
         """
 
         if self.dumper:
-            mylib.File_buf_close_dump(self.dumper)
+            close_dumper(self.dumper)
             self.dumper = None
 
         if self.actFile:
-            os.remove(self.actFile)
+            self.release_file(self.actFile)
+            self.actFile = None
 
         if not len(self.remaining_files):
             return 0
-        
-        (url, peer) = self.remaining_files.pop(0)
 
-        timeout = 1
-        fn = download_file(url, peer, timeout)
+        # The file is parsed from the pipe its download is written to, unless it is cached
+        if self.stream:
+            (url, peer) = self.remaining_files.pop(0)
+            fn = self.cache.get(url) if self.cache else None
 
-        while not fn and timeout < 64:
-            timeout *= 2
-            fn = download_file(url, peer, timeout)
+            if fn:
+                return self.open_file(url, peer, fn)
+
+            fd = stream_file_retry(url)
+
+            if fd is None:
+                print("Skip file {}, unable to download".format(url))
+                return 2
+
+            self.dumper = open_dumper(url, self.from_time, self.until_time, filters=self.filters, monotonic=self.monotonic, fd=fd)
+
+            return 1
+
+        # The prefetcher downloads the files in the order of remaining_files
+        if self.prefetch > 0 and self.prefetcher is None:
+            self.prefetcher = FilePrefetcher(self.remaining_files, self.prefetch, self.cache)
+
+        (url, peer) = self.remaining_files.pop(0)
+
+        # The files are looked up in the cache (if any) before being downloaded
+        if self.prefetcher:
+            (url, fn) = self.prefetcher.next_file()
+        else:
+            fn = download_file_retry(url, peer, self.cache)
         
         if not fn:
             print("Skip file {}, unable to download".format(url))
             return 2
         
-        self.dumper = mylib.File_buf_create(fn.encode())
+        return self.open_file(url, peer, fn)
+
+
+    def open_file(self, url :str, peer :str, fn :str):
+        """
+        Open the MRT file dumper of a downloaded file, which becomes the current file (see
+        open_downloaded).
+        """
+
+        (fn, self.dumper) = open_downloaded(url, peer, fn, self.cache,
+            lambda fn: open_dumper(fn, self.from_time, self.until_time, filters=self.filters, monotonic=self.monotonic))
+
+        if not fn:
+            return 2
+
         self.actFile = fn
 
         return 1
+
+
+    def release_file(self, fn :str):
+        """
+        Remove a file once read, unless it is kept in the cache for the next streams.
+        """
+
+        release_file(fn, self.cache)
     
 
     def get_all_data(self):
@@ -464,43 +2009,128 @@ class GillStream:
             query correctly.
         """
 
-        while len(self.remaining_files):
-            if not self.dumper or self.dumper.contents.eof != 0:
-                ret = self.download_and_open_next_dumper()
+        try:
+            if self.processes > 0:
+                yield from self.get_all_data_parallel()
+                return
 
-                if ret == 0:
-                    return
-                
-                while ret == 2:
+            if self.ordered:
+                files = self.remaining_files
+                self.remaining_files = list()
+                yield from _read_files(files, None, self.cache, self.read_options())
+                return
+
+            while len(self.remaining_files):
+                if not self.dumper or dumper_eof(self.dumper):
                     ret = self.download_and_open_next_dumper()
+
                     if ret == 0:
                         return
-            
+                    
+                    while ret == 2:
+                        ret = self.download_and_open_next_dumper()
+                        if ret == 0:
+                            return
+                
+
+                yield from read_messages(self.dumper)
+        finally:
+            self.close()
+
+
+    def read_options(self):
+        """
+        Options with which the files are read (see _read_files), that can be sent to a worker
+        process.
+        """
+
+        return dict(from_time=self.from_time, until_time=self.until_time, filters=self.filters,
+                    monotonic=self.monotonic, stream=self.stream, prefetch=self.prefetch,
+                    cache=self.cache_args)
 
-            while self.dumper.contents.eof == 0:
-                entry = mylib.Read_next_mrt_entry(self.dumper)
 
-                if entry and entry.contents.time >= self.from_time and entry.contents.time <= self.until_time:
+    def get_all_data_parallel(self):
+        """
+        Read all the remaining files with worker processes (see processes and ordered), each of
+        which runs the C parser with the filters of the stream, and sends the messages to this
+        process in batches.
+
+        Yields:
+            BGPmessage: Yields every BGP message of the files, in timestamp order if ordered is
+            set, as soon as they are received otherwise.
+
+        Raises:
+            Exception: The exception a worker failed with, once received (the workers are then
+            stopped, see close).
+        """
+
+        files = self.remaining_files
+        self.remaining_files = list()
+
+        nb = min(self.processes, len(files))
+        if nb == 0:
+            return
 
-                    # If entry is a MRT BGP UPDATE, print it
-                    if entry.contents.entryType == BGP_TYPE_ZEBRA_BGP or entry.contents.entryType == BGP_TYPE_ZEBRA_BGP_ET:
-                        msg = BGPmessage(entry)
-                        yield msg
+        ctx = multiprocessing.get_context()
+        options = self.read_options()
+
+        if self.ordered:
+            queues = [ctx.Queue(GILL_PARALLEL_QUEUE_BATCHES) for _ in range(nb)]
+            self.workers = [ctx.Process(target=_parallel_worker, args=(i, files[i::nb], None, queues[i], options), daemon=True)
+                            for i in range(nb)]
+        else:
+            tasks = ctx.Queue()
+            for f in files + [None] * nb:
+                tasks.put(f)
+
+            results = ctx.Queue(nb * GILL_PARALLEL_QUEUE_BATCHES)
+            self.workers = [ctx.Process(target=_parallel_worker, args=(i, None, tasks, results, options), daemon=True)
+                            for i in range(nb)]
+
+        for worker in self.workers:
+            worker.start()
+
+        if self.ordered:
+            yield from heapq.merge(*[_queue_messages(q) for q in queues], key=lambda msg: msg.ts)
+        else:
+            done = 0
+            while done < nb:
+                (_, batch) = results.get()
+                if batch is None:
+                    done += 1
+                elif isinstance(batch, BaseException):
+                    raise batch
+                else:
+                    yield from _batch_messages(batch)
+
+        for worker in self.workers:
+            worker.join()
+        self.workers = list()
+
+
+    def close(self):
+        """
+        Close the current BGP dumper (if any), and remove the files downloaded for the stream.
+        Called once all the data is read, or when get_all_data is stopped early.
+        """
 
-                    # If entry is a RIB entry, print it as well
-                    elif entry.contents.entryType == BGP_TYPE_TABLE_DUMP_V2 and \
-                        (entry.contents.entrySubType == BGP_SUBTYPE_RIB_IPV4_UNICAST or entry.contents.entrySubType == BGP_SUBTYPE_RIB_IPV6_UNICAST):
-                        msg = BGPmessage(entry)
-                        yield msg
+        # Workers still running when the reading is stopped early
+        for worker in self.workers:
+            worker.terminate()
+            worker.join()
+        self.workers = list()
 
-                    #mylib.MRTentry_free(entry)
+        if self.prefetcher:
+            self.prefetcher.close()
+            self.prefetcher = None
 
         if self.dumper:
-            mylib.File_buf_close_dump(self.dumper)
+            close_dumper(self.dumper)
             self.dumper = None
 
         if self.actFile:
-            os.remove(self.actFile)
+            self.release_file(self.actFile)
+            self.actFile = None
 
 
 
@@ -2,7 +2,7 @@
 #
 # SPDX-License-Identifier: GPL-2.0-only
 
-from setuptools import setup, find_packages
+from setuptools import setup, find_packages, Extension
 import os
 
 
@@ -28,10 +28,22 @@ libdir = os.environ.get("GILLSTREAM_LIBRARY_PATH", "/usr/local/lib/")
 
 update_library_directory("pygillstream/broker.py", libdir)
 
+# Native reader linked against libbgpgill.so (optional: broker.py falls back on ctypes)
+gillstream_ext = Extension(
+    'pygillstream._gillstream',
+    sources=['pygillstream/_gillstream.c'],
+    include_dirs=['c_mrt_parser'],
+    libraries=['bgpgill'],
+    library_dirs=[libdir, 'c_mrt_parser'],
+    runtime_library_dirs=[libdir],
+    optional=True
+)
+
 setup(
     name='pygillstream',
     version='0.1.2',
     packages=find_packages(),
+    ext_modules=[gillstream_ext],
     install_requires=['requests>=2.24.0'],
     author='Thomas Holterbach and Thomas Alfroy',
     author_email='contact@bgproutes.io',